@@ -0,0 +1,76 @@
+# minify_ur_script(<variable> <strip_textmsg>)
+#
+# Minifies the URScript in <variable>: indentation, blank lines and comments are removed. Kept are the comments the
+# library injects code after (e.g. "# inject move path") and the section markers (e.g. "# HEADER_END"), and the
+# controller version tags ("$5.4") in front of a line. The line following a kept comment starts with a space, since
+# injected code is inserted right before it. If <strip_textmsg> is true, textmsg() debug messages are removed as
+# well, unless a message is the only statement of a block.
+function(minify_ur_script variable strip_textmsg)
+	set(injection_comment "# (float register offset|int register offset|inject move path)$")
+	set(section_marker "^# [A-Z_]+$")
+
+	# Protect the characters with a meaning in CMake lists before splitting the script into lines
+	string(REPLACE ";" "@SEMICOLON@" script "${${variable}}")
+	string(REPLACE "[" "@LBRACKET@" script "${script}")
+	string(REPLACE "]" "@RBRACKET@" script "${script}")
+	string(REPLACE "\n" ";" lines "${script}")
+
+	set(result "")
+	set(previous "")
+	set(pending_textmsg "")
+	set(after_marker FALSE)
+	foreach(line IN LISTS lines)
+		set(tag "")
+		if(line MATCHES "^(\\$[0-9]+\\.[0-9]+(\\|[0-9]+\\.[0-9]+)?)(.*)$")
+			set(tag "${CMAKE_MATCH_1} ")
+			set(line "${CMAKE_MATCH_3}")
+		endif()
+		string(STRIP "${line}" line)
+
+		if(line MATCHES "${injection_comment}" OR line MATCHES "${section_marker}")
+			string(APPEND result "${pending_textmsg}")
+			set(pending_textmsg "")
+			if(after_marker)
+				set(tag " ${tag}")
+			endif()
+			string(APPEND result "${tag}${line}\n")
+			set(after_marker TRUE)
+			continue()
+		endif()
+
+		# Remove a comment, a # within a string is kept
+		if(line MATCHES "^([^\"#]*(\"[^\"]*\"[^\"#]*)*)#")
+			set(line "${CMAKE_MATCH_1}")
+			string(STRIP "${line}" line)
+		endif()
+		if(line STREQUAL "")
+			continue()
+		endif()
+
+		if(strip_textmsg AND line MATCHES "^textmsg\\(.*\\)$")
+			# Kept only if the block would otherwise be empty, which is decided by the next statement
+			if(previous MATCHES ":$")
+				set(pending_textmsg "${tag}${line}\n")
+			endif()
+			continue()
+		endif()
+		if(NOT pending_textmsg STREQUAL "")
+			if(line MATCHES "^(end|elif|else)")
+				string(APPEND result "${pending_textmsg}")
+			endif()
+			set(pending_textmsg "")
+		endif()
+
+		if(after_marker)
+			set(tag " ${tag}")
+			set(after_marker FALSE)
+		endif()
+		string(APPEND result "${tag}${line}\n")
+		set(previous "${line}")
+	endforeach()
+
+	string(REPLACE "@SEMICOLON@" ";" result "${result}")
+	string(REPLACE "@LBRACKET@" "[" result "${result}")
+	string(REPLACE "@RBRACKET@" "]" result "${result}")
+	set(${variable} "${result}" PARENT_SCOPE)
+endfunction()
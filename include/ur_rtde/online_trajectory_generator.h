@@ -0,0 +1,113 @@
+#pragma once
+#ifndef RTDE_ONLINE_TRAJECTORY_GENERATOR_H
+#define RTDE_ONLINE_TRAJECTORY_GENERATOR_H
+
+#include <ur_rtde/rtde_export.h>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace ur_rtde
+{
+/**
+ * Jerk-limited joint trajectories generated online, one control period at a time, for feeding servoJ().
+ *
+ * The target can be changed in every cycle, the generator continues from its current position, velocity and
+ * acceleration, so motions can be retargeted at the controller frequency without stopping. Each joint moves towards
+ * its target as fast as the velocity, acceleration and jerk limits allow and arrives at rest without overshooting.
+ * The joints are not synchronized, each one reaches its target at its own time.
+ *
+ * @verbatim
+ * OnlineTrajectoryGenerator otg(1.0 / rtde_control.getFrequency(), 1.0, 2.0, 20.0);
+ * otg.reset(rtde_receive.getActualQ());
+ * while (running)
+ * {
+ *   otg.setTarget(latest_target);
+ *   otg.update();
+ *   rtde_control.servoJ(otg.getPosition(), 0, 0, otg.getDeltaTime(), 0.03, 500);
+ *   rtde_control.waitForNextState();
+ * }
+ * @endverbatim
+ */
+class OnlineTrajectoryGenerator
+{
+ public:
+  /**
+   * @param delta_time the control period in seconds, 1 / frequency of the RTDEControlInterface
+   * @param max_velocity the joint velocity limit [rad/s] of all joints, at most UR_JOINT_VELOCITY_MAX
+   * @param max_acceleration the joint acceleration limit [rad/s^2] of all joints, at most UR_JOINT_ACCELERATION_MAX
+   * @param max_jerk the joint jerk limit [rad/s^3] of all joints
+   * @throws std::invalid_argument if a parameter is out of range
+   */
+  RTDE_EXPORT OnlineTrajectoryGenerator(double delta_time, double max_velocity, double max_acceleration,
+                                        double max_jerk);
+
+  /**
+   * @brief Set the limits of each joint individually, they apply from the next update() on
+   * @throws std::invalid_argument if a limit is out of range
+   */
+  RTDE_EXPORT void setLimits(const std::array<double, 6> &max_velocity, const std::array<double, 6> &max_acceleration,
+                             const std::array<double, 6> &max_jerk);
+
+  /**
+   * @brief Set the joint position limits, targets are clamped to them. The default is UR_JOINT_POSITION_MIN to
+   * UR_JOINT_POSITION_MAX.
+   */
+  RTDE_EXPORT void setPositionLimits(const std::array<double, 6> &min_position,
+                                     const std::array<double, 6> &max_position);
+
+  /**
+   * @brief Set the current state of the joints, e.g. the actual joint positions before the first update(). The target
+   * is set to the position.
+   */
+  RTDE_EXPORT void reset(const std::vector<double> &q, const std::vector<double> &qd = std::vector<double>(),
+                         const std::vector<double> &qdd = std::vector<double>());
+
+  /**
+   * @brief Set the joint positions to move to, can be called in every cycle
+   */
+  RTDE_EXPORT void setTarget(const std::array<double, 6> &q);
+
+  RTDE_EXPORT void setTarget(const std::vector<double> &q);
+
+  /**
+   * @brief Advance the trajectory by one control period
+   * @returns true once all joints are at rest at the target
+   */
+  RTDE_EXPORT bool update();
+
+  RTDE_EXPORT bool isTargetReached() const;
+
+  RTDE_EXPORT const std::array<double, 6> &getPosition() const;
+
+  RTDE_EXPORT const std::array<double, 6> &getVelocity() const;
+
+  RTDE_EXPORT const std::array<double, 6> &getAcceleration() const;
+
+  RTDE_EXPORT double getDeltaTime() const;
+
+ private:
+  struct Limits
+  {
+    double velocity;
+    double acceleration;
+    double jerk;
+  };
+
+  bool updateJoint(std::size_t joint);
+
+  double delta_time_;
+  std::array<Limits, 6> limits_;
+  std::array<double, 6> min_position_;
+  std::array<double, 6> max_position_;
+  std::array<double, 6> target_;
+  std::array<double, 6> position_;
+  std::array<double, 6> velocity_;
+  std::array<double, 6> acceleration_;
+  bool target_reached_;
+};
+
+}  // namespace ur_rtde
+
+#endif  // RTDE_ONLINE_TRAJECTORY_GENERATOR_H
@@ -0,0 +1,445 @@
+#pragma once
+#ifndef RTDE_POSE_MATH_H
+#define RTDE_POSE_MATH_H
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ur_rtde
+{
+/**
+ * Pose algebra of URScript, computed in the client. Poses are [x, y, z, rx, ry, rz] with the rotation as a rotation
+ * vector, like everywhere in the ur_rtde API. Quaternions are [w, x, y, z] and rotation matrices are 3x3 row-major,
+ * homogeneous transformations 4x4 row-major.
+ *
+ * The pointer functions do not allocate and allow the result to alias the arguments, so they can be used in control
+ * loops. The std::vector overloads check the sizes and throw std::invalid_argument.
+ */
+namespace pose_math
+{
+namespace detail
+{
+// Below this angle the sine in the rotation vector conversions is replaced by its Taylor series
+const double SMALL_ANGLE = 1e-6;
+
+inline void quaternionMultiply(const double *a, const double *b, double *c)
+{
+  double w = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+  double x = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+  double y = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+  double z = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+  c[0] = w;
+  c[1] = x;
+  c[2] = y;
+  c[3] = z;
+}
+
+// Rotate v by the unit quaternion q: v + 2 w (u x v) + 2 u x (u x v)
+inline void rotate(const double *q, const double *v, double *result)
+{
+  double tx = 2 * (q[2] * v[2] - q[3] * v[1]);
+  double ty = 2 * (q[3] * v[0] - q[1] * v[2]);
+  double tz = 2 * (q[1] * v[1] - q[2] * v[0]);
+  double x = v[0] + q[0] * tx + (q[2] * tz - q[3] * ty);
+  double y = v[1] + q[0] * ty + (q[3] * tx - q[1] * tz);
+  double z = v[2] + q[0] * tz + (q[1] * ty - q[2] * tx);
+  result[0] = x;
+  result[1] = y;
+  result[2] = z;
+}
+
+inline void checkSize(const std::vector<double> &v, std::size_t size, const char *name)
+{
+  if (v.size() != size)
+    throw std::invalid_argument(std::string(name) + " must have " + std::to_string(size) + " elements");
+}
+}  // namespace detail
+
+/**
+ * @brief Convert a rotation vector to a unit quaternion [w, x, y, z]
+ */
+inline void rotationVectorToQuaternion(const double *rotation, double *q)
+{
+  double angle = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2]);
+  // sin(angle / 2) / angle
+  double scale = angle < detail::SMALL_ANGLE ? 0.5 - angle * angle / 48 : std::sin(angle / 2) / angle;
+  q[0] = std::cos(angle / 2);
+  q[1] = rotation[0] * scale;
+  q[2] = rotation[1] * scale;
+  q[3] = rotation[2] * scale;
+}
+
+/**
+ * @brief Convert a quaternion [w, x, y, z] to a rotation vector with an angle in [0, pi]
+ */
+inline void quaternionToRotationVector(const double *q, double *rotation)
+{
+  // q and -q are the same rotation, the one with w >= 0 has the shorter angle
+  double sign = q[0] < 0 ? -1.0 : 1.0;
+  double w = sign * q[0];
+  double norm = std::sqrt(q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+  // angle / norm, with angle = 2 atan2(norm, w)
+  double scale = norm < detail::SMALL_ANGLE * w ? 2 / w : 2 * std::atan2(norm, w) / norm;
+  rotation[0] = sign * q[1] * scale;
+  rotation[1] = sign * q[2] * scale;
+  rotation[2] = sign * q[3] * scale;
+}
+
+/**
+ * @brief Convert a unit quaternion [w, x, y, z] to a row-major rotation matrix
+ */
+inline void quaternionToMatrix(const double *q, double *matrix)
+{
+  double w = q[0], x = q[1], y = q[2], z = q[3];
+  matrix[0] = 1 - 2 * (y * y + z * z);
+  matrix[1] = 2 * (x * y - w * z);
+  matrix[2] = 2 * (x * z + w * y);
+  matrix[3] = 2 * (x * y + w * z);
+  matrix[4] = 1 - 2 * (x * x + z * z);
+  matrix[5] = 2 * (y * z - w * x);
+  matrix[6] = 2 * (x * z - w * y);
+  matrix[7] = 2 * (y * z + w * x);
+  matrix[8] = 1 - 2 * (x * x + y * y);
+}
+
+/**
+ * @brief Convert a row-major rotation matrix to a unit quaternion [w, x, y, z], accurate for all angles
+ */
+inline void matrixToQuaternion(const double *m, double *q)
+{
+  double trace = m[0] + m[4] + m[8];
+  double w, x, y, z;
+  if (trace > 0)
+  {
+    double s = 2 * std::sqrt(trace + 1);
+    w = s / 4;
+    x = (m[7] - m[5]) / s;
+    y = (m[2] - m[6]) / s;
+    z = (m[3] - m[1]) / s;
+  }
+  else if (m[0] > m[4] && m[0] > m[8])
+  {
+    double s = 2 * std::sqrt(1 + m[0] - m[4] - m[8]);
+    w = (m[7] - m[5]) / s;
+    x = s / 4;
+    y = (m[1] + m[3]) / s;
+    z = (m[2] + m[6]) / s;
+  }
+  else if (m[4] > m[8])
+  {
+    double s = 2 * std::sqrt(1 + m[4] - m[0] - m[8]);
+    w = (m[2] - m[6]) / s;
+    x = (m[1] + m[3]) / s;
+    y = s / 4;
+    z = (m[5] + m[7]) / s;
+  }
+  else
+  {
+    double s = 2 * std::sqrt(1 + m[8] - m[0] - m[4]);
+    w = (m[3] - m[1]) / s;
+    x = (m[2] + m[6]) / s;
+    y = (m[5] + m[7]) / s;
+    z = s / 4;
+  }
+  q[0] = w;
+  q[1] = x;
+  q[2] = y;
+  q[3] = z;
+}
+
+/**
+ * @brief Convert a rotation vector to a row-major rotation matrix
+ */
+inline void rotationVectorToMatrix(const double *rotation, double *matrix)
+{
+  double q[4];
+  rotationVectorToQuaternion(rotation, q);
+  quaternionToMatrix(q, matrix);
+}
+
+/**
+ * @brief Convert a row-major rotation matrix to a rotation vector with an angle in [0, pi]
+ */
+inline void matrixToRotationVector(const double *matrix, double *rotation)
+{
+  double q[4];
+  matrixToQuaternion(matrix, q);
+  quaternionToRotationVector(q, rotation);
+}
+
+/**
+ * @brief Convert a pose to a row-major 4x4 homogeneous transformation
+ */
+inline void poseToTransform(const double *pose, double *transform)
+{
+  double m[9];
+  rotationVectorToMatrix(pose + 3, m);
+  for (int r = 0; r < 3; r++)
+  {
+    transform[r * 4 + 0] = m[r * 3 + 0];
+    transform[r * 4 + 1] = m[r * 3 + 1];
+    transform[r * 4 + 2] = m[r * 3 + 2];
+    transform[r * 4 + 3] = pose[r];
+  }
+  transform[12] = 0;
+  transform[13] = 0;
+  transform[14] = 0;
+  transform[15] = 1;
+}
+
+/**
+ * @brief Convert a row-major 4x4 homogeneous transformation to a pose
+ */
+inline void transformToPose(const double *transform, double *pose)
+{
+  const double m[9] = {transform[0], transform[1], transform[2], transform[4], transform[5],
+                       transform[6], transform[8], transform[9], transform[10]};
+  pose[0] = transform[3];
+  pose[1] = transform[7];
+  pose[2] = transform[11];
+  matrixToRotationVector(m, pose + 3);
+}
+
+/**
+ * @brief Pose transformation like pose_trans() of URScript: T_result = T_from * T_from_to
+ */
+inline void poseTrans(const double *p_from, const double *p_from_to, double *result)
+{
+  double q_from[4], q_from_to[4], position[3];
+  rotationVectorToQuaternion(p_from + 3, q_from);
+  rotationVectorToQuaternion(p_from_to + 3, q_from_to);
+  detail::rotate(q_from, p_from_to, position);
+  detail::quaternionMultiply(q_from, q_from_to, q_from_to);
+  result[0] = p_from[0] + position[0];
+  result[1] = p_from[1] + position[1];
+  result[2] = p_from[2] + position[2];
+  quaternionToRotationVector(q_from_to, result + 3);
+}
+
+/**
+ * @brief Inverse of a pose like pose_inv() of URScript
+ */
+inline void poseInv(const double *pose, double *result)
+{
+  double q[4], position[3];
+  rotationVectorToQuaternion(pose + 3, q);
+  q[1] = -q[1];
+  q[2] = -q[2];
+  q[3] = -q[3];
+  detail::rotate(q, pose, position);
+  result[0] = -position[0];
+  result[1] = -position[1];
+  result[2] = -position[2];
+  quaternionToRotationVector(q, result + 3);
+}
+
+/**
+ * @brief Pose addition like pose_add() of URScript: the positions are added and the rotations composed,
+ * R_result = R_1 * R_2
+ */
+inline void poseAdd(const double *p_1, const double *p_2, double *result)
+{
+  double q_1[4], q_2[4];
+  rotationVectorToQuaternion(p_1 + 3, q_1);
+  rotationVectorToQuaternion(p_2 + 3, q_2);
+  detail::quaternionMultiply(q_1, q_2, q_1);
+  result[0] = p_1[0] + p_2[0];
+  result[1] = p_1[1] + p_2[1];
+  result[2] = p_1[2] + p_2[2];
+  quaternionToRotationVector(q_1, result + 3);
+}
+
+/**
+ * @brief Pose subtraction like pose_sub() of URScript, the inverse of poseAdd(): the positions are subtracted and
+ * R_result = R_to * R_from^-1
+ */
+inline void poseSub(const double *p_to, const double *p_from, double *result)
+{
+  double q_to[4], q_from[4];
+  rotationVectorToQuaternion(p_to + 3, q_to);
+  rotationVectorToQuaternion(p_from + 3, q_from);
+  q_from[1] = -q_from[1];
+  q_from[2] = -q_from[2];
+  q_from[3] = -q_from[3];
+  detail::quaternionMultiply(q_to, q_from, q_to);
+  result[0] = p_to[0] - p_from[0];
+  result[1] = p_to[1] - p_from[1];
+  result[2] = p_to[2] - p_from[2];
+  quaternionToRotationVector(q_to, result + 3);
+}
+
+/**
+ * @brief Interpolate between two poses like interpolate_pose() of URScript. The position is interpolated linearly,
+ * the rotation along the shortest arc (slerp).
+ * @param alpha 0 gives p_from, 1 gives p_to
+ */
+inline void interpolatePose(const double *p_from, const double *p_to, double alpha, double *result)
+{
+  double q_from[4], q_to[4], rotation[3];
+  rotationVectorToQuaternion(p_from + 3, q_from);
+  rotationVectorToQuaternion(p_to + 3, q_to);
+  // Rotation from p_from to p_to in the frame of p_from, scaled by alpha
+  double q_from_inverse[4] = {q_from[0], -q_from[1], -q_from[2], -q_from[3]};
+  detail::quaternionMultiply(q_from_inverse, q_to, q_to);
+  quaternionToRotationVector(q_to, rotation);
+  rotation[0] *= alpha;
+  rotation[1] *= alpha;
+  rotation[2] *= alpha;
+  rotationVectorToQuaternion(rotation, q_to);
+  detail::quaternionMultiply(q_from, q_to, q_to);
+  for (int i = 0; i < 3; i++)
+    result[i] = p_from[i] + alpha * (p_to[i] - p_from[i]);
+  quaternionToRotationVector(q_to, result + 3);
+}
+
+/**
+ * @brief Express count poses given relative to the frame p_from in the frame of p_from, i.e. poseTrans() of p_from
+ * with each of them. The rotation of p_from is converted only once.
+ * @param p_from the frame, 6 values
+ * @param p_from_to count * 6 pose values
+ * @param result room for count * 6 pose values, can be p_from_to
+ */
+inline void poseTransBatch(const double *p_from, const double *p_from_to, std::size_t count, double *result)
+{
+  double q_from[4];
+  rotationVectorToQuaternion(p_from + 3, q_from);
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const double *pose = p_from_to + i * 6;
+    double *out = result + i * 6;
+    double q[4], position[3];
+    rotationVectorToQuaternion(pose + 3, q);
+    detail::rotate(q_from, pose, position);
+    detail::quaternionMultiply(q_from, q, q);
+    out[0] = p_from[0] + position[0];
+    out[1] = p_from[1] + position[1];
+    out[2] = p_from[2] + position[2];
+    quaternionToRotationVector(q, out + 3);
+  }
+}
+
+/**
+ * @brief Sample the interpolation between two poses at count values of alpha, e.g. to discretize a linear path. The
+ * relative rotation is computed only once.
+ * @param alphas count interpolation parameters
+ * @param result room for count * 6 pose values
+ */
+inline void interpolatePoseBatch(const double *p_from, const double *p_to, const double *alphas, std::size_t count,
+                                 double *result)
+{
+  double q_from[4], q_to[4], rotation[3];
+  rotationVectorToQuaternion(p_from + 3, q_from);
+  rotationVectorToQuaternion(p_to + 3, q_to);
+  double q_from_inverse[4] = {q_from[0], -q_from[1], -q_from[2], -q_from[3]};
+  detail::quaternionMultiply(q_from_inverse, q_to, q_to);
+  quaternionToRotationVector(q_to, rotation);
+  for (std::size_t i = 0; i < count; i++)
+  {
+    double alpha = alphas[i];
+    double *out = result + i * 6;
+    double step[3] = {rotation[0] * alpha, rotation[1] * alpha, rotation[2] * alpha};
+    double q[4];
+    rotationVectorToQuaternion(step, q);
+    detail::quaternionMultiply(q_from, q, q);
+    for (int j = 0; j < 3; j++)
+      out[j] = p_from[j] + alpha * (p_to[j] - p_from[j]);
+    quaternionToRotationVector(q, out + 3);
+  }
+}
+
+inline std::vector<double> poseTrans(const std::vector<double> &p_from, const std::vector<double> &p_from_to)
+{
+  detail::checkSize(p_from, 6, "p_from");
+  detail::checkSize(p_from_to, 6, "p_from_to");
+  std::vector<double> result(6);
+  poseTrans(p_from.data(), p_from_to.data(), result.data());
+  return result;
+}
+
+inline std::vector<double> poseInv(const std::vector<double> &pose)
+{
+  detail::checkSize(pose, 6, "pose");
+  std::vector<double> result(6);
+  poseInv(pose.data(), result.data());
+  return result;
+}
+
+inline std::vector<double> poseAdd(const std::vector<double> &p_1, const std::vector<double> &p_2)
+{
+  detail::checkSize(p_1, 6, "p_1");
+  detail::checkSize(p_2, 6, "p_2");
+  std::vector<double> result(6);
+  poseAdd(p_1.data(), p_2.data(), result.data());
+  return result;
+}
+
+inline std::vector<double> poseSub(const std::vector<double> &p_to, const std::vector<double> &p_from)
+{
+  detail::checkSize(p_to, 6, "p_to");
+  detail::checkSize(p_from, 6, "p_from");
+  std::vector<double> result(6);
+  poseSub(p_to.data(), p_from.data(), result.data());
+  return result;
+}
+
+inline std::vector<double> interpolatePose(const std::vector<double> &p_from, const std::vector<double> &p_to,
+                                           double alpha)
+{
+  detail::checkSize(p_from, 6, "p_from");
+  detail::checkSize(p_to, 6, "p_to");
+  std::vector<double> result(6);
+  interpolatePose(p_from.data(), p_to.data(), alpha, result.data());
+  return result;
+}
+
+/**
+ * @returns the quaternion [w, x, y, z] of a rotation vector
+ */
+inline std::vector<double> rotationVectorToQuaternion(const std::vector<double> &rotation)
+{
+  detail::checkSize(rotation, 3, "rotation");
+  std::vector<double> q(4);
+  rotationVectorToQuaternion(rotation.data(), q.data());
+  return q;
+}
+
+/**
+ * @returns the rotation vector of a unit quaternion [w, x, y, z]
+ */
+inline std::vector<double> quaternionToRotationVector(const std::vector<double> &q)
+{
+  detail::checkSize(q, 4, "q");
+  std::vector<double> rotation(3);
+  quaternionToRotationVector(q.data(), rotation.data());
+  return rotation;
+}
+
+/**
+ * @returns the row-major rotation matrix of a rotation vector
+ */
+inline std::vector<double> rotationVectorToMatrix(const std::vector<double> &rotation)
+{
+  detail::checkSize(rotation, 3, "rotation");
+  std::vector<double> matrix(9);
+  rotationVectorToMatrix(rotation.data(), matrix.data());
+  return matrix;
+}
+
+/**
+ * @returns the rotation vector of a row-major rotation matrix
+ */
+inline std::vector<double> matrixToRotationVector(const std::vector<double> &matrix)
+{
+  detail::checkSize(matrix, 9, "matrix");
+  std::vector<double> rotation(3);
+  matrixToRotationVector(matrix.data(), rotation.data());
+  return rotation;
+}
+
+}  // namespace pose_math
+}  // namespace ur_rtde
+
+#endif  // RTDE_POSE_MATH_H
@@ -5,13 +5,19 @@
 #include <ur_rtde/rtde_export.h>
 #include <ur_rtde/rtde_utility.h>
 #include <boost/variant.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <vector>
 #include <unordered_map>
 #include <sstream>
 #include <cstdint>
+#include <cstring>
 #include <iomanip>
+#include <memory>
 #include <mutex>
 #include <iterator>
+#include <stdexcept>
 
 
 
@@ -20,90 +26,400 @@ namespace ur_rtde
 using rtde_type_variant_ = boost::variant<uint32_t, uint64_t, int32_t, double, std::vector<double>,
     std::vector<int32_t>>;
 
+/**
+ * The robot state variables known to RobotState: the RTDE output name, the type of the stored value and the number of
+ * values. RobotState::Field and the storage layout are generated from this list.
+ */
+#define UR_RTDE_ROBOT_STATE_FIELDS(FIELD)             \
+  FIELD(timestamp, DOUBLE, 1)                         \
+  FIELD(target_q, VECTOR_DOUBLE, 6)                   \
+  FIELD(target_qd, VECTOR_DOUBLE, 6)                  \
+  FIELD(target_qdd, VECTOR_DOUBLE, 6)                 \
+  FIELD(target_current, VECTOR_DOUBLE, 6)             \
+  FIELD(target_moment, VECTOR_DOUBLE, 6)              \
+  FIELD(actual_q, VECTOR_DOUBLE, 6)                   \
+  FIELD(actual_qd, VECTOR_DOUBLE, 6)                  \
+  FIELD(actual_qdd, VECTOR_DOUBLE, 6)                 \
+  FIELD(actual_current, VECTOR_DOUBLE, 6)             \
+  FIELD(actual_moment, VECTOR_DOUBLE, 6)              \
+  FIELD(joint_control_output, VECTOR_DOUBLE, 6)       \
+  FIELD(actual_TCP_pose, VECTOR_DOUBLE, 6)            \
+  FIELD(actual_TCP_speed, VECTOR_DOUBLE, 6)           \
+  FIELD(actual_TCP_force, VECTOR_DOUBLE, 6)           \
+  FIELD(target_TCP_pose, VECTOR_DOUBLE, 6)            \
+  FIELD(target_TCP_speed, VECTOR_DOUBLE, 6)           \
+  FIELD(actual_digital_input_bits, UINT64, 1)         \
+  FIELD(joint_temperatures, VECTOR_DOUBLE, 6)         \
+  FIELD(actual_execution_time, DOUBLE, 1)             \
+  FIELD(robot_mode, INT32, 1)                         \
+  FIELD(joint_mode, VECTOR_INT32, 6)                  \
+  FIELD(safety_mode, INT32, 1)                        \
+  FIELD(actual_tool_accelerometer, VECTOR_DOUBLE, 3)  \
+  FIELD(speed_scaling, DOUBLE, 1)                     \
+  FIELD(target_speed_fraction, DOUBLE, 1)             \
+  FIELD(actual_momentum, DOUBLE, 1)                   \
+  FIELD(actual_main_voltage, DOUBLE, 1)               \
+  FIELD(actual_robot_voltage, DOUBLE, 1)              \
+  FIELD(actual_robot_current, DOUBLE, 1)              \
+  FIELD(actual_joint_voltage, VECTOR_DOUBLE, 6)       \
+  FIELD(actual_digital_output_bits, UINT64, 1)        \
+  FIELD(runtime_state, UINT32, 1)                     \
+  FIELD(robot_status_bits, UINT32, 1)                 \
+  FIELD(safety_status_bits, UINT32, 1)                \
+  FIELD(standard_analog_input0, DOUBLE, 1)            \
+  FIELD(standard_analog_input1, DOUBLE, 1)            \
+  FIELD(standard_analog_output0, DOUBLE, 1)           \
+  FIELD(standard_analog_output1, DOUBLE, 1)           \
+  FIELD(ft_raw_wrench, VECTOR_DOUBLE, 6)              \
+  FIELD(payload, DOUBLE, 1)                           \
+  FIELD(payload_cog, VECTOR_DOUBLE, 3)                \
+  FIELD(payload_inertia, VECTOR_DOUBLE, 6)            \
+  FIELD(output_bit_registers0_to_31, UINT32, 1)       \
+  FIELD(output_bit_registers32_to_63, UINT32, 1)      \
+  FIELD(output_int_register_0, INT32, 1)              \
+  FIELD(output_int_register_1, INT32, 1)              \
+  FIELD(output_int_register_2, INT32, 1)              \
+  FIELD(output_int_register_3, INT32, 1)              \
+  FIELD(output_int_register_4, INT32, 1)              \
+  FIELD(output_int_register_5, INT32, 1)              \
+  FIELD(output_int_register_6, INT32, 1)              \
+  FIELD(output_int_register_7, INT32, 1)              \
+  FIELD(output_int_register_8, INT32, 1)              \
+  FIELD(output_int_register_9, INT32, 1)              \
+  FIELD(output_int_register_10, INT32, 1)             \
+  FIELD(output_int_register_11, INT32, 1)             \
+  FIELD(output_int_register_12, INT32, 1)             \
+  FIELD(output_int_register_13, INT32, 1)             \
+  FIELD(output_int_register_14, INT32, 1)             \
+  FIELD(output_int_register_15, INT32, 1)             \
+  FIELD(output_int_register_16, INT32, 1)             \
+  FIELD(output_int_register_17, INT32, 1)             \
+  FIELD(output_int_register_18, INT32, 1)             \
+  FIELD(output_int_register_19, INT32, 1)             \
+  FIELD(output_int_register_20, INT32, 1)             \
+  FIELD(output_int_register_21, INT32, 1)             \
+  FIELD(output_int_register_22, INT32, 1)             \
+  FIELD(output_int_register_23, INT32, 1)             \
+  FIELD(output_int_register_24, INT32, 1)             \
+  FIELD(output_int_register_25, INT32, 1)             \
+  FIELD(output_int_register_26, INT32, 1)             \
+  FIELD(output_int_register_27, INT32, 1)             \
+  FIELD(output_int_register_28, INT32, 1)             \
+  FIELD(output_int_register_29, INT32, 1)             \
+  FIELD(output_int_register_30, INT32, 1)             \
+  FIELD(output_int_register_31, INT32, 1)             \
+  FIELD(output_int_register_32, INT32, 1)             \
+  FIELD(output_int_register_33, INT32, 1)             \
+  FIELD(output_int_register_34, INT32, 1)             \
+  FIELD(output_int_register_35, INT32, 1)             \
+  FIELD(output_int_register_36, INT32, 1)             \
+  FIELD(output_int_register_37, INT32, 1)             \
+  FIELD(output_int_register_38, INT32, 1)             \
+  FIELD(output_int_register_39, INT32, 1)             \
+  FIELD(output_int_register_40, INT32, 1)             \
+  FIELD(output_int_register_41, INT32, 1)             \
+  FIELD(output_int_register_42, INT32, 1)             \
+  FIELD(output_int_register_43, INT32, 1)             \
+  FIELD(output_int_register_44, INT32, 1)             \
+  FIELD(output_int_register_45, INT32, 1)             \
+  FIELD(output_int_register_46, INT32, 1)             \
+  FIELD(output_int_register_47, INT32, 1)             \
+  FIELD(output_double_register_0, DOUBLE, 1)          \
+  FIELD(output_double_register_1, DOUBLE, 1)          \
+  FIELD(output_double_register_2, DOUBLE, 1)          \
+  FIELD(output_double_register_3, DOUBLE, 1)          \
+  FIELD(output_double_register_4, DOUBLE, 1)          \
+  FIELD(output_double_register_5, DOUBLE, 1)          \
+  FIELD(output_double_register_6, DOUBLE, 1)          \
+  FIELD(output_double_register_7, DOUBLE, 1)          \
+  FIELD(output_double_register_8, DOUBLE, 1)          \
+  FIELD(output_double_register_9, DOUBLE, 1)          \
+  FIELD(output_double_register_10, DOUBLE, 1)         \
+  FIELD(output_double_register_11, DOUBLE, 1)         \
+  FIELD(output_double_register_12, DOUBLE, 1)         \
+  FIELD(output_double_register_13, DOUBLE, 1)         \
+  FIELD(output_double_register_14, DOUBLE, 1)         \
+  FIELD(output_double_register_15, DOUBLE, 1)         \
+  FIELD(output_double_register_16, DOUBLE, 1)         \
+  FIELD(output_double_register_17, DOUBLE, 1)         \
+  FIELD(output_double_register_18, DOUBLE, 1)         \
+  FIELD(output_double_register_19, DOUBLE, 1)         \
+  FIELD(output_double_register_20, DOUBLE, 1)         \
+  FIELD(output_double_register_21, DOUBLE, 1)         \
+  FIELD(output_double_register_22, DOUBLE, 1)         \
+  FIELD(output_double_register_23, DOUBLE, 1)         \
+  FIELD(output_double_register_24, DOUBLE, 1)         \
+  FIELD(output_double_register_25, DOUBLE, 1)         \
+  FIELD(output_double_register_26, DOUBLE, 1)         \
+  FIELD(output_double_register_27, DOUBLE, 1)         \
+  FIELD(output_double_register_28, DOUBLE, 1)         \
+  FIELD(output_double_register_29, DOUBLE, 1)         \
+  FIELD(output_double_register_30, DOUBLE, 1)         \
+  FIELD(output_double_register_31, DOUBLE, 1)         \
+  FIELD(output_double_register_32, DOUBLE, 1)         \
+  FIELD(output_double_register_33, DOUBLE, 1)         \
+  FIELD(output_double_register_34, DOUBLE, 1)         \
+  FIELD(output_double_register_35, DOUBLE, 1)         \
+  FIELD(output_double_register_36, DOUBLE, 1)         \
+  FIELD(output_double_register_37, DOUBLE, 1)         \
+  FIELD(output_double_register_38, DOUBLE, 1)         \
+  FIELD(output_double_register_39, DOUBLE, 1)         \
+  FIELD(output_double_register_40, DOUBLE, 1)         \
+  FIELD(output_double_register_41, DOUBLE, 1)         \
+  FIELD(output_double_register_42, DOUBLE, 1)         \
+  FIELD(output_double_register_43, DOUBLE, 1)         \
+  FIELD(output_double_register_44, DOUBLE, 1)         \
+  FIELD(output_double_register_45, DOUBLE, 1)         \
+  FIELD(output_double_register_46, DOUBLE, 1)         \
+  FIELD(output_double_register_47, DOUBLE, 1)
+
+/**
+ * The latest robot state received from the controller.
+ *
+ * The values of the subscribed variables are stored in a flat array of 8-byte words, laid out in subscription order.
+ * The receive thread is the only regular writer and publishes every package with a sequence lock: the sequence is odd
+ * while a package is written and even once it is complete. Readers copy the words they need and retry if the
+ * sequence changed meanwhile, so they never take a lock and never delay the receive thread.
+ */
 class RobotState
 {
  public:
+  /**
+   * Type of a state variable, as stored in the robot state
+   */
+  enum class ValueType : std::uint8_t
+  {
+    UINT32,
+    UINT64,
+    INT32,
+    DOUBLE,
+    VECTOR_DOUBLE,
+    VECTOR_INT32
+  };
+
+  /**
+   * A robot state variable, named after its RTDE output
+   */
+  enum class Field : std::uint16_t
+  {
+#define UR_RTDE_ROBOT_STATE_FIELD_ENUM(name, type, size) name,
+    UR_RTDE_ROBOT_STATE_FIELDS(UR_RTDE_ROBOT_STATE_FIELD_ENUM)
+#undef UR_RTDE_ROBOT_STATE_FIELD_ENUM
+  };
+
+#define UR_RTDE_ROBOT_STATE_FIELD_COUNT(name, type, size) +1
+  static constexpr std::size_t fieldCount()
+  {
+    return 0 UR_RTDE_ROBOT_STATE_FIELDS(UR_RTDE_ROBOT_STATE_FIELD_COUNT);
+  }
+#undef UR_RTDE_ROBOT_STATE_FIELD_COUNT
+
+  /**
+   * @returns the RTDE output name of the variable
+   */
+  RTDE_EXPORT static const char *fieldName(Field field);
+
+  /**
+   * @brief Look up a variable by its RTDE output name
+   * @returns false if the name is not a known robot state variable
+   */
+  RTDE_EXPORT static bool findField(const std::string &name, Field &field);
+
+  /**
+   * @returns the field of output_int_register_<n>, n in [0, 47]
+   */
+  static Field outputIntRegister(int n)
+  {
+    return static_cast<Field>(static_cast<int>(Field::output_int_register_0) + n);
+  }
+
+  /**
+   * @returns the field of output_double_register_<n>, n in [0, 47]
+   */
+  static Field outputDoubleRegister(int n)
+  {
+    return static_cast<Field>(static_cast<int>(Field::output_double_register_0) + n);
+  }
+
+  static ValueType fieldType(Field field)
+  {
+    static const ValueType types[] = {
+#define UR_RTDE_ROBOT_STATE_FIELD_TYPE(name, type, size) ValueType::type,
+        UR_RTDE_ROBOT_STATE_FIELDS(UR_RTDE_ROBOT_STATE_FIELD_TYPE)
+#undef UR_RTDE_ROBOT_STATE_FIELD_TYPE
+    };
+    return types[static_cast<std::size_t>(field)];
+  }
+
+  static std::uint16_t fieldSize(Field field)
+  {
+    static const std::uint16_t sizes[] = {
+#define UR_RTDE_ROBOT_STATE_FIELD_SIZE(name, type, size) size,
+        UR_RTDE_ROBOT_STATE_FIELDS(UR_RTDE_ROBOT_STATE_FIELD_SIZE)
+#undef UR_RTDE_ROBOT_STATE_FIELD_SIZE
+    };
+    return sizes[static_cast<std::size_t>(field)];
+  }
+
   RTDE_EXPORT explicit RobotState(const std::vector<std::string> &variables);
 
   RTDE_EXPORT virtual ~RobotState();
 
+  /**
+   * @brief Start writing a new state. Serializes the writers and marks the state as being written for the readers.
+   */
   RTDE_EXPORT bool lockUpdateStateMutex();
 
+  /**
+   * @brief Publish the state written since lockUpdateStateMutex() to the readers.
+   */
   RTDE_EXPORT bool unlockUpdateStateMutex();
 
   RTDE_EXPORT void setFirstStateReceived(bool val);
 
   RTDE_EXPORT bool getFirstStateReceived();
 
+  /**
+   * @brief Add storage for the given variables. Variables that are already part of the state keep their storage and
+   * value, so readers and the receive thread can keep using their offsets.
+   */
   RTDE_EXPORT void initRobotState(const std::vector<std::string> &variables);
 
+  /**
+   * @returns the word offset of the specified variable, or -1 if the variable is not part of this robot state or is
+   * not stored with the given type and size. The offset stays valid for the lifetime of the robot state.
+   */
+  RTDE_EXPORT std::int32_t getStateOffset(const std::string &name, ValueType type, std::uint16_t size) const;
+
+  /**
+   * @returns the word offset of the variable, or -1 if the variable is not part of this robot state
+   */
+  std::int32_t getStateOffset(Field field) const
+  {
+    return offsets_[static_cast<std::size_t>(field)].load(std::memory_order_acquire);
+  }
+
+  /**
+   * A variable copied by copyState(), from a word offset in the robot state to a byte offset in the destination
+   */
+  struct CopyEntry
+  {
+    std::int32_t offset;
+    std::uint16_t size;
+    ValueType type;
+    std::size_t destination;
+  };
+
+  /**
+   * @brief Copy the variables of the plan from one consistent state into the destination without allocating. Vectors
+   * are written as plain arrays of their element type.
+   * @returns the sequence number of the copied state
+   */
+  RTDE_EXPORT std::uint64_t copyState(const std::vector<CopyEntry> &plan, void *destination) const;
+
+  /**
+   * @returns the number of state updates published so far
+   */
+  std::uint64_t getSequenceNumber() const
+  {
+    return sequence_.load(std::memory_order_acquire) / 2;
+  }
+
+  /**
+   * @brief Wait until a state newer than the given sequence number has been published. The writer only takes the wait
+   * mutex while a reader is waiting.
+   * @returns true if a newer state is available, false on timeout
+   */
+  RTDE_EXPORT bool waitForState(std::uint64_t sequence_number, std::chrono::microseconds timeout);
+
+  // Stores of a writer, only valid between lockUpdateStateMutex() and unlockUpdateStateMutex()
+  void storeDouble(std::int32_t offset, double value)
+  {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    words_[offset].store(bits, std::memory_order_relaxed);
+  }
+
+  void storeInt32(std::int32_t offset, std::int32_t value)
+  {
+    words_[offset].store(static_cast<std::uint32_t>(value), std::memory_order_relaxed);
+  }
+
+  void storeUInt32(std::int32_t offset, std::uint32_t value)
+  {
+    words_[offset].store(value, std::memory_order_relaxed);
+  }
+
+  void storeUInt64(std::int32_t offset, std::uint64_t value)
+  {
+    words_[offset].store(value, std::memory_order_relaxed);
+  }
+
   uint16_t getStateEntrySize(const std::string& name)
   {
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
-    std::lock_guard<std::mutex> lock(update_state_mutex_);
-#else
-    std::lock_guard<PriorityInheritanceMutex> lock(update_state_mutex_);
-#endif
-    if (state_data_.find(name) != state_data_.end())
-    {
-      uint16_t entry_size = boost::apply_visitor(RobotState::SizeVisitor(), state_data_[name]);
-      return entry_size;
-    }
-    else
-    {
+    Field field;
+    if (!findField(name, field) || getStateOffset(field) < 0)
       throw std::runtime_error("unable to get state entry size for specified key: " + name);
-    }
+    return fieldSize(field);
   };
 
   std::string getStateEntryString(const std::string& name)
   {
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
-    std::lock_guard<std::mutex> lock(update_state_mutex_);
-#else
-    std::lock_guard<PriorityInheritanceMutex> lock(update_state_mutex_);
-#endif
-    if (state_data_.find(name) != state_data_.end())
-    {
-      std::string entry_str = boost::apply_visitor(RobotState::StringVisitor(), state_data_[name]);
-      return entry_str;
-    }
-    else
-    {
+    rtde_type_variant_ entry;
+    if (!getStateEntry(name, entry))
       throw std::runtime_error("unable to get state entry as string for specified key: " + name);
-    }
+    return boost::apply_visitor(RobotState::StringVisitor(), entry);
+  };
+
+  /**
+   * @brief Copy the current value of a variable into a variant holding its type
+   * @returns false if the variable is not part of this robot state
+   */
+  RTDE_EXPORT bool getStateEntry(const std::string &name, rtde_type_variant_ &entry);
+
+  template <typename T>
+  bool getStateData(Field field, T& val)
+  {
+    std::int32_t offset = getStateOffset(field);
+    if (offset < 0)
+      return false;
+    if (fieldType(field) != valueType(val))
+      throw std::runtime_error(std::string("state entry ") + fieldName(field) +
+                               " is not stored with the requested type");
+
+    prepare(val, fieldSize(field));
+    readConsistent([&] { load(offset, val); });
+    return true;
   };
 
   template <typename T> bool
   getStateData(const std::string& name, T& val)
   {
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
-    std::lock_guard<std::mutex> lock(update_state_mutex_);
-#else
-    std::lock_guard<PriorityInheritanceMutex> lock(update_state_mutex_);
-#endif
-    if (state_data_.find(name) != state_data_.end())
-    {
-      val = boost::strict_get<T>(state_data_[name]);
-    }
-    else
-    {
+    Field field;
+    return findField(name, field) && getStateData(field, val);
+  };
+
+  template <typename T>
+  bool setStateData(Field field, T& val)
+  {
+    std::int32_t offset = getStateOffset(field);
+    if (offset < 0)
       return false;
-    }
+    if (fieldType(field) != valueType(val))
+      throw std::runtime_error(std::string("state entry ") + fieldName(field) +
+                               " is not stored with the requested type");
+
+    lockUpdateStateMutex();
+    store(offset, val, fieldSize(field));
+    unlockUpdateStateMutex();
     return true;
   };
 
   template <typename T>
   bool setStateData(const std::string& name, T& val)
   {
-    if (state_data_.find(name) != state_data_.end())
-    {
-      state_data_[name] = val;
-    }
-    else
-    {
-      return false;
-    }
-    return true;
+    Field field;
+    return findField(name, field) && setStateData(field, val);
   };
 
   struct StringVisitor : public boost::static_visitor<std::string>
@@ -183,16 +499,139 @@ class RobotState
   };
 
  public:
+  // Known variables with a value of their type, generated from UR_RTDE_ROBOT_STATE_FIELDS
   static std::unordered_map<std::string, rtde_type_variant_> state_types_;
 
  private:
-  std::unordered_map<std::string, rtde_type_variant_> state_data_;
+
+  /**
+   * Run the copy function until it has seen a complete state that was not modified while it was copied
+   * @returns the sequence number of the copied state
+   */
+  template <typename F>
+  std::uint64_t readConsistent(F copy) const
+  {
+    std::uint64_t sequence;
+    do
+    {
+      sequence = sequence_.load(std::memory_order_acquire);
+      if (sequence & 1)
+        continue;  // a package is being written
+      copy();
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) || sequence != sequence_.load(std::memory_order_relaxed));
+    return sequence / 2;
+  }
+
+  static ValueType valueType(const uint32_t &)
+  {
+    return ValueType::UINT32;
+  }
+  static ValueType valueType(const uint64_t &)
+  {
+    return ValueType::UINT64;
+  }
+  static ValueType valueType(const int32_t &)
+  {
+    return ValueType::INT32;
+  }
+  static ValueType valueType(const double &)
+  {
+    return ValueType::DOUBLE;
+  }
+  static ValueType valueType(const std::vector<double> &)
+  {
+    return ValueType::VECTOR_DOUBLE;
+  }
+  static ValueType valueType(const std::vector<int32_t> &)
+  {
+    return ValueType::VECTOR_INT32;
+  }
+
+  template <typename T>
+  static void prepare(T &, std::uint16_t)
+  {
+  }
+  template <typename T>
+  static void prepare(std::vector<T> &val, std::uint16_t size)
+  {
+    val.resize(size);
+  }
+
+  std::uint64_t loadWord(std::int32_t offset) const
+  {
+    return words_[offset].load(std::memory_order_relaxed);
+  }
+
+  void load(std::int32_t offset, uint32_t &val) const
+  {
+    val = static_cast<uint32_t>(loadWord(offset));
+  }
+  void load(std::int32_t offset, uint64_t &val) const
+  {
+    val = loadWord(offset);
+  }
+  void load(std::int32_t offset, int32_t &val) const
+  {
+    val = static_cast<int32_t>(static_cast<uint32_t>(loadWord(offset)));
+  }
+  void load(std::int32_t offset, double &val) const
+  {
+    std::uint64_t bits = loadWord(offset);
+    std::memcpy(&val, &bits, sizeof(val));
+  }
+  template <typename T>
+  void load(std::int32_t offset, std::vector<T> &val) const
+  {
+    for (std::size_t i = 0; i < val.size(); i++)
+      load(offset + static_cast<std::int32_t>(i), val[i]);
+  }
+
+  void store(std::int32_t offset, const uint32_t &val, std::uint16_t)
+  {
+    storeUInt32(offset, val);
+  }
+  void store(std::int32_t offset, const uint64_t &val, std::uint16_t)
+  {
+    storeUInt64(offset, val);
+  }
+  void store(std::int32_t offset, const int32_t &val, std::uint16_t)
+  {
+    storeInt32(offset, val);
+  }
+  void store(std::int32_t offset, const double &val, std::uint16_t)
+  {
+    storeDouble(offset, val);
+  }
+  void store(std::int32_t offset, const std::vector<double> &val, std::uint16_t size)
+  {
+    for (std::size_t i = 0; i < val.size() && i < size; i++)
+      storeDouble(offset + static_cast<std::int32_t>(i), val[i]);
+  }
+  void store(std::int32_t offset, const std::vector<int32_t> &val, std::uint16_t size)
+  {
+    for (std::size_t i = 0; i < val.size() && i < size; i++)
+      storeInt32(offset + static_cast<std::int32_t>(i), val[i]);
+  }
+
+ private:
+  // Value storage with room for every known variable, so it is never reallocated while readers use it. The
+  // variables are packed in subscription order from the start of a cache line, so a package updates only a few lines.
+  std::unique_ptr<std::atomic<std::uint64_t>[]> words_storage_;
+  std::atomic<std::uint64_t> *words_;
+  // Word offset of each variable, indexed by Field, -1 while the variable is not part of the state
+  std::unique_ptr<std::atomic<std::int32_t>[]> offsets_;
+  std::int32_t words_used_;
+  std::atomic<std::uint64_t> sequence_;
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
   std::mutex update_state_mutex_;
 #else
   PriorityInheritanceMutex update_state_mutex_;
 #endif
-  bool first_state_received_;
+  std::atomic<bool> first_state_received_;
+  std::mutex wait_mutex_;
+  std::condition_variable state_published_;
+  std::atomic<int> waiters_;
 };
 
 }  // namespace ur_rtde
@@ -3,25 +3,23 @@
 #define RTDE_H
 
 #include <ur_rtde/rtde_export.h>
+#include <ur_rtde/robot_state.h>
 
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/deadline_timer.hpp>
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 #include <tuple>
 
-// forward declarations
-namespace ur_rtde
-{
-class RobotState;
-}
-
 namespace ur_rtde
 {
 namespace details
@@ -108,6 +106,7 @@ class RTDE
       STOP_CONTACT_DETECTION = 63,
       READ_CONTACT_DETECTION = 64,
       SET_TARGET_PAYLOAD = 65,
+      PATH_APPEND = 66,
       WATCHDOG = 99,
       STOP_SCRIPT = 255
     };
@@ -164,6 +163,52 @@ class RTDE
     std::int32_t speed_slider_mask_;
     double speed_slider_fraction_;
     std::uint32_t steps_;
+    std::vector<std::int32_t> path_entry_kinds_;
+  };
+
+  /**
+   * A realtime command with its arguments stored inline instead of in vectors, so streaming commands like servoJ()
+   * can be built and sent without allocating. The capacity fits the largest input recipe (RECIPE_3: the command,
+   * 7 integer and 18 double arguments). On the wire the integer arguments follow the command type, then the double
+   * arguments follow, like the registers of the input recipes.
+   */
+  class RealtimeCommand
+  {
+   public:
+    static const std::size_t MAX_INT_ARGUMENTS = 7;
+    static const std::size_t MAX_DOUBLE_ARGUMENTS = 18;
+
+    RealtimeCommand(RobotCommand::Type type, std::uint8_t recipe_id)
+        : type_(type), recipe_id_(recipe_id), int_count_(0), double_count_(0)
+    {
+    }
+
+    void addInt(std::int32_t value)
+    {
+      if (int_count_ == MAX_INT_ARGUMENTS)
+        throw std::length_error("RealtimeCommand: too many integer arguments");
+      int_arguments_[int_count_++] = value;
+    }
+
+    void addDouble(double value)
+    {
+      if (double_count_ == MAX_DOUBLE_ARGUMENTS)
+        throw std::length_error("RealtimeCommand: too many double arguments");
+      double_arguments_[double_count_++] = value;
+    }
+
+    void addDoubles(const double *values, std::size_t count)
+    {
+      for (std::size_t i = 0; i < count; i++)
+        addDouble(values[i]);
+    }
+
+    RobotCommand::Type type_;
+    std::uint8_t recipe_id_;
+    std::array<std::int32_t, MAX_INT_ARGUMENTS> int_arguments_;
+    std::size_t int_count_;
+    std::array<double, MAX_DOUBLE_ARGUMENTS> double_arguments_;
+    std::size_t double_count_;
   };
 
   enum RTDECommand
@@ -186,24 +231,83 @@ class RTDE
     PAUSED = 3
   };
 
+  /**
+   * Wire types of the output fields, as reported by the controller in the reply to the output setup.
+   */
+  enum class WireType : std::uint8_t
+  {
+    BOOL,
+    UINT8,
+    UINT32,
+    UINT64,
+    INT32,
+    DOUBLE,
+    VECTOR3D,
+    VECTOR6D,
+    VECTOR6INT32,
+    VECTOR6UINT32
+  };
+
+  /**
+   * One step of the decode plan compiled from the output recipe. The plan is built once when the
+   * output setup is acknowledged, so decoding a data package is a straight loop over these entries.
+   */
+  struct DecodeEntry
+  {
+    std::uint16_t field_id;     // index into the output names of the recipe
+    WireType wire_type;         // type of the field on the wire
+    std::uint32_t offset;       // byte offset of the field in the data package payload
+    std::int32_t slot;          // word offset in the bound RobotState, -1 if the field is not stored
+  };
+
  public:
   RTDE_EXPORT void connect();
   RTDE_EXPORT void disconnect(bool send_pause = true);
   RTDE_EXPORT bool isConnected();
   RTDE_EXPORT bool isStarted();
   RTDE_EXPORT bool isDataAvailable();
+
+  /**
+   * @brief Block until data is available on the socket, the connection is closed or the timeout expires.
+   * @param timeout_ms the maximum time to wait in milliseconds, a negative value waits indefinitely
+   * @returns true if data (or a connection error) is pending on the socket, false on timeout
+   */
+  RTDE_EXPORT bool waitForData(int timeout_ms);
   RTDE_EXPORT bool negotiateProtocolVersion();
+
+  /**
+   * @brief Get the controller version. It is requested from the controller once per connection and cached.
+   * @returns the version as (major, minor, bugfix, build)
+   */
   RTDE_EXPORT std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t> getControllerVersion();
   RTDE_EXPORT void receive();
   RTDE_EXPORT boost::system::error_code receiveData(std::shared_ptr<RobotState> &robot_state);
 
-  RTDE_EXPORT void send(const RobotCommand &robot_cmd);
+  /**
+   * @brief Send a command as a data package on one of the input recipes
+   * @param robot_cmd the command, sent on the input recipe robot_cmd.recipe_id_ + recipe_offset
+   * @param recipe_offset offset of the sender's input recipes, when the connection is shared through an RTDESession
+   */
+  RTDE_EXPORT void send(const RobotCommand &robot_cmd, std::uint8_t recipe_offset = 0);
+
+  /**
+   * @brief Send a realtime command as a data package on one of the input recipes, without allocating
+   */
+  RTDE_EXPORT void send(const RealtimeCommand &robot_cmd, std::uint8_t recipe_offset = 0);
   RTDE_EXPORT void sendAll(const std::uint8_t &command, std::string payload = "");
   RTDE_EXPORT void sendStart();
   RTDE_EXPORT void sendPause();
   RTDE_EXPORT bool sendOutputSetup(const std::vector<std::string> &output_names, double frequency);
   RTDE_EXPORT bool sendInputSetup(const std::vector<std::string> &input_names);
 
+  /**
+   * @brief Set up the output recipe and all input recipes with a single round trip. The setup messages are written
+   * back-to-back, then the replies are read and validated in order. The input recipes are numbered from 1 in the
+   * given order, like with consecutive calls of sendInputSetup().
+   */
+  RTDE_EXPORT bool sendRecipeSetup(const std::vector<std::string> &output_names, double frequency,
+                                   const std::vector<std::vector<std::string>> &input_recipes);
+
 private:
   std::string hostname_;
   int port_;
@@ -214,8 +318,51 @@ private:
   boost::asio::io_service io_service_;
   std::shared_ptr<boost::asio::ip::tcp::socket> socket_;
   std::shared_ptr<boost::asio::ip::tcp::resolver> resolver_;
+  // Fixed capacity receive buffer, allocated once. Data packages are decoded in place from
+  // [buffer_begin_, buffer_end_) and the read position is reset once all packages are consumed.
   std::vector<char> buffer_;
+  std::size_t buffer_begin_;
+  std::size_t buffer_end_;
   boost::asio::deadline_timer deadline_;
+  // Serializes writes to the socket, which can be shared by several interfaces through an RTDESession
+  std::mutex send_mutex_;
+  // Encoding buffer of send(), reused for every command so sending does not allocate
+  std::vector<char> send_buffer_;
+  std::vector<DecodeEntry> decode_plan_;
+  std::uint32_t decode_size_;
+  std::weak_ptr<RobotState> decode_state_;
+  bool decode_plan_bound_;
+  std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t> controller_version_;
+  bool controller_version_received_;
+
+  /**
+   * Append a message with header to the buffer
+   */
+  static void packMessage(std::vector<char> &buffer, std::uint8_t command, const std::string &payload);
+
+  /**
+   * Write packed messages to the socket
+   */
+  void write(const std::vector<char> &buffer);
+
+  /**
+   * Receive and handle one control message
+   * \return The command of the message
+   */
+  std::uint8_t receiveMessage();
+
+  std::string packOutputSetup(const std::vector<std::string> &output_names, double frequency) const;
+  std::string packInputSetup(const std::vector<std::string> &input_names) const;
+
+  /**
+   * Compile the output types returned by the controller into the decode plan
+   */
+  void compileDecodePlan();
+
+  /**
+   * Resolve the destination slots of the decode plan in the given robot state
+   */
+  void bindDecodePlan(const std::shared_ptr<RobotState> &robot_state);
 
   /**
    * Async socket read function with timeout.
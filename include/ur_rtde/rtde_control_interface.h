@@ -8,9 +8,17 @@
 #if !defined(_WIN32) && !defined(__APPLE__)
 #include <urcl/script_sender.h>
 #endif
+#include <array>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
 #include <map>
+#include <mutex>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 
 #define MAJOR_VERSION 0
 #define MINOR_VERSION 1
@@ -24,6 +32,8 @@
 #define WAIT_FOR_PROGRAM_RUNNING_TIMEOUT 60
 #define RT_PRIORITY_UNDEFINED 0
 
+#define UR_JOINT_POSITION_MAX 6.283185307179586   // rad
+#define UR_JOINT_POSITION_MIN -6.283185307179586  // rad
 #define UR_JOINT_VELOCITY_MAX 3.14      // rad/s
 #define UR_JOINT_VELOCITY_MIN 0         // rad/s
 #define UR_JOINT_ACCELERATION_MAX 40.0  // rad/s^2
@@ -60,10 +70,15 @@ namespace ur_rtde
 {
 class RTDE;
 }
+namespace ur_rtde
+{
+class RTDESession;
+}
 
 namespace ur_rtde
 {
 class Path;
+struct PathEntry;
 
 struct Versions
 {
@@ -203,6 +218,17 @@ class RTDEControlInterface
                                             uint16_t flags = FLAGS_DEFAULT, int ur_cap_port = 50002,
                                             int rt_priority = RT_PRIORITY_UNDEFINED);
 
+  /**
+   * @brief Attach a control interface to a shared RTDE session. The output variables and input recipes of the
+   * interface are registered with the session, which receives the robot state on its own thread. The RTDE frequency
+   * and the realtime priority are those of the session. The control script is uploaded once the session is started
+   * with RTDESession::start(), the interface cannot send commands before.
+   */
+  RTDE_EXPORT explicit RTDEControlInterface(std::shared_ptr<RTDESession> session,
+                                            std::string heartbeat_ip,
+                                            std::string heartbeat_port,
+                                            uint16_t flags = FLAGS_DEFAULT, int ur_cap_port = 50002);
+
   RTDE_EXPORT virtual ~RTDEControlInterface();
 
   enum RobotStatus
@@ -275,6 +301,56 @@ class RTDEControlInterface
    */
   RTDE_EXPORT std::chrono::steady_clock::time_point initPeriod();
 
+  /**
+   * @brief Wait until the robot state of the next data package has been received. A control loop calling this once per
+   * cycle runs exactly once per received package, in phase with the controller, instead of on its own clock like
+   * waitPeriod(). A package received since the previous call is returned immediately, so a cycle that overran is not
+   * skipped. Not meant to be called from several threads at once.
+   * @param timeout the maximum time to wait
+   * @returns true when a new robot state is available, false on timeout
+   */
+  RTDE_EXPORT bool waitForNextState(std::chrono::microseconds timeout = std::chrono::milliseconds(100));
+
+  /**
+   * @returns the sequence number of the latest robot state, increased with every received data package
+   */
+  RTDE_EXPORT std::uint64_t getStateSequenceNumber();
+
+  /**
+   * @brief Wait until a robot state newer than the given sequence number has been received. Unlike waitForNextState()
+   * the sequence number is kept by the caller, so several threads can wait independently.
+   * @param sequence_number a sequence number returned by getStateSequenceNumber()
+   * @param timeout the maximum time to wait
+   * @returns true when a newer robot state is available, false on timeout
+   */
+  RTDE_EXPORT bool waitForState(std::uint64_t sequence_number, std::chrono::microseconds timeout);
+
+  /**
+   * @returns the frequency of the data packages in Hz, the control period is 1 / frequency
+   */
+  RTDE_EXPORT double getFrequency() const;
+
+  /**
+   * @brief Run commands of this interface asynchronously on its command executor, a single thread started with the
+   * first submitted command. Submitted commands run one after another in submission order, each completing the
+   * handshake with the control script before the next one starts. Commands called directly from other threads are
+   * serialized with them.
+   *
+   * Example: auto moved = rtde_control.submit([&](RTDEControlInterface &c) { return c.moveJ(q); });
+   * @param command a callable invoked with this interface on the executor thread
+   * @returns a future for the result of the command, which also carries an exception thrown by it. Commands still
+   * pending when the interface is destroyed are dropped, their futures report a broken promise.
+   */
+  template <typename Command>
+  std::future<decltype(std::declval<Command &>()(std::declval<RTDEControlInterface &>()))> submit(Command command)
+  {
+    using Result = decltype(std::declval<Command &>()(std::declval<RTDEControlInterface &>()));
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::bind(std::move(command), std::ref(*this)));
+    std::future<Result> result = task->get_future();
+    enqueueCommand([task]() { (*task)(); });
+    return result;
+  }
+
   /**
    * @brief In the event of an error, this function can be used to resume operation by reuploading the RTDE control
    * script. This will only happen if a script is not already running on the controller.
@@ -426,6 +502,16 @@ class RTDEControlInterface
    */
   RTDE_EXPORT bool speedJ(const std::vector<double> &qd, double acceleration = 0.5, double time = 0.0);
 
+  /**
+   * @brief speedJ() for a fixed size vector of joint speeds, which sends the command without allocating. Like the
+   * other std::array overloads it is a template, so a braced initializer list still selects the std::vector overload.
+   */
+  template <std::size_t N, typename std::enable_if<N == 6, int>::type = 0>
+  bool speedJ(const std::array<double, N> &qd, double acceleration = 0.5, double time = 0.0)
+  {
+    return sendSpeed(RTDE::RobotCommand::Type::SPEEDJ, qd.data(), acceleration, time);
+  }
+
   /**
    * @brief Tool speed - Accelerate linearly in Cartesian space and continue with constant tool speed. The time t is
    * optional;
@@ -435,6 +521,15 @@ class RTDEControlInterface
    */
   RTDE_EXPORT bool speedL(const std::vector<double> &xd, double acceleration = 0.25, double time = 0.0);
 
+  /**
+   * @brief speedL() for a fixed size tool speed, which sends the command without allocating
+   */
+  template <std::size_t N, typename std::enable_if<N == 6, int>::type = 0>
+  bool speedL(const std::array<double, N> &xd, double acceleration = 0.25, double time = 0.0)
+  {
+    return sendSpeed(RTDE::RobotCommand::Type::SPEEDL, xd.data(), acceleration, time);
+  }
+
   /**
    * @brief Servo to position (linear in joint-space)
    * @param q joint positions [rad]
@@ -447,6 +542,16 @@ class RTDEControlInterface
   RTDE_EXPORT bool servoJ(const std::vector<double> &q, double speed, double acceleration, double time,
                           double lookahead_time, double gain);
 
+  /**
+   * @brief servoJ() for fixed size joint positions, which sends the command without allocating
+   */
+  template <std::size_t N, typename std::enable_if<N == 6, int>::type = 0>
+  bool servoJ(const std::array<double, N> &q, double speed, double acceleration, double time, double lookahead_time,
+              double gain)
+  {
+    return sendServo(RTDE::RobotCommand::Type::SERVOJ, q.data(), speed, acceleration, time, lookahead_time, gain);
+  }
+
   /**
    * @brief Servo to position (linear in tool-space)
    * @param pose target pose
@@ -459,6 +564,16 @@ class RTDEControlInterface
   RTDE_EXPORT bool servoL(const std::vector<double> &pose, double speed, double acceleration, double time,
                           double lookahead_time, double gain);
 
+  /**
+   * @brief servoL() for a fixed size target pose, which sends the command without allocating
+   */
+  template <std::size_t N, typename std::enable_if<N == 6, int>::type = 0>
+  bool servoL(const std::array<double, N> &pose, double speed, double acceleration, double time,
+              double lookahead_time, double gain)
+  {
+    return sendServo(RTDE::RobotCommand::Type::SERVOL, pose.data(), speed, acceleration, time, lookahead_time, gain);
+  }
+
   /**
    * Move to each waypoint specified in the given path
    * @param path The path with waypoints
@@ -469,6 +584,35 @@ class RTDEControlInterface
    */
   RTDE_EXPORT bool movePath(const Path &path, bool asynchronous = false);
 
+  /**
+   * @brief Append the waypoints of a path to the path stream of the running control script. Unlike movePath() the
+   * script is not stopped and uploaded again, so consecutive paths are executed back-to-back and blended into each
+   * other while the robot is moving.
+   *
+   * The waypoints are transferred through the input registers, two per command, into a buffer of 16 waypoints in the
+   * control script. The first call starts the stream, stopping any other asynchronous movement. The stream ends when
+   * its buffer runs empty, the robot then stops at the last waypoint. The call blocks while the buffer is full, so
+   * it returns once the last waypoint has been queued, not when it has been reached. The progress of the stream is
+   * reported by getAsyncOperationProgress() with the index of the waypoint since the start of the stream, and
+   * stopJ() or stopL() stop it.
+   * @param path The path with waypoints, MoveC is not supported
+   * @returns false if the command was not accepted, or the stream or the control script stopped while waiting for
+   * free space
+   */
+  RTDE_EXPORT bool appendPath(const Path &path);
+
+  /**
+   * @brief Stream a path of any length with appendPath(), taking the waypoints from a source only as the buffer of
+   * the control script has room for them. The robot starts moving with the first waypoints, and neither the client
+   * nor the controller ever hold more than a window of the path, e.g. when reading a large path from a file.
+   * @param next_waypoint called for each waypoint, it sets the entry and returns true, or returns false at the end of
+   * the path
+   * @returns true once the source is exhausted and all its waypoints are queued, false like appendPath()
+   * @throws the exceptions of the source, and std::range_error or std::runtime_error for an invalid waypoint. The
+   * waypoints before it remain queued.
+   */
+  RTDE_EXPORT bool streamPath(const std::function<bool(PathEntry &entry)> &next_waypoint);
+
   /**
    * @brief Stop servo mode and decelerate the robot.
    * @param a rate of deceleration of the tool [m/s^2]
@@ -492,6 +636,15 @@ class RTDEControlInterface
   RTDE_EXPORT bool servoC(const std::vector<double> &pose, double speed = 0.25, double acceleration = 1.2,
                           double blend = 0.0);
 
+  /**
+   * @brief servoC() for a fixed size target pose, which sends the command without allocating
+   */
+  template <std::size_t N, typename std::enable_if<N == 6, int>::type = 0>
+  bool servoC(const std::array<double, N> &pose, double speed = 0.25, double acceleration = 1.2, double blend = 0.0)
+  {
+    return sendServoC(pose.data(), speed, acceleration, blend);
+  }
+
   /**
    * @brief Set robot to be controlled in force mode
    * @param task_frame A pose vector that defines the force frame relative to the base frame.
@@ -512,6 +665,16 @@ class RTDEControlInterface
   RTDE_EXPORT bool forceMode(const std::vector<double> &task_frame, const std::vector<int> &selection_vector,
                              const std::vector<double> &wrench, int type, const std::vector<double> &limits);
 
+  /**
+   * @brief forceMode() for fixed size vectors, which sends the command without allocating
+   */
+  template <std::size_t N, typename std::enable_if<N == 6, int>::type = 0>
+  bool forceMode(const std::array<double, N> &task_frame, const std::array<int, N> &selection_vector,
+                 const std::array<double, N> &wrench, int type, const std::array<double, N> &limits)
+  {
+    return sendForceMode(task_frame.data(), selection_vector.data(), wrench.data(), type, limits.data());
+  }
+
   /**
    * @brief Resets the robot mode from force mode to normal operation.
    */
@@ -676,9 +839,11 @@ class RTDEControlInterface
    * T_world->to = T_world->from * T_from->to
    * T_x->to = T_x->from * T_from->to
    * @endverbatim
+   * The pose is computed in the client with pose_math::poseTrans(), without a round trip to the controller.
    * @param p_from starting pose (spatial vector)
    * @param p_from_to pose change relative to starting pose (spatial vector)
    * @returns resulting pose (spatial vector)
+   * @throws std::invalid_argument if a pose does not have 6 elements
    */
   RTDE_EXPORT std::vector<double> poseTrans(const std::vector<double> &p_from, const std::vector<double> &p_from_to);
 
@@ -1095,10 +1260,43 @@ class RTDEControlInterface
   }
 
  private:
+  RTDEControlInterface(std::shared_ptr<RTDESession> session, std::string hostname, std::string heartbeat_ip,
+                       std::string heartbeat_port, double frequency, uint16_t flags, int ur_cap_port, int rt_priority);
+
   bool setupRecipes(const double &frequency);
 
+  // Clear the command register and start or wait for the control script, needs the robot state
+  void startControlScript();
+
   bool sendCommand(const RTDE::RobotCommand &cmd);
 
+  RTDE_EXPORT bool sendCommand(const RTDE::RealtimeCommand &cmd);
+
+  bool waitForReadyForCommand();
+
+  void waitForStateUpdate(std::uint64_t &sequence_number);
+
+  RTDE_EXPORT void enqueueCommand(std::function<void()> command);
+
+  void executorCallback();
+
+  void stopExecutor();
+
+  void updateStreamStatus();
+
+  bool isStreamReady();
+
+  // The realtime commands for 6 element targets, shared by the std::vector and std::array overloads
+  RTDE_EXPORT bool sendSpeed(RTDE::RobotCommand::Type type, const double *speed, double acceleration, double time);
+
+  RTDE_EXPORT bool sendServo(RTDE::RobotCommand::Type type, const double *target, double speed, double acceleration,
+                             double time, double lookahead_time, double gain);
+
+  RTDE_EXPORT bool sendServoC(const double *pose, double speed, double acceleration, double blend);
+
+  RTDE_EXPORT bool sendForceMode(const double *task_frame, const int *selection_vector, const double *wrench, int type,
+                                 const double *limits);
+
   void sendClearCommand();
 
   int getControlScriptState();
@@ -1123,8 +1321,6 @@ class RTDEControlInterface
 
   std::vector<double> getInverseKinematicsValue();
 
-  std::vector<double> poseTransValue();
-
   void verifyValueIsWithin(const double &value, const double &min, const double &max);
 
   std::string buildPathScriptCode(const std::vector<std::vector<double>> &path, const std::string &cmd);
@@ -1152,6 +1348,7 @@ class RTDEControlInterface
   int getOutputIntReg(int reg);
 
  private:
+  std::shared_ptr<RTDESession> session_;
   std::string hostname_;
   std::string heartbeat_ip_;
   std::string heartbeat_port_;
@@ -1170,11 +1367,28 @@ class RTDEControlInterface
   double delta_time_;
   int register_offset_;
   std::shared_ptr<RTDE> rtde_;
+  // Offset of the input recipes of this interface on a connection shared through session_
+  std::uint8_t recipe_offset_{0};
   std::atomic<bool> stop_thread_{false};
   std::shared_ptr<boost::thread> th_;
   std::shared_ptr<DashboardClient> db_client_;
   std::shared_ptr<ScriptClient> script_client_;
   std::shared_ptr<RobotState> robot_state_;
+  std::uint64_t last_state_sequence_number_{0};
+  // Set once the control script accepted the first realtime command of a stream, the following setpoints skip the
+  // ready-for-command checks while stream_ready_ holds
+  std::atomic<bool> streaming_{false};
+  // Whether the robot state allows streaming (script running, no protective or emergency stop) and the state it was
+  // computed from, updated once per received state
+  std::atomic<bool> stream_ready_{false};
+  std::atomic<std::uint64_t> stream_status_sequence_{UINT64_MAX};
+  // Serializes the commands of the executor and of other calling threads, so the RDY/DONE handshakes do not interleave
+  std::recursive_mutex command_mutex_;
+  std::mutex executor_mutex_;
+  std::condition_variable executor_cv_;
+  std::deque<std::function<void()>> executor_queue_;
+  bool stop_executor_{false};
+  std::shared_ptr<boost::thread> executor_thread_;
 #if !defined(_WIN32) && !defined(__APPLE__)
   std::unique_ptr<urcl::control::ScriptSender> urcl_script_sender_;
 #endif
@@ -1182,7 +1396,6 @@ class RTDEControlInterface
   // major, minor, bugfix, build numbers.
   Versions versions_{};
   std::string serial_number_;
-  size_t no_bytes_avail_cnt_;
 };
 
 /**
@@ -29,6 +29,29 @@ be considered thread safe, since no measures (mutexes) are taken to
 ensure that a function is done, before another would be executed. It
 is up to the caller to provide protection using mutexes.)doc";
 
+static const char *__doc_ur_rtde_RTDEControlInterface_appendPath =
+R"doc(Append the waypoints of a path to the path stream of the running
+control script. Unlike movePath() the script is not stopped and
+uploaded again, so consecutive paths are executed back-to-back and
+blended into each other while the robot is moving.
+
+The waypoints are transferred through the input registers, two per
+command, into a buffer of 16 waypoints in the control script. The
+first call starts the stream, stopping any other asynchronous
+movement. The stream ends when its buffer runs empty, the robot then
+stops at the last waypoint. The call blocks while the buffer is full,
+so it returns once the last waypoint has been queued, not when it has
+been reached. The progress of the stream is reported by
+getAsyncOperationProgress() with the index of the waypoint since the
+start of the stream, and stopJ() or stopL() stop it.
+
+Parameter ``path``:
+    The path with waypoints, MoveC is not supported
+
+Returns:
+    false if the command was not accepted, or the stream or the
+    control script stopped while waiting for free space)doc";
+
 static const char *__doc_ur_rtde_RTDEControlInterface_disconnect =
 R"doc(Returns:
     Can be used to disconnect from the robot. To reconnect you have to
@@ -512,7 +535,9 @@ the parameters of p_from. Or the function is used to get the resulting
 pose, when first making a move of p_from and then from there, a move
 of p_from_to. If the poses were regarded as transformation matrices,
 it would look like: @verbatim T_world->to = T_world->from * T_from->to
-T_x->to = T_x->from * T_from->to @endverbatim
+T_x->to = T_x->from * T_from->to @endverbatim The pose is computed in
+the client with pose_math::poseTrans(), without a round trip to the
+controller.
 
 Parameter ``p_from``:
     starting pose (spatial vector)
@@ -521,7 +546,10 @@ Parameter ``p_from_to``:
     pose change relative to starting pose (spatial vector)
 
 Returns:
-    resulting pose (spatial vector))doc";
+    resulting pose (spatial vector)
+
+Throws:
+    std::invalid_argument if a pose does not have 6 elements)doc";
 
 static const char *__doc_ur_rtde_RTDEControlInterface_reconnect =
 R"doc(Returns:
@@ -729,6 +757,20 @@ Parameter ``a``:
 
 static const char *__doc_ur_rtde_RTDEControlInterface_stopScript = R"doc(This function will terminate the script on controller.)doc";
 
+static const char *__doc_ur_rtde_RTDEControlInterface_streamPath =
+R"doc(Stream a path of any length with appendPath(), taking the waypoints
+from a source only as the buffer of the control script has room for
+them. The robot starts moving with the first waypoints, and neither
+the client nor the controller ever hold more than a window of the
+path, e.g. when reading a large path from a file.
+
+Parameter ``waypoints``:
+    an iterable of PathEntry, consumed lazily
+
+Returns:
+    true once the source is exhausted and all its waypoints are
+    queued, false like appendPath())doc";
+
 static const char *__doc_ur_rtde_RTDEControlInterface_teachMode =
 R"doc(Set robot in freedrive mode. In this mode the robot can be moved
 around by hand in the same way as by pressing the "freedrive" button.
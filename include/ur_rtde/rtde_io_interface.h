@@ -11,6 +11,12 @@
 #define CB3_MAJOR_VERSION 3
 #define RT_PRIORITY_UNDEFINED 0
 
+// forward declarations
+namespace ur_rtde
+{
+class RTDESession;
+}
+
 namespace ur_rtde
 {
 class RTDEIOInterface
@@ -19,6 +25,13 @@ class RTDEIOInterface
   RTDE_EXPORT explicit RTDEIOInterface(std::string hostname, bool verbose = false,
                                        bool use_upper_range_registers = false, int rt_priority = RT_PRIORITY_UNDEFINED);
 
+  /**
+   * @brief Attach an IO interface to a shared RTDE session, its input recipes are registered on the connection of
+   * the session. Commands can be sent once the session has been started with RTDESession::start().
+   */
+  RTDE_EXPORT explicit RTDEIOInterface(std::shared_ptr<RTDESession> session, bool verbose = false,
+                                       bool use_upper_range_registers = false);
+
   RTDE_EXPORT virtual ~RTDEIOInterface();
 
   enum RobotStatus
@@ -105,6 +118,9 @@ class RTDEIOInterface
   RTDE_EXPORT bool setInputDoubleRegister(int input_id, double value);
 
  private:
+  RTDEIOInterface(std::shared_ptr<RTDESession> session, std::string hostname, bool verbose,
+                  bool use_upper_range_registers, int rt_priority);
+
   bool setupRecipes();
 
   std::string inDoubleReg(int reg) const;
@@ -116,6 +132,7 @@ class RTDEIOInterface
   void verifyValueIsWithin(const double &value, const double &min, const double &max);
 
  private:
+  std::shared_ptr<RTDESession> session_;
   std::string hostname_;
   int port_;
   bool verbose_;
@@ -123,6 +140,8 @@ class RTDEIOInterface
   int rt_priority_;
   int register_offset_;
   std::shared_ptr<RTDE> rtde_;
+  // Offset of the input recipes of this interface on a connection shared through session_
+  std::uint8_t recipe_offset_{0};
 };
 
 }  // namespace ur_rtde
@@ -6,6 +6,7 @@
 #include <ur_rtde/robot_state.h>
 #include <ur_rtde/rtde_utility.h>
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <memory>
@@ -38,9 +39,68 @@ namespace ur_rtde
 {
 class RTDE;
 }
+namespace ur_rtde
+{
+class RTDESession;
+}
+namespace ur_rtde
+{
+class StateRecorder;
+}
 
 namespace ur_rtde
 {
+/**
+ * All robot state variables provided by the RTDEReceiveInterface, copied from one data package by
+ * RTDEReceiveInterface::getSnapshot(). The members are named after the RTDE output variables, variables that are
+ * not subscribed keep their value.
+ */
+struct RobotStateSnapshot
+{
+  std::uint64_t sequence_number{};  // increases with every received data package
+  double timestamp{};
+  std::array<double, 6> target_q{};
+  std::array<double, 6> target_qd{};
+  std::array<double, 6> target_qdd{};
+  std::array<double, 6> target_current{};
+  std::array<double, 6> target_moment{};
+  std::array<double, 6> actual_q{};
+  std::array<double, 6> actual_qd{};
+  std::array<double, 6> actual_current{};
+  std::array<double, 6> joint_control_output{};
+  std::array<double, 6> actual_TCP_pose{};
+  std::array<double, 6> actual_TCP_speed{};
+  std::array<double, 6> actual_TCP_force{};
+  std::array<double, 6> target_TCP_pose{};
+  std::array<double, 6> target_TCP_speed{};
+  std::uint64_t actual_digital_input_bits{};
+  std::array<double, 6> joint_temperatures{};
+  double actual_execution_time{};
+  std::int32_t robot_mode{};
+  std::array<std::int32_t, 6> joint_mode{};
+  std::int32_t safety_mode{};
+  std::array<double, 3> actual_tool_accelerometer{};
+  double speed_scaling{};
+  double target_speed_fraction{};
+  double actual_momentum{};
+  double actual_main_voltage{};
+  double actual_robot_voltage{};
+  double actual_robot_current{};
+  std::array<double, 6> actual_joint_voltage{};
+  std::uint64_t actual_digital_output_bits{};
+  std::uint32_t runtime_state{};
+  std::uint32_t robot_status_bits{};
+  std::uint32_t safety_status_bits{};
+  double standard_analog_input0{};
+  double standard_analog_input1{};
+  double standard_analog_output0{};
+  double standard_analog_output1{};
+  std::array<double, 6> ft_raw_wrench{};
+  double payload{};
+  std::array<double, 3> payload_cog{};
+  std::array<double, 6> payload_inertia{};
+};
+
 class RTDEReceiveInterface
 {
  public:
@@ -49,6 +109,15 @@ class RTDEReceiveInterface
                                             bool verbose = false, bool use_upper_range_registers = false,
                                             int rt_priority = RT_PRIORITY_UNDEFINED);
 
+  /**
+   * @brief Attach a receive interface to a shared RTDE session. The variables are added to the subscription of the
+   * session, which receives the robot state on its own thread at the frequency of the session once it has been
+   * started with RTDESession::start().
+   */
+  RTDE_EXPORT explicit RTDEReceiveInterface(std::shared_ptr<RTDESession> session,
+                                            std::vector<std::string> variables = {}, bool verbose = false,
+                                            bool use_upper_range_registers = false);
+
   RTDE_EXPORT virtual ~RTDEReceiveInterface();
 
   enum SafetyStatus
@@ -139,6 +208,15 @@ class RTDEReceiveInterface
     RAMPUP
   };
 
+  /**
+   * File format of startFileRecording()
+   */
+  enum class RecordingFormat
+  {
+    CSV,    // one text row per recording period, readable right away
+    BINARY  // every data package as a fixed-width row, see StateRecorder and convertRecordingToCsv()
+  };
+
   /**
    * @returns Can be used to disconnect from the robot. To reconnect you have to call the reconnect() function.
    */
@@ -165,15 +243,45 @@ class RTDEReceiveInterface
   RTDE_EXPORT std::chrono::steady_clock::time_point initPeriod();
 
   /**
-   * @returns Can be used to reconnect to the robot after a lost connection.
+   * @brief Wait until the robot state of the next data package has been received. A control loop calling this once per
+   * cycle runs exactly once per received package, in phase with the controller, instead of on its own clock like
+   * waitPeriod(). A package received since the previous call is returned immediately, so a cycle that overran is not
+   * skipped. Not meant to be called from several threads at once.
+   * @param timeout the maximum time to wait
+   * @returns true when a new robot state is available, false on timeout
    */
-  RTDE_EXPORT bool startFileRecording(const std::string &filename, const std::vector<std::string> &variables={});
+  RTDE_EXPORT bool waitForNextState(std::chrono::microseconds timeout = std::chrono::milliseconds(100));
 
   /**
-   * @returns Can be used to reconnect to the robot after a lost connection.
+   * @returns the sequence number of the latest robot state, increased with every received data package
+   */
+  RTDE_EXPORT std::uint64_t getStateSequenceNumber();
+
+  /**
+   * @brief Start recording the robot state into a file until stopFileRecording() is called.
+   * @param filename the file to record into
+   * @param variables the variables to record, all variables of the interface if empty
+   * @param format CSV formats a row every period while recording. BINARY records every data package without
+   * formatting, and is meant for long or high frequency recordings, convert it afterwards with
+   * convertRecordingToCsv().
+   * @throws std::runtime_error if a binary recording cannot be started
+   */
+  RTDE_EXPORT bool startFileRecording(const std::string &filename, const std::vector<std::string> &variables = {},
+                                      RecordingFormat format = RecordingFormat::CSV);
+
+  /**
+   * @brief Stop the recording started by startFileRecording() and close the file.
+   * @returns false if writing a binary recording failed
    */
   RTDE_EXPORT bool stopFileRecording();
 
+  /**
+   * @brief Convert a binary recording of startFileRecording() into a CSV file with the columns of a CSV recording.
+   * @throws std::runtime_error if a file cannot be opened or the recording is not valid
+   */
+  RTDE_EXPORT static void convertRecordingToCsv(const std::string &recording_filename,
+                                                const std::string &csv_filename);
+
   /**
    * @returns Connection status for RTDE, useful for checking for lost connection.
    */
@@ -459,6 +567,13 @@ class RTDEReceiveInterface
    */
   RTDE_EXPORT std::vector<double> getPayloadInertia();
 
+  /**
+   * @brief Copy all subscribed variables of the latest robot state into the snapshot. The values are taken from a
+   * single data package and the call does not allocate, so it is suitable for use in a control loop.
+   * @param snapshot the snapshot to fill, variables that are not subscribed are left untouched
+   */
+  RTDE_EXPORT void getSnapshot(RobotStateSnapshot &snapshot);
+
   RTDE_EXPORT double getRtdeFrequency();
 
   RTDE_EXPORT void receiveCallback();
@@ -470,8 +585,14 @@ class RTDEReceiveInterface
   }
 
  private:
+  RTDEReceiveInterface(std::shared_ptr<RTDESession> session, std::string hostname, double frequency,
+                       std::vector<std::string> variables, bool verbose, bool use_upper_range_registers,
+                       int rt_priority);
+
   bool setupRecipes(const double& frequency);
 
+  void bindSnapshotPlan();
+
   std::string outDoubleReg(int reg) const
   {
     return "output_double_register_" + std::to_string(register_offset_ + reg);
@@ -489,6 +610,7 @@ class RTDEReceiveInterface
   }
 
  private:
+  std::shared_ptr<RTDESession> session_;
   std::string hostname_;
   double frequency_;
   std::vector<std::string> variables_;
@@ -504,12 +626,14 @@ class RTDEReceiveInterface
   std::shared_ptr<boost::thread> th_;
   std::shared_ptr<boost::thread> record_thrd_;
   std::shared_ptr<RobotState> robot_state_;
+  std::uint64_t last_state_sequence_number_{0};
+  std::vector<RobotState::CopyEntry> snapshot_plan_;
   PausingState pausing_state_;
   std::shared_ptr<std::ofstream> file_recording_;
   std::vector<std::string> record_variables_;
+  std::shared_ptr<StateRecorder> state_recorder_;
   double speed_scaling_combined_{};
   double pausing_ramp_up_increment_;
-  size_t no_bytes_avail_cnt_;
 };
 
 }  // namespace ur_rtde
@@ -0,0 +1,169 @@
+#pragma once
+#ifndef RTDE_SESSION_H
+#define RTDE_SESSION_H
+
+#include <ur_rtde/rtde_export.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#define RT_PRIORITY_UNDEFINED 0
+
+// forward declarations
+namespace boost
+{
+class thread;
+}
+namespace ur_rtde
+{
+class RobotState;
+}
+namespace ur_rtde
+{
+class RTDE;
+}
+
+namespace ur_rtde
+{
+/**
+ * A single RTDE connection to a robot, shared by the RTDEControlInterface, RTDEReceiveInterface and RTDEIOInterface
+ * constructed with it.
+ *
+ * The session negotiates the protocol version and fetches the controller version once. It subscribes to the union of
+ * the output variables requested by the attached interfaces and runs one receive thread, which decodes the data
+ * packages into a single RobotState read by all of them. The input recipes of every interface are registered on the
+ * same socket, each interface sends its commands with its recipe ids shifted by the offset returned from subscribe().
+ *
+ * Construct all interfaces with the session first and call start() afterwards, which sets up the recipes of all of
+ * them and starts data synchronization once. An RTDEControlInterface uploads its control script when the session is
+ * started. Attaching an interface to a started session re-establishes the connection with the extended recipes, which
+ * interrupts the data stream and the registers of a running control script for a few controller cycles.
+ *
+ * @code
+ * auto session = std::make_shared<RTDESession>("192.168.1.10");
+ * RTDEControlInterface rtde_control(session, heartbeat_ip, heartbeat_port);
+ * RTDEReceiveInterface rtde_receive(session);
+ * session->start();
+ * @endcode
+ */
+class RTDESession
+{
+ public:
+  /**
+   * @param hostname the hostname or IP address of the robot
+   * @param frequency the output frequency, -1 selects 125 Hz on CB3 and 500 Hz on e-Series robots
+   * @param verbose print connection information
+   * @param rt_priority realtime priority of the receive thread, used when a realtime kernel is available
+   */
+  RTDE_EXPORT explicit RTDESession(std::string hostname, double frequency = -1.0, bool verbose = false,
+                                   int rt_priority = RT_PRIORITY_UNDEFINED);
+
+  RTDE_EXPORT virtual ~RTDESession();
+
+  /**
+   * @brief Add output variables and input recipes to the session. Before start() they are only collected, on a
+   * started session data synchronization is restarted with them and this returns once the first robot state of the
+   * extended subscription has been received.
+   * @param output_names the output variables needed by the caller, variables already subscribed are shared
+   * @param input_recipes the input recipes of the caller, numbered from 1 in the given order
+   * @returns the offset to add to the caller's recipe ids when sending on the shared connection
+   */
+  RTDE_EXPORT std::uint8_t subscribe(const std::vector<std::string> &output_names,
+                                     const std::vector<std::vector<std::string>> &input_recipes);
+
+  /**
+   * @brief Set up the recipes of all attached interfaces and start data synchronization. Returns once the first robot
+   * state has been received and the start callbacks of the interfaces have run. Does nothing if already started.
+   */
+  RTDE_EXPORT void start();
+
+  /**
+   * @returns true once start() has been called
+   */
+  RTDE_EXPORT bool isStarted() const;
+
+  /**
+   * @brief Run a callback of an attached interface from start(), after data synchronization has started. Used by
+   * interfaces that need the robot state to finish their setup.
+   * @param owner identifies the callback for removeStartCallbacks()
+   */
+  RTDE_EXPORT void addStartCallback(const void *owner, std::function<void()> callback);
+
+  /**
+   * @brief Remove the callbacks of an interface that is destroyed before the session is started.
+   */
+  RTDE_EXPORT void removeStartCallbacks(const void *owner);
+
+  /**
+   * @brief Stop the receive thread and close the connection to the robot.
+   */
+  RTDE_EXPORT void disconnect();
+
+  /**
+   * @brief Re-establish the connection after it has been lost, with the recipes of all attached interfaces. The
+   * recipe offsets returned by subscribe() stay valid.
+   */
+  RTDE_EXPORT bool reconnect();
+
+  RTDE_EXPORT bool isConnected();
+
+  /**
+   * @returns the hostname of the robot
+   */
+  RTDE_EXPORT const std::string &getHostname() const;
+
+  /**
+   * @returns the output frequency of the shared subscription in Hz
+   */
+  RTDE_EXPORT double getFrequency() const;
+
+  /**
+   * @returns the controller version (major, minor, bugfix, build) of the robot
+   */
+  RTDE_EXPORT std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t> getControllerVersion() const;
+
+  const std::shared_ptr<RTDE> &rtde() const
+  {
+    return rtde_;
+  }
+
+  const std::shared_ptr<RobotState> &robot_state() const
+  {
+    return robot_state_;
+  }
+
+ private:
+  void receiveCallback();
+
+  void restartConnection();
+
+  void startSynchronization();
+
+  void stopReceiveThread();
+
+ private:
+  std::string hostname_;
+  double frequency_;
+  bool verbose_;
+  int rt_priority_;
+  std::shared_ptr<RTDE> rtde_;
+  std::shared_ptr<RobotState> robot_state_;
+  std::vector<std::string> output_names_;
+  std::vector<std::vector<std::string>> input_recipes_;
+  std::vector<std::pair<const void *, std::function<void()>>> start_callbacks_;
+  std::atomic<bool> started_{false};
+  std::mutex setup_mutex_;
+  std::atomic<bool> stop_receive_thread_{false};
+  std::shared_ptr<boost::thread> th_;
+};
+
+}  // namespace ur_rtde
+
+#endif  // RTDE_SESSION_H
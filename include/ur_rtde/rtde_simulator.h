@@ -0,0 +1,169 @@
+#pragma once
+#ifndef RTDE_SIMULATOR_H
+#define RTDE_SIMULATOR_H
+
+#include <ur_rtde/rtde.h>
+#include <ur_rtde/rtde_export.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ur_rtde
+{
+/**
+ * A loopback stand-in for a UR controller, intended for testing and benchmarking ur_rtde without a robot.
+ *
+ * The simulator serves the RTDE interface (protocol negotiation, controller version, output and input recipes,
+ * start/pause and data packages at a configurable rate), accepts scripts on the script port and answers the
+ * dashboard commands used by the interfaces. Once the rtde_control script has been uploaded the simulator
+ * emulates its register handshake (RDY_FOR_CMD / DONE_WITH_CMD), so RTDEControlInterface, RTDEReceiveInterface
+ * and RTDEIOInterface can all be constructed against it. The robot itself is not simulated: move and servo
+ * targets are applied instantaneously and queries return the current state or zeros.
+ */
+class RTDESimulator
+{
+ public:
+  struct Statistics
+  {
+    std::uint64_t ticks;               // controller cycles executed
+    std::uint64_t overruns;            // controller cycles that started later than one period after their deadline
+    std::uint64_t packages_sent;       // data packages sent to all clients
+    std::uint64_t packages_received;   // data packages received from all clients
+    std::uint64_t commands_processed;  // control script commands processed
+  };
+
+  /**
+   * @param address the address the simulator listens on, use 127.0.0.x to run several simulators on one host
+   * @param frequency the controller cycle frequency in Hz, data packages are streamed at this rate unless a
+   * client asks for a lower frequency in its output setup.
+   * @param verbose print client connections and handshake messages
+   */
+  RTDE_EXPORT explicit RTDESimulator(std::string address = "127.0.0.1", double frequency = 500.0,
+                                     bool verbose = false);
+
+  RTDE_EXPORT virtual ~RTDESimulator();
+
+  /**
+   * @brief Set the controller version reported to the clients, default is 5.11.0.0. Must be called before start().
+   */
+  RTDE_EXPORT void setControllerVersion(std::uint32_t major, std::uint32_t minor, std::uint32_t bugfix,
+                                        std::uint32_t build);
+
+  /**
+   * @brief Set the ports the simulator listens on, default is 30004, 30003 and 29999. Must be called before start().
+   */
+  RTDE_EXPORT void setPorts(int rtde_port, int script_port, int dashboard_port);
+
+  /**
+   * @brief Open the listening sockets and start the controller cycle.
+   */
+  RTDE_EXPORT void start();
+
+  /**
+   * @brief Close all client connections and stop the controller cycle.
+   */
+  RTDE_EXPORT void stop();
+
+  RTDE_EXPORT bool isRunning() const;
+
+  /**
+   * @returns true if a control script has been uploaded and is being emulated
+   */
+  RTDE_EXPORT bool isScriptRunning();
+
+  RTDE_EXPORT Statistics getStatistics();
+
+  /**
+   * @brief Get the current value of a controller variable, e.g. "actual_q" or "input_int_register_0".
+   * Integer types are returned as doubles. An empty vector is returned for unknown variables.
+   */
+  RTDE_EXPORT std::vector<double> getVariable(const std::string &name);
+
+  /**
+   * @brief Set the value of a controller variable, e.g. to inject a protective stop through "safety_status_bits".
+   * @returns false if the variable is unknown or the size does not match
+   */
+  RTDE_EXPORT bool setVariable(const std::string &name, const std::vector<double> &value);
+
+ private:
+  struct Variable
+  {
+    RTDE::WireType type;
+    std::vector<double> value;
+    bool input;
+  };
+
+  struct Field
+  {
+    RTDE::WireType type;
+    double *value;
+  };
+
+  struct Client
+  {
+    int fd = -1;
+    std::thread thread;
+    std::mutex write_mutex;
+    std::mutex recipe_mutex;
+    std::atomic<bool> alive{true};
+    bool started = false;
+    std::uint32_t decimation = 1;
+    std::uint32_t cycle = 0;
+    std::vector<Field> outputs;
+    std::vector<std::vector<Field>> input_recipes;
+    std::vector<char> package;
+  };
+
+  std::string address_;
+  double frequency_;
+  bool verbose_;
+  int rtde_port_;
+  int script_port_;
+  int dashboard_port_;
+  std::uint32_t version_[4];
+  std::atomic<bool> running_;
+  std::vector<int> listen_fds_;
+  std::vector<std::thread> threads_;
+  std::mutex clients_mutex_;
+  std::vector<std::shared_ptr<Client>> clients_;
+  std::vector<std::thread> service_threads_;
+
+  std::mutex model_mutex_;
+  std::map<std::string, Variable> variables_;
+  Statistics statistics_;
+  bool script_running_;
+  bool executing_cmd_;
+  int register_offset_;
+  double *in_int_[48];
+  double *in_double_[48];
+  double *out_int_[48];
+  double *out_double_[48];
+
+  void addVariable(const std::string &name, RTDE::WireType type, bool input);
+  double *variable(const std::string &name);
+  int listenOn(int port);
+  void acceptLoop(int listen_fd, int port);
+  void controllerLoop();
+  void tick(double dt);
+  void emulateScript();
+  bool processCommand(int cmd);
+  void startScript(const std::string &script);
+  void stopScript();
+
+  void rtdeClientLoop(std::shared_ptr<Client> client);
+  void handleRTDEMessage(const std::shared_ptr<Client> &client, std::uint8_t cmd, const std::vector<char> &payload);
+  bool sendRTDEMessage(const std::shared_ptr<Client> &client, std::uint8_t cmd, const std::vector<char> &payload);
+  void scriptClientLoop(int fd);
+  void dashboardClientLoop(int fd);
+  std::string dashboardReply(const std::string &request);
+};
+
+}  // namespace ur_rtde
+
+#endif  // RTDE_SIMULATOR_H
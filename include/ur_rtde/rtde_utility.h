@@ -90,6 +90,11 @@ class RTDEUtility
 {
  public:
   static inline RTDEControlHeader readRTDEHeader(const std::vector<char> &data, uint32_t &message_offset)
+  {
+    return readRTDEHeader(data.data(), message_offset);
+  }
+
+  static inline RTDEControlHeader readRTDEHeader(const char *data, uint32_t &message_offset)
   {
     RTDEControlHeader rtde_control_header;
     rtde_control_header.msg_size = RTDEUtility::getUInt16(data, message_offset);
@@ -97,6 +102,32 @@ class RTDEUtility
     return rtde_control_header;
   }
 
+  /**
+   * @brief Write a value in network byte order to the buffer, without allocating
+   * @returns the position after the written value
+   */
+  static inline char *writeUInt32(char *buffer, uint32_t uint32)
+  {
+    buffer[0] = static_cast<char>(uint32 >> 24);
+    buffer[1] = static_cast<char>(uint32 >> 16);
+    buffer[2] = static_cast<char>(uint32 >> 8);
+    buffer[3] = static_cast<char>(uint32);
+    return buffer + 4;
+  }
+
+  static inline char *writeInt32(char *buffer, int32_t int32)
+  {
+    return writeUInt32(buffer, static_cast<uint32_t>(int32));
+  }
+
+  static inline char *writeDouble(char *buffer, double d)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    buffer = writeUInt32(buffer, static_cast<uint32_t>(bits >> 32));
+    return writeUInt32(buffer, static_cast<uint32_t>(bits));
+  }
+
   static inline std::vector<char> packUInt32(uint32_t uint32)
   {
     std::vector<char> result;
@@ -219,6 +250,11 @@ class RTDEUtility
   }
 
   static inline double getDouble(const std::vector<char> &data, uint32_t &message_offset)
+  {
+    return getDouble(data.data(), message_offset);
+  }
+
+  static inline double getDouble(const char *data, uint32_t &message_offset)
   {
     double output;
 
@@ -236,6 +272,11 @@ class RTDEUtility
   }
 
   static inline uint32_t getUInt32(const std::vector<char> &data, uint32_t &message_offset)
+  {
+    return getUInt32(data.data(), message_offset);
+  }
+
+  static inline uint32_t getUInt32(const char *data, uint32_t &message_offset)
   {
     uint32_t output = 0;
     ((char *)(&output))[3] = data[message_offset];
@@ -248,6 +289,11 @@ class RTDEUtility
   }
 
   static inline uint16_t getUInt16(const std::vector<char> &data, uint32_t &message_offset)
+  {
+    return getUInt16(data.data(), message_offset);
+  }
+
+  static inline uint16_t getUInt16(const char *data, uint32_t &message_offset)
   {
     uint16_t output = 0;
     ((char *)(&output))[1] = data[message_offset + 0];
@@ -258,6 +304,11 @@ class RTDEUtility
   }
 
   static inline int32_t getInt32(const std::vector<char> &data, uint32_t &message_offset)
+  {
+    return getInt32(data.data(), message_offset);
+  }
+
+  static inline int32_t getInt32(const char *data, uint32_t &message_offset)
   {
     int32_t output = 0;
     ((char *)(&output))[3] = data[message_offset];
@@ -269,6 +320,11 @@ class RTDEUtility
   }
 
   static inline uint64_t getUInt64(const std::vector<char> &data, uint32_t &message_offset)
+  {
+    return getUInt64(data.data(), message_offset);
+  }
+
+  static inline uint64_t getUInt64(const char *data, uint32_t &message_offset)
   {
     uint64_t output;
 
@@ -286,6 +342,11 @@ class RTDEUtility
   }
 
   static inline unsigned char getUChar(const std::vector<char> &data, uint32_t &message_offset)
+  {
+    return getUChar(data.data(), message_offset);
+  }
+
+  static inline unsigned char getUChar(const char *data, uint32_t &message_offset)
   {
     unsigned char output = data[message_offset];
     message_offset += 1;
@@ -293,6 +354,11 @@ class RTDEUtility
   }
 
   static inline uint8_t getUInt8(const std::vector<char> &data, uint32_t &message_offset)
+  {
+    return getUInt8(data.data(), message_offset);
+  }
+
+  static inline uint8_t getUInt8(const char *data, uint32_t &message_offset)
   {
     uint8_t output = data[message_offset];
     message_offset += 1;
@@ -526,6 +592,48 @@ class RTDEUtility
 #endif
   }
 
+  /**
+   * @brief Pin the calling thread to a cpu core, e.g. one isolated from the scheduler with isolcpus
+   * @param cpu the index of the core
+   * @returns true on success, false if pinning failed or is not supported on this platform
+   */
+  static bool setThreadAffinity(int cpu)
+  {
+    if (cpu < 0)
+    {
+      std::cerr << "ur_rtde: invalid cpu core " << cpu << " specified, the thread will not be pinned!" << std::endl;
+      return false;
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+    if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8) ||
+        SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu) == 0)
+    {
+      std::cerr << "ur_rtde: unable to pin the thread to cpu core " << cpu << std::endl;
+      return false;
+    }
+    return true;
+#elif defined(__linux__)
+    if (cpu >= CPU_SETSIZE)
+    {
+      std::cerr << "ur_rtde: unable to pin the thread to cpu core " << cpu << std::endl;
+      return false;
+    }
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (error != 0)
+    {
+      std::cerr << "ur_rtde: unable to pin the thread to cpu core " << cpu << ": " << strerror(error) << std::endl;
+      return false;
+    }
+    return true;
+#else
+    std::cerr << "ur_rtde: pinning threads to cpu cores is not supported on this platform" << std::endl;
+    return false;
+#endif
+  }
+
 };
 
 }  // namespace ur_rtde
@@ -52,9 +52,20 @@ class ScriptClient
    */
   RTDE_EXPORT void setScriptFile(const std::string& file_name);
 
+  /**
+   * Keep the control scripts filtered for the controller versions in the
+   * given directory, in addition to the cache in memory. Both are shared by
+   * all clients of the process, so this is set once before the first
+   * RTDEControlInterface is created. An empty directory, the default,
+   * disables the cache files.
+   */
+  RTDE_EXPORT static void setScriptCacheDirectory(const std::string& directory);
+
   /**
    * Send the internal control script that is compiled into the library
-   * or the assigned control script file
+   * or the assigned control script file. The internal script is filtered for
+   * the controller version only once per process, the script injections are
+   * spliced into the cached script on every call.
    */
   RTDE_EXPORT bool sendScript();
 
@@ -75,6 +86,9 @@ class ScriptClient
  private:
   RTDE_EXPORT bool removeUnsupportedFunctions(std::string& ur_script);
   RTDE_EXPORT bool scanAndInjectAdditionalScriptCode(std::string& ur_script);
+  std::shared_ptr<const std::string> getBaseScript(bool& custom_script);
+  std::string spliceScript(const std::string& base_script, const std::string& prefix,
+                           const std::string& suffix) const;
 
  private:
   std::string hostname_;
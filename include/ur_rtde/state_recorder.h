@@ -0,0 +1,135 @@
+#pragma once
+#ifndef RTDE_STATE_RECORDER_H
+#define RTDE_STATE_RECORDER_H
+
+#include <ur_rtde/robot_state.h>
+#include <ur_rtde/rtde_export.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// forward declarations
+namespace boost
+{
+class thread;
+}
+
+namespace ur_rtde
+{
+/**
+ * Records every robot state received into a binary file, for RTDEReceiveInterface::startFileRecording().
+ *
+ * A sampler thread wakes up on each data package and copies the recorded variables as one fixed-width row into a
+ * preallocated block, a writer thread writes the full blocks to the file. Neither allocates nor formats while
+ * recording. If the writer falls behind until all blocks are full, rows are dropped and counted.
+ *
+ * The file starts with a self-describing header, all values in the byte order of the recording machine:
+ * @verbatim
+ * char[8]   magic "URRTDREC"
+ * uint32    format version, 1
+ * uint32    byte order mark 0x01020304
+ * double    RTDE frequency [Hz]
+ * uint32    row size in bytes
+ * uint32    number of variables
+ * per variable:
+ *   uint16  length of the name, followed by the name
+ *   uint8   RobotState::ValueType
+ *   uint16  number of elements
+ * @endverbatim
+ * Each row starts with the uint64 sequence number of the robot state, gaps show packages that were not recorded. The
+ * variables follow in header order without padding, doubles and uint64 take 8 bytes, int32 and uint32 take 4 bytes
+ * per element. convertToCsv() converts a recording to the CSV format of the live recording.
+ */
+class StateRecorder
+{
+ public:
+  /**
+   * @param robot_state the robot state to record, updated by a receive thread
+   * @param variables the names of the variables to record
+   * @param frequency the RTDE frequency, stored in the header
+   * @throws std::runtime_error if a variable is not part of the robot state
+   */
+  RTDE_EXPORT StateRecorder(std::shared_ptr<RobotState> robot_state, const std::vector<std::string> &variables,
+                            double frequency);
+
+  RTDE_EXPORT virtual ~StateRecorder();
+
+  /**
+   * @brief Create the file, write the header and start recording
+   * @throws std::runtime_error if the file cannot be written
+   */
+  RTDE_EXPORT void start(const std::string &filename);
+
+  /**
+   * @brief Stop recording, write the remaining rows and close the file
+   * @returns false if writing the file failed
+   */
+  RTDE_EXPORT bool stop();
+
+  /**
+   * @brief Continue the recording on a new robot state, e.g. the one created when the receive interface reconnects.
+   * The sequence numbers of the rows start over with the new robot state.
+   * @throws std::runtime_error if a variable is not part of the new robot state
+   */
+  RTDE_EXPORT void setRobotState(std::shared_ptr<RobotState> robot_state);
+
+  /**
+   * @returns the number of rows recorded
+   */
+  RTDE_EXPORT std::uint64_t getRowCount() const;
+
+  /**
+   * @returns the number of rows dropped because the writer thread fell behind
+   */
+  RTDE_EXPORT std::uint64_t getDroppedRows() const;
+
+  /**
+   * @brief Convert a binary recording into a CSV file with one column per variable element
+   * @throws std::runtime_error if a file cannot be opened or the recording is not valid
+   */
+  RTDE_EXPORT static void convertToCsv(const std::string &recording_filename, const std::string &csv_filename);
+
+ private:
+  void buildPlan();
+
+  void startSampler();
+
+  void stopSampler();
+
+  void samplerCallback();
+
+  void writerCallback();
+
+  std::shared_ptr<RobotState> robot_state_;
+  std::vector<std::string> variables_;
+  double frequency_;
+  std::vector<RobotState::CopyEntry> plan_;
+  std::size_t row_size_;
+  std::size_t rows_per_block_;
+  std::vector<std::vector<char>> blocks_;
+  std::ofstream file_;
+  std::shared_ptr<boost::thread> sampler_thread_;
+  std::shared_ptr<boost::thread> writer_thread_;
+  std::atomic<bool> stop_;
+  // Blocks handed between the threads, with the number of rows of a full block
+  std::mutex block_mutex_;
+  std::condition_variable block_cv_;
+  std::deque<std::pair<std::size_t, std::size_t>> full_blocks_;
+  std::deque<std::size_t> free_blocks_;
+  bool sampler_done_;
+  bool write_failed_;
+  std::atomic<std::uint64_t> rows_;
+  std::atomic<std::uint64_t> dropped_rows_;
+};
+
+}  // namespace ur_rtde
+
+#endif  // RTDE_STATE_RECORDER_H
@@ -0,0 +1,174 @@
+#pragma once
+#ifndef RTDE_TRAJECTORY_STREAMER_H
+#define RTDE_TRAJECTORY_STREAMER_H
+
+#include <ur_rtde/rtde_export.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+// forward declarations
+namespace boost
+{
+class thread;
+}
+namespace ur_rtde
+{
+class RTDEControlInterface;
+}
+
+namespace ur_rtde
+{
+/**
+ * Streams a trajectory of timestamped setpoints to the robot with servoJ() or servoL() from a dedicated realtime
+ * thread, so planning runs in the caller's threads without the deadline of the control period.
+ *
+ * The planner pushes setpoints into a single producer / single consumer lock-free queue. The streamer thread wakes up
+ * on every data package received from the controller and sends exactly one servo command per package. Stream time
+ * starts at 0 with the first package after start() and advances by the control period with every package, so it
+ * runs in phase with the controller. The target of a package is interpolated between the last due setpoint and the
+ * next one, setpoints can therefore be sparser than the control period. Poses are interpolated with
+ * pose_math::interpolatePose().
+ *
+ * When the queue runs dry before the trajectory is finished, the last target is repeated and the cycle is counted as
+ * an underrun. Packages the streamer thread woke up too late for are counted as missed, the stream time still follows
+ * the controller.
+ *
+ * Only one thread may push setpoints. The streamer uses the RTDEControlInterface exclusively while it runs.
+ */
+class TrajectoryStreamer
+{
+ public:
+  enum class Mode
+  {
+    SERVO_J,
+    SERVO_L
+  };
+
+  struct Setpoint
+  {
+    // Stream time of the setpoint in seconds
+    double time;
+    // Joint positions for SERVO_J, tool pose for SERVO_L
+    std::array<double, 6> target;
+  };
+
+  struct Statistics
+  {
+    // Servo commands sent, one per package
+    std::uint64_t cycles;
+    // Cycles in which the queue was empty before the end of the trajectory
+    std::uint64_t underruns;
+    // Longest run of consecutive underruns
+    std::uint64_t max_consecutive_underruns;
+    // Packages received while the streamer thread was still busy or not scheduled
+    std::uint64_t missed_packages;
+    // Longest time from waking up for a package to the servo command being sent, in microseconds
+    std::uint64_t max_cycle_time_us;
+  };
+
+  /**
+   * @param rtde_control the control interface to send the servo commands with
+   * @param mode whether the setpoints are joint positions (servoJ) or tool poses (servoL)
+   * @param capacity the number of setpoints the queue can hold
+   * @param lookahead_time the lookahead time of the servo commands, range [0.03, 0.2]
+   * @param gain the proportional gain of the servo commands, range [100, 2000]
+   */
+  RTDE_EXPORT explicit TrajectoryStreamer(RTDEControlInterface &rtde_control, Mode mode = Mode::SERVO_J,
+                                          std::size_t capacity = 4096, double lookahead_time = 0.1,
+                                          double gain = 300);
+
+  RTDE_EXPORT virtual ~TrajectoryStreamer();
+
+  /**
+   * @brief Start the streamer thread. Setpoints can be pushed before, so the queue is filled when streaming begins.
+   * @param cpu_core the core to pin the streamer thread to, -1 leaves it to the scheduler
+   * @param rt_priority the realtime priority of the streamer thread, 0 selects a high default and -1 keeps the normal
+   * priority
+   * @throws std::logic_error if the streamer is already running
+   */
+  RTDE_EXPORT void start(int cpu_core = -1, int rt_priority = 0);
+
+  /**
+   * @brief Add a setpoint to the end of the queue without blocking. Setpoint times must increase.
+   * @returns false if the queue is full
+   */
+  RTDE_EXPORT bool push(const Setpoint &setpoint);
+
+  RTDE_EXPORT bool push(double time, const std::array<double, 6> &target);
+
+  /**
+   * @brief Mark the end of the trajectory. The streamer stops the servo mode after the last setpoint and exits.
+   */
+  RTDE_EXPORT void finish();
+
+  /**
+   * @brief Wait until the streamer thread has exited, after finish() or an error
+   * @returns false on timeout
+   * @throws the exception that stopped the streamer thread, e.g. std::runtime_error if the connection was lost
+   */
+  RTDE_EXPORT bool waitUntilFinished(std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+
+  /**
+   * @brief Stop streaming immediately, the robot decelerates with servoStop(). Setpoints left in the queue are
+   * discarded.
+   */
+  RTDE_EXPORT void stop();
+
+  RTDE_EXPORT bool isRunning() const;
+
+  /**
+   * @returns the stream time of the last package in seconds, planners can use it to stay ahead of the streamer
+   */
+  RTDE_EXPORT double getStreamTime() const;
+
+  /**
+   * @returns the number of setpoints in the queue
+   */
+  RTDE_EXPORT std::size_t getQueueSize() const;
+
+  RTDE_EXPORT Statistics getStatistics() const;
+
+ private:
+  struct SetpointQueue;
+
+  void streamerCallback(int cpu_core, int rt_priority);
+
+  void stream();
+
+  void sendTarget(const std::array<double, 6> &target);
+
+  void join();
+
+  RTDEControlInterface &rtde_control_;
+  Mode mode_;
+  double lookahead_time_;
+  double gain_;
+  double delta_time_;
+  std::unique_ptr<SetpointQueue> queue_;
+  std::shared_ptr<boost::thread> thread_;
+  std::mutex thread_mutex_;
+  std::condition_variable done_cv_;
+  std::atomic<bool> finished_;
+  std::atomic<bool> stop_;
+  std::atomic<bool> running_;
+  std::exception_ptr error_;
+  // Stream time in nanoseconds, atomics of double are not lock-free everywhere
+  std::atomic<std::int64_t> stream_time_ns_;
+  std::atomic<std::uint64_t> cycles_;
+  std::atomic<std::uint64_t> underruns_;
+  std::atomic<std::uint64_t> max_consecutive_underruns_;
+  std::atomic<std::uint64_t> missed_packages_;
+  std::atomic<std::uint64_t> max_cycle_time_us_;
+};
+
+}  // namespace ur_rtde
+
+#endif  // RTDE_TRAJECTORY_STREAMER_H
@@ -0,0 +1,199 @@
+#pragma once
+#ifndef UR_KINEMATICS_H
+#define UR_KINEMATICS_H
+
+#include <ur_rtde/rtde_export.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ur_rtde
+{
+/**
+ * Denavit-Hartenberg parameters of a UR arm, in the convention of the UR documentation: the transformation of joint i
+ * is Rz(theta_i + q_i) * Tz(d_i) * Tx(a_i) * Rx(alpha_i). Lengths are in meters, angles in radians.
+ */
+struct DHParameters
+{
+  std::array<double, 6> a;
+  std::array<double, 6> d;
+  std::array<double, 6> alpha;
+  std::array<double, 6> theta;
+};
+
+/**
+ * Forward and inverse kinematics of the UR arms, computed in the client without a round trip to the controller.
+ *
+ * The inverse kinematics is the closed form solution of the UR wrist geometry and yields up to 8 solutions (shoulder
+ * left/right, elbow up/down, wrist flipped or not). Poses are given like in URScript, as [x, y, z, rx, ry, rz] of the
+ * tool in the base frame, with the rotation as a rotation vector.
+ *
+ * Without calibration the results match the nominal robot model. The kinematic calibration of a particular robot can
+ * be applied with setCalibration() or loadCalibration(). The forward kinematics then uses the calibrated parameters
+ * and each branch of the analytic inverse kinematics is carried over to the calibrated model by iterating the nominal
+ * solution on a corrected pose, followed by Newton iterations, like the controller does.
+ */
+class URKinematics
+{
+ public:
+  enum class RobotModel
+  {
+    UR3,
+    UR5,
+    UR10,
+    UR3e,
+    UR5e,
+    UR10e,
+    UR16e,
+    UR20,
+    UR30
+  };
+
+  static const std::size_t MAX_IK_SOLUTIONS = 8;
+
+  RTDE_EXPORT explicit URKinematics(RobotModel model);
+
+  RTDE_EXPORT explicit URKinematics(const DHParameters &dh_parameters);
+
+  /**
+   * @returns the nominal Denavit-Hartenberg parameters of the given robot model
+   */
+  RTDE_EXPORT static DHParameters nominalParameters(RobotModel model);
+
+  /**
+   * @brief Apply the kinematic calibration of a robot. The deltas are added to the nominal parameters.
+   */
+  RTDE_EXPORT void setCalibration(const DHParameters &delta);
+
+  /**
+   * @brief Apply the kinematic calibration stored by the controller of a robot in
+   * /root/.urcontrol/calibration.conf (delta_theta, delta_a, delta_d and delta_alpha of the [mounting] section)
+   * @throws std::runtime_error if the file cannot be read or lacks one of the deltas
+   */
+  RTDE_EXPORT void loadCalibration(const std::string &file_path);
+
+  RTDE_EXPORT bool isCalibrated() const;
+
+  /**
+   * @returns the parameters used by the forward kinematics, the nominal ones plus the calibration
+   */
+  RTDE_EXPORT const DHParameters &getParameters() const;
+
+  /**
+   * @brief Set the tool center point relative to the tool flange, used by all kinematics functions. The default is the
+   * tool flange.
+   * @param tcp_offset the tcp offset pose [x, y, z, rx, ry, rz]
+   */
+  RTDE_EXPORT void setTcp(const std::vector<double> &tcp_offset);
+
+  /**
+   * @param q joint positions
+   * @returns the pose of the tcp in the base frame
+   */
+  RTDE_EXPORT std::vector<double> forwardKinematics(const std::vector<double> &q) const;
+
+  /**
+   * @brief Compute all inverse kinematics solutions of a tool pose. Joint positions are in [-pi, pi].
+   * @param pose tool pose
+   * @returns up to 8 joint position vectors reaching the pose
+   */
+  RTDE_EXPORT std::vector<std::vector<double>> inverseKinematicsAll(const std::vector<double> &pose) const;
+
+  /**
+   * @brief Compute the inverse kinematics solution closest to qnear, like getInverseKinematics() of the
+   * RTDEControlInterface. Each joint is shifted by multiples of 2 pi towards qnear, within [-2 pi, 2 pi].
+   * @param pose tool pose
+   * @param qnear joint positions to choose the closest solution to
+   * @returns the joint positions, or an empty vector if the pose is not reachable
+   */
+  RTDE_EXPORT std::vector<double> inverseKinematics(const std::vector<double> &pose,
+                                                    const std::vector<double> &qnear) const;
+
+  /**
+   * @returns true if the pose is reachable
+   */
+  RTDE_EXPORT bool inverseKinematicsHasSolution(const std::vector<double> &pose) const;
+
+  /**
+   * @brief Allocation free forward kinematics of 6 joint positions into a 6 element pose
+   */
+  RTDE_EXPORT void forwardKinematics(const double *q, double *pose) const;
+
+  /**
+   * @brief Allocation free inverse kinematics of a 6 element pose
+   * @param solutions room for MAX_IK_SOLUTIONS * 6 joint positions, the solutions are stored consecutively
+   * @returns the number of solutions
+   */
+  RTDE_EXPORT std::size_t inverseKinematics(const double *pose, double *solutions) const;
+
+  /**
+   * @brief Forward kinematics of many joint configurations, split across threads
+   * @param q count * 6 joint positions, one configuration after the other
+   * @param count the number of configurations
+   * @param poses room for count * 6 pose values
+   * @param threads the number of threads to use, 0 uses all hardware threads. Small batches run on the calling thread.
+   */
+  RTDE_EXPORT void forwardKinematicsBatch(const double *q, std::size_t count, double *poses,
+                                          unsigned int threads = 0) const;
+
+  /**
+   * @brief Inverse kinematics of many poses, each solved for the solution closest to qnear, split across threads
+   * @param poses count * 6 pose values
+   * @param qnear 6 joint positions to choose the closest solutions to, the same for all poses
+   * @param count the number of poses
+   * @param q room for count * 6 joint positions, NaN for unreachable poses
+   * @param found room for count flags, 1 if the pose is reachable
+   * @param threads the number of threads to use, 0 uses all hardware threads
+   */
+  RTDE_EXPORT void inverseKinematicsBatch(const double *poses, const double *qnear, std::size_t count, double *q,
+                                          std::uint8_t *found, unsigned int threads = 0) const;
+
+  /**
+   * @brief All inverse kinematics solutions of many poses, split across threads
+   * @param poses count * 6 pose values
+   * @param count the number of poses
+   * @param solutions room for count * MAX_IK_SOLUTIONS * 6 joint positions, unused solutions are NaN
+   * @param solution_counts room for the count of solutions of each pose
+   * @param threads the number of threads to use, 0 uses all hardware threads
+   */
+  RTDE_EXPORT void inverseKinematicsAllBatch(const double *poses, std::size_t count, double *solutions,
+                                             std::uint8_t *solution_counts, unsigned int threads = 0) const;
+
+ private:
+  // DH parameters of a joint with the sine and cosine of the constant twist angle
+  struct Link
+  {
+    double a;
+    double d;
+    double theta;
+    double cos_alpha;
+    double sin_alpha;
+  };
+
+  void updateLinks();
+
+  // One branch of the closed form solution of the nominal model for a 4x4 flange transformation, with the wrist side
+  // closest to near if it is not null
+  bool solveNominal(const double *flange, int branch, double margin, const double *near, double *q) const;
+
+  // One branch of the solution of the calibrated model, iterating the nominal solution at most iterations times
+  bool solveCalibrated(const double *pose, const double *flange, int branch, int iterations, double *q) const;
+
+  bool refine(const double *pose, double *q) const;
+
+  DHParameters nominal_;
+  DHParameters parameters_;
+  bool calibrated_;
+  // Tcp offset as a row-major 4x4 transformation and its inverse
+  std::array<double, 16> tcp_;
+  std::array<double, 16> tcp_inverse_;
+  std::array<Link, 6> links_;
+  std::array<Link, 6> nominal_links_;
+};
+
+}  // namespace ur_rtde
+
+#endif  // UR_KINEMATICS_H
@@ -0,0 +1,277 @@
+#include <ur_rtde/online_trajectory_generator.h>
+#include <ur_rtde/rtde_control_interface.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace ur_rtde
+{
+namespace
+{
+// Bisection steps for the largest admissible jerk, resolves the jerk range to 2^-40 of its width
+const int JERK_SEARCH_ITERATIONS = 40;
+// A joint closer to its target than this and almost at rest is placed on the target. With a moderate jerk limit the
+// sampled motion settles within about jerk * dt^3 of the target instead, which is added to the tolerance.
+const double POSITION_TOLERANCE = 1e-8;
+
+void verifyLimit(double value, double max, const char *name)
+{
+  if (!(value > 0 && value <= max))
+  {
+    std::ostringstream oss;
+    oss << "OnlineTrajectoryGenerator: " << name << " " << value << " is not within (0, " << max << "]";
+    throw std::invalid_argument(oss.str());
+  }
+}
+
+struct State
+{
+  double position;
+  double velocity;
+  double acceleration;
+};
+
+// Apply a constant jerk for a duration
+State integrate(const State &state, double jerk, double duration)
+{
+  State next;
+  next.position = state.position + state.velocity * duration + state.acceleration * duration * duration / 2 +
+                  jerk * duration * duration * duration / 6;
+  next.velocity = state.velocity + state.acceleration * duration + jerk * duration * duration / 2;
+  next.acceleration = state.acceleration + jerk * duration;
+  return next;
+}
+
+// Velocity reached when the acceleration is brought to zero with the maximum jerk
+double peakVelocity(const State &state, double max_jerk)
+{
+  return state.velocity + state.acceleration * std::fabs(state.acceleration) / (2 * max_jerk);
+}
+
+// Velocity reached when the acceleration is brought to zero in whole control periods, as the generator does. Ramping
+// it out within a period gains more velocity than the continuous ramp of peakVelocity().
+double sampledPeakVelocity(const State &state, double max_jerk, double dt)
+{
+  double periods = std::ceil(std::fabs(state.acceleration) / (max_jerk * dt) - 1e-9);
+  return state.velocity + state.acceleration * periods * dt / 2;
+}
+
+// Position where the joint comes to rest when braking as hard as the acceleration and jerk limits allow: the
+// acceleration is ramped to a peak against the motion, held there if the peak is limited, and ramped back to zero.
+// The generator changes the jerk only once per control period, so each phase is stretched to whole periods and the
+// peak lowered until the joint still stops. The continuous profile cannot be followed when a phase ends within a
+// period and the joint would pass its target.
+double stopPosition(const State &state, double max_acceleration, double max_jerk, double dt)
+{
+  // Mirror so the joint moves in positive direction once the current acceleration has been ramped out
+  double sign = peakVelocity(state, max_jerk) >= 0 ? 1.0 : -1.0;
+  State braking = {0, sign * state.velocity, sign * state.acceleration};
+
+  double peak =
+      -std::sqrt(std::max(0.0, max_jerk * braking.velocity + braking.acceleration * braking.acceleration / 2));
+  double hold = 0;
+  if (peak < -max_acceleration)
+  {
+    peak = -max_acceleration;
+    hold = (braking.velocity + braking.acceleration * braking.acceleration / (2 * max_jerk) -
+            max_acceleration * max_acceleration / max_jerk) /
+           max_acceleration;
+  }
+  double ramp_periods = std::ceil(std::max(0.0, (braking.acceleration - peak) / max_jerk) / dt - 1e-9);
+  double hold_periods = std::ceil(std::max(0.0, hold) / dt - 1e-9);
+  double release_periods = std::ceil(-peak / max_jerk / dt - 1e-9);
+  if (ramp_periods == 0 && braking.acceleration != 0)
+    ramp_periods = 1;
+
+  // The peak for which the velocity reaches zero at the end of the stretched profile
+  double duration = (ramp_periods / 2 + hold_periods + release_periods / 2) * dt;
+  if (duration > 0)
+    peak = -(braking.velocity + braking.acceleration * ramp_periods * dt / 2) / duration;
+  if (ramp_periods > 0)
+    braking = integrate(braking, (peak - braking.acceleration) / (ramp_periods * dt), ramp_periods * dt);
+  braking = integrate(braking, 0, hold_periods * dt);
+  if (release_periods > 0)
+    braking = integrate(braking, -peak / (release_periods * dt), release_periods * dt);
+  return state.position + sign * braking.position;
+}
+}  // namespace
+
+OnlineTrajectoryGenerator::OnlineTrajectoryGenerator(double delta_time, double max_velocity, double max_acceleration,
+                                                     double max_jerk)
+    : delta_time_(delta_time), target_reached_(true)
+{
+  if (!(delta_time > 0))
+    throw std::invalid_argument("OnlineTrajectoryGenerator: the control period must be positive");
+  std::array<double, 6> velocity, acceleration, jerk;
+  velocity.fill(max_velocity);
+  acceleration.fill(max_acceleration);
+  jerk.fill(max_jerk);
+  setLimits(velocity, acceleration, jerk);
+  min_position_.fill(UR_JOINT_POSITION_MIN);
+  max_position_.fill(UR_JOINT_POSITION_MAX);
+  target_.fill(0);
+  position_.fill(0);
+  velocity_.fill(0);
+  acceleration_.fill(0);
+}
+
+void OnlineTrajectoryGenerator::setLimits(const std::array<double, 6> &max_velocity,
+                                          const std::array<double, 6> &max_acceleration,
+                                          const std::array<double, 6> &max_jerk)
+{
+  for (std::size_t i = 0; i < limits_.size(); i++)
+  {
+    verifyLimit(max_velocity[i], UR_JOINT_VELOCITY_MAX, "velocity");
+    verifyLimit(max_acceleration[i], UR_JOINT_ACCELERATION_MAX, "acceleration");
+    verifyLimit(max_jerk[i], HUGE_VAL, "jerk");
+  }
+  for (std::size_t i = 0; i < limits_.size(); i++)
+  {
+    limits_[i].velocity = max_velocity[i];
+    limits_[i].acceleration = max_acceleration[i];
+    limits_[i].jerk = max_jerk[i];
+  }
+}
+
+void OnlineTrajectoryGenerator::setPositionLimits(const std::array<double, 6> &min_position,
+                                                  const std::array<double, 6> &max_position)
+{
+  for (std::size_t i = 0; i < min_position.size(); i++)
+  {
+    if (!(min_position[i] <= max_position[i]))
+      throw std::invalid_argument("OnlineTrajectoryGenerator: the minimum position exceeds the maximum position");
+  }
+  min_position_ = min_position;
+  max_position_ = max_position;
+}
+
+void OnlineTrajectoryGenerator::reset(const std::vector<double> &q, const std::vector<double> &qd,
+                                      const std::vector<double> &qdd)
+{
+  if (q.size() != 6 || (!qd.empty() && qd.size() != 6) || (!qdd.empty() && qdd.size() != 6))
+    throw std::invalid_argument("OnlineTrajectoryGenerator: the joint state must have 6 elements");
+  for (std::size_t i = 0; i < position_.size(); i++)
+  {
+    position_[i] = q[i];
+    velocity_[i] = qd.empty() ? 0.0 : qd[i];
+    acceleration_[i] = qdd.empty() ? 0.0 : qdd[i];
+  }
+  setTarget(position_);
+}
+
+void OnlineTrajectoryGenerator::setTarget(const std::array<double, 6> &q)
+{
+  for (std::size_t i = 0; i < target_.size(); i++)
+    target_[i] = std::min(max_position_[i], std::max(min_position_[i], q[i]));
+  target_reached_ = false;
+}
+
+void OnlineTrajectoryGenerator::setTarget(const std::vector<double> &q)
+{
+  if (q.size() != 6)
+    throw std::invalid_argument("OnlineTrajectoryGenerator: the target must have 6 elements");
+  std::array<double, 6> target;
+  std::copy(q.begin(), q.end(), target.begin());
+  setTarget(target);
+}
+
+bool OnlineTrajectoryGenerator::update()
+{
+  bool reached = true;
+  for (std::size_t i = 0; i < position_.size(); i++)
+    reached = updateJoint(i) && reached;
+  target_reached_ = reached;
+  return reached;
+}
+
+bool OnlineTrajectoryGenerator::updateJoint(std::size_t joint)
+{
+  const Limits &limits = limits_[joint];
+  const double dt = delta_time_;
+  // Mirror so the target is in positive direction, the best jerk is then the largest admissible one
+  const double sign = target_[joint] >= position_[joint] ? 1.0 : -1.0;
+  const State state = {sign * position_[joint], sign * velocity_[joint], sign * acceleration_[joint]};
+  const double target = sign * target_[joint];
+
+  // A jerk is admissible if the acceleration stays within its limit, the velocity can be kept within its limit and
+  // the joint can still stop at the target. All three grow with the jerk.
+  auto admissible = [&](double jerk) {
+    State next = integrate(state, jerk, dt);
+    return next.acceleration <= limits.acceleration + 1e-12 &&
+           sampledPeakVelocity(next, limits.jerk, dt) <= limits.velocity + 1e-12 &&
+           stopPosition(next, limits.acceleration, limits.jerk, dt) <= target;
+  };
+
+  double lower = std::max(-limits.jerk, (-limits.acceleration - state.acceleration) / dt);
+  double upper = std::min(limits.jerk, (limits.acceleration - state.acceleration) / dt);
+  double jerk;
+  if (lower > upper)
+  {
+    // The acceleration is beyond a lowered limit, bring it back as fast as possible
+    jerk = state.acceleration > 0 ? -limits.jerk : limits.jerk;
+  }
+  else if (admissible(upper))
+  {
+    jerk = upper;
+  }
+  else if (!admissible(lower))
+  {
+    // Too fast to stop at the target, brake as hard as possible and return to it afterwards
+    jerk = lower;
+  }
+  else
+  {
+    for (int i = 0; i < JERK_SEARCH_ITERATIONS; i++)
+    {
+      double middle = (lower + upper) / 2;
+      if (admissible(middle))
+        lower = middle;
+      else
+        upper = middle;
+    }
+    jerk = lower;
+  }
+
+  State next = integrate(state, jerk, dt);
+  // Placing the joint on the target zeroes the acceleration within one period, so it must not exceed the jerk limit
+  const double tolerance = POSITION_TOLERANCE + std::min(limits.jerk * dt * dt * dt, limits.acceleration * dt * dt);
+  bool reached = std::fabs(target - next.position) < tolerance &&
+                 std::fabs(next.velocity) < limits.jerk * dt * dt &&
+                 std::fabs(state.acceleration) <= limits.jerk * dt;
+  if (reached)
+    next = {target, 0, 0};
+  position_[joint] = sign * next.position;
+  velocity_[joint] = sign * next.velocity;
+  acceleration_[joint] = sign * next.acceleration;
+  return reached;
+}
+
+bool OnlineTrajectoryGenerator::isTargetReached() const
+{
+  return target_reached_;
+}
+
+const std::array<double, 6> &OnlineTrajectoryGenerator::getPosition() const
+{
+  return position_;
+}
+
+const std::array<double, 6> &OnlineTrajectoryGenerator::getVelocity() const
+{
+  return velocity_;
+}
+
+const std::array<double, 6> &OnlineTrajectoryGenerator::getAcceleration() const
+{
+  return acceleration_;
+}
+
+double OnlineTrajectoryGenerator::getDeltaTime() const
+{
+  return delta_time_;
+}
+
+}  // namespace ur_rtde
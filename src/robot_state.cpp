@@ -3,152 +3,65 @@
 
 namespace ur_rtde
 {
-std::unordered_map<std::string, rtde_type_variant_> RobotState::state_types_ {
-    { "timestamp", double() },
-    { "target_q", std::vector<double>() },
-    { "target_qd", std::vector<double>() },
-    { "target_qdd", std::vector<double>() },
-    { "target_current", std::vector<double>() },
-    { "target_moment", std::vector<double>() },
-    { "actual_q", std::vector<double>() },
-    { "actual_qd", std::vector<double>() },
-    { "actual_qdd", std::vector<double>() },
-    { "actual_current", std::vector<double>() },
-    { "actual_moment", std::vector<double>() },
-    { "joint_control_output", std::vector<double>() },
-    { "actual_TCP_pose", std::vector<double>() },
-    { "actual_TCP_speed", std::vector<double>() },
-    { "actual_TCP_force", std::vector<double>() },
-    { "target_TCP_pose", std::vector<double>() },
-    { "target_TCP_speed", std::vector<double>() },
-    { "actual_digital_input_bits", uint64_t() },
-    { "joint_temperatures", std::vector<double>() },
-    { "actual_execution_time", double() },
-    { "robot_mode", int32_t() },
-    { "joint_mode", std::vector<int32_t>() },
-    { "safety_mode", int32_t() },
-    { "actual_tool_accelerometer", std::vector<double>() },
-    { "speed_scaling", double() },
-    { "target_speed_fraction", double() },
-    { "actual_momentum", double() },
-    { "actual_main_voltage", double() },
-    { "actual_robot_voltage", double() },
-    { "actual_robot_current", double() },
-    { "actual_joint_voltage", std::vector<double>() },
-    { "actual_digital_output_bits", uint64_t() },
-    { "runtime_state", uint32_t() },
-    { "robot_status_bits", uint32_t() },
-    { "safety_status_bits", uint32_t() },
-    { "standard_analog_input0", double() },
-    { "standard_analog_input1", double() },
-    { "standard_analog_output0", double() },
-    { "standard_analog_output1", double() },
-    { "ft_raw_wrench", std::vector<double>() },
-    { "payload", double() },
-    { "payload_cog", std::vector<double>() },
-    { "payload_inertia", std::vector<double>() },
-    { "output_bit_registers0_to_31", uint32_t() },
-    { "output_bit_registers32_to_63", uint32_t() },
-    { "output_int_register_0", int32_t() },
-    { "output_int_register_1", int32_t() },
-    { "output_int_register_2", int32_t() },
-    { "output_int_register_3", int32_t() },
-    { "output_int_register_4", int32_t() },
-    { "output_int_register_5", int32_t() },
-    { "output_int_register_6", int32_t() },
-    { "output_int_register_7", int32_t() },
-    { "output_int_register_8", int32_t() },
-    { "output_int_register_9", int32_t() },
-    { "output_int_register_10", int32_t() },
-    { "output_int_register_11", int32_t() },
-    { "output_int_register_12", int32_t() },
-    { "output_int_register_13", int32_t() },
-    { "output_int_register_14", int32_t() },
-    { "output_int_register_15", int32_t() },
-    { "output_int_register_16", int32_t() },
-    { "output_int_register_17", int32_t() },
-    { "output_int_register_18", int32_t() },
-    { "output_int_register_19", int32_t() },
-    { "output_int_register_20", int32_t() },
-    { "output_int_register_21", int32_t() },
-    { "output_int_register_22", int32_t() },
-    { "output_int_register_23", int32_t() },
-    { "output_int_register_24", int32_t() },
-    { "output_int_register_25", int32_t() },
-    { "output_int_register_26", int32_t() },
-    { "output_int_register_27", int32_t() },
-    { "output_int_register_28", int32_t() },
-    { "output_int_register_29", int32_t() },
-    { "output_int_register_30", int32_t() },
-    { "output_int_register_31", int32_t() },
-    { "output_int_register_32", int32_t() },
-    { "output_int_register_33", int32_t() },
-    { "output_int_register_34", int32_t() },
-    { "output_int_register_35", int32_t() },
-    { "output_int_register_36", int32_t() },
-    { "output_int_register_37", int32_t() },
-    { "output_int_register_38", int32_t() },
-    { "output_int_register_39", int32_t() },
-    { "output_int_register_40", int32_t() },
-    { "output_int_register_41", int32_t() },
-    { "output_int_register_42", int32_t() },
-    { "output_int_register_43", int32_t() },
-    { "output_int_register_44", int32_t() },
-    { "output_int_register_45", int32_t() },
-    { "output_int_register_46", int32_t() },
-    { "output_int_register_47", int32_t() },
-    { "output_double_register_0", double() },
-    { "output_double_register_1", double() },
-    { "output_double_register_2", double() },
-    { "output_double_register_3", double() },
-    { "output_double_register_4", double() },
-    { "output_double_register_5", double() },
-    { "output_double_register_6", double() },
-    { "output_double_register_7", double() },
-    { "output_double_register_8", double() },
-    { "output_double_register_9", double() },
-    { "output_double_register_10", double() },
-    { "output_double_register_11", double() },
-    { "output_double_register_12", double() },
-    { "output_double_register_13", double() },
-    { "output_double_register_14", double() },
-    { "output_double_register_15", double() },
-    { "output_double_register_16", double() },
-    { "output_double_register_17", double() },
-    { "output_double_register_18", double() },
-    { "output_double_register_19", double() },
-    { "output_double_register_20", double() },
-    { "output_double_register_21", double() },
-    { "output_double_register_22", double() },
-    { "output_double_register_23", double() },
-    { "output_double_register_24", double() },
-    { "output_double_register_25", double() },
-    { "output_double_register_26", double() },
-    { "output_double_register_27", double() },
-    { "output_double_register_28", double() },
-    { "output_double_register_29", double() },
-    { "output_double_register_30", double() },
-    { "output_double_register_31", double() },
-    { "output_double_register_32", double() },
-    { "output_double_register_33", double() },
-    { "output_double_register_34", double() },
-    { "output_double_register_35", double() },
-    { "output_double_register_36", double() },
-    { "output_double_register_37", double() },
-    { "output_double_register_38", double() },
-    { "output_double_register_39", double() },
-    { "output_double_register_40", double() },
-    { "output_double_register_41", double() },
-    { "output_double_register_42", double() },
-    { "output_double_register_43", double() },
-    { "output_double_register_44", double() },
-    { "output_double_register_45", double() },
-    { "output_double_register_46", double() },
-    { "output_double_register_47", double() }
+namespace
+{
+// Words needed to store every known variable
+const std::int32_t TOTAL_WORDS = 0
+#define UR_RTDE_ROBOT_STATE_FIELD_WORDS(name, type, size) +size
+    UR_RTDE_ROBOT_STATE_FIELDS(UR_RTDE_ROBOT_STATE_FIELD_WORDS);
+#undef UR_RTDE_ROBOT_STATE_FIELD_WORDS
+
+const std::size_t WORDS_PER_CACHE_LINE = 64 / sizeof(std::uint64_t);
+
+const char *const field_names[] = {
+#define UR_RTDE_ROBOT_STATE_FIELD_NAME(name, type, size) #name,
+    UR_RTDE_ROBOT_STATE_FIELDS(UR_RTDE_ROBOT_STATE_FIELD_NAME)
+#undef UR_RTDE_ROBOT_STATE_FIELD_NAME
 };
 
+rtde_type_variant_ prototype(RobotState::ValueType type)
+{
+  switch (type)
+  {
+    case RobotState::ValueType::UINT32:
+      return uint32_t();
+    case RobotState::ValueType::UINT64:
+      return uint64_t();
+    case RobotState::ValueType::INT32:
+      return int32_t();
+    case RobotState::ValueType::DOUBLE:
+      return double();
+    case RobotState::ValueType::VECTOR_DOUBLE:
+      return std::vector<double>();
+    case RobotState::ValueType::VECTOR_INT32:
+      return std::vector<int32_t>();
+  }
+  return double();
+}
+
+std::unordered_map<std::string, rtde_type_variant_> makeStateTypes()
+{
+  std::unordered_map<std::string, rtde_type_variant_> state_types;
+  for (std::size_t i = 0; i < RobotState::fieldCount(); i++)
+    state_types[field_names[i]] = prototype(RobotState::fieldType(static_cast<RobotState::Field>(i)));
+  return state_types;
+}
+}  // namespace
+
+std::unordered_map<std::string, rtde_type_variant_> RobotState::state_types_ = makeStateTypes();
+
 RobotState::RobotState(const std::vector<std::string> &variables)
+    : words_used_(0), sequence_(0), first_state_received_(false), waiters_(0)
 {
+  // Start the storage on a cache line, new[] only guarantees the alignment of the element type
+  words_storage_.reset(new std::atomic<std::uint64_t>[TOTAL_WORDS + WORDS_PER_CACHE_LINE - 1]);
+  std::size_t misalignment = reinterpret_cast<std::uintptr_t>(words_storage_.get()) % 64;
+  words_ = words_storage_.get() + (misalignment ? (64 - misalignment) / sizeof(std::uint64_t) : 0);
+  for (std::int32_t i = 0; i < TOTAL_WORDS; i++)
+    words_[i].store(0, std::memory_order_relaxed);
+  offsets_.reset(new std::atomic<std::int32_t>[fieldCount()]);
+  for (std::size_t i = 0; i < fieldCount(); i++)
+    offsets_[i].store(-1, std::memory_order_relaxed);
   initRobotState(variables);
 }
 
@@ -157,41 +70,162 @@ RobotState::~RobotState() = default;
 bool RobotState::lockUpdateStateMutex()
 {
   update_state_mutex_.lock();
+  // An odd sequence tells the readers that the state is being modified
+  sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
   return true;
 }
 
 bool RobotState::unlockUpdateStateMutex()
 {
+  sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
   update_state_mutex_.unlock();
+
+  // Pairs with the fence in waitForState(): either the waiter sees the new sequence or the writer sees the waiter
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters_.load(std::memory_order_relaxed) > 0)
+  {
+    {
+      std::lock_guard<std::mutex> lock(wait_mutex_);
+    }
+    state_published_.notify_all();
+  }
   return true;
 }
 
+bool RobotState::waitForState(std::uint64_t sequence_number, std::chrono::microseconds timeout)
+{
+  if (getSequenceNumber() > sequence_number)
+    return true;
+
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  waiters_.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool published =
+      state_published_.wait_for(lock, timeout, [&] { return getSequenceNumber() > sequence_number; });
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+  return published;
+}
+
 void RobotState::setFirstStateReceived(bool val)
 {
-  first_state_received_ = val;
+  first_state_received_.store(val, std::memory_order_release);
 }
 
 bool RobotState::getFirstStateReceived()
 {
-  return first_state_received_;
+  return first_state_received_.load(std::memory_order_acquire);
 }
 
 void RobotState::initRobotState(const std::vector<std::string> &variables)
 {
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
-  std::lock_guard<std::mutex> lock(update_state_mutex_);
-#else
-  std::lock_guard<PriorityInheritanceMutex> lock(update_state_mutex_);
-#endif
+  lockUpdateStateMutex();
   for (auto& item : variables)
   {
-    if (state_types_.find(item) != state_types_.end())
-    {
-      rtde_type_variant_ entry = state_types_[item];
-      state_data_[item] = entry;
-    }
+    Field field;
+    if (!findField(item, field) || getStateOffset(field) >= 0)
+      continue;
+
+    for (std::int32_t i = 0; i < fieldSize(field); i++)
+      words_[words_used_ + i].store(0, std::memory_order_relaxed);
+    offsets_[static_cast<std::size_t>(field)].store(words_used_, std::memory_order_release);
+    words_used_ += fieldSize(field);
   }
   first_state_received_ = false;
+  unlockUpdateStateMutex();
+}
+
+std::int32_t RobotState::getStateOffset(const std::string &name, ValueType type, std::uint16_t size) const
+{
+  Field field;
+  if (!findField(name, field) || fieldType(field) != type || fieldSize(field) != size)
+    return -1;
+  return getStateOffset(field);
+}
+
+bool RobotState::getStateEntry(const std::string &name, rtde_type_variant_ &entry)
+{
+  Field field;
+  if (!findField(name, field) || getStateOffset(field) < 0)
+    return false;
+
+  switch (fieldType(field))
+  {
+    case ValueType::UINT32:
+      entry = uint32_t();
+      return getStateData(field, boost::get<uint32_t>(entry));
+    case ValueType::UINT64:
+      entry = uint64_t();
+      return getStateData(field, boost::get<uint64_t>(entry));
+    case ValueType::INT32:
+      entry = int32_t();
+      return getStateData(field, boost::get<int32_t>(entry));
+    case ValueType::DOUBLE:
+      entry = double();
+      return getStateData(field, boost::get<double>(entry));
+    case ValueType::VECTOR_DOUBLE:
+      entry = std::vector<double>();
+      return getStateData(field, boost::get<std::vector<double>>(entry));
+    case ValueType::VECTOR_INT32:
+      entry = std::vector<int32_t>();
+      return getStateData(field, boost::get<std::vector<int32_t>>(entry));
+  }
+  return false;
+}
+
+std::uint64_t RobotState::copyState(const std::vector<CopyEntry> &plan, void *destination) const
+{
+  char *bytes = static_cast<char *>(destination);
+  return readConsistent([&] {
+    for (const auto &entry : plan)
+    {
+      char *target = bytes + entry.destination;
+      for (std::int32_t i = 0; i < entry.size; i++)
+      {
+        std::uint64_t word = loadWord(entry.offset + i);
+        switch (entry.type)
+        {
+          case ValueType::DOUBLE:
+          case ValueType::VECTOR_DOUBLE:
+            std::memcpy(target + i * sizeof(double), &word, sizeof(double));
+            break;
+          case ValueType::INT32:
+          case ValueType::VECTOR_INT32:
+          case ValueType::UINT32:
+          {
+            auto value = static_cast<std::uint32_t>(word);
+            std::memcpy(target + i * sizeof(value), &value, sizeof(value));
+            break;
+          }
+          case ValueType::UINT64:
+            std::memcpy(target + i * sizeof(word), &word, sizeof(word));
+            break;
+        }
+      }
+    }
+  });
+}
+
+const char *RobotState::fieldName(Field field)
+{
+  return field_names[static_cast<std::size_t>(field)];
+}
+
+bool RobotState::findField(const std::string &name, Field &field)
+{
+  // Built once and never modified afterwards, so it is safe to use without locks
+  static const std::unordered_map<std::string, Field> fields = [] {
+    std::unordered_map<std::string, Field> index;
+    for (std::size_t i = 0; i < fieldCount(); i++)
+      index[field_names[i]] = static_cast<Field>(i);
+    return index;
+  }();
+
+  auto it = fields.find(name);
+  if (it == fields.end())
+    return false;
+  field = it->second;
+  return true;
 }
 
 }  // namespace ur_rtde
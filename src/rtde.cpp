@@ -8,8 +8,12 @@
 #include <boost/asio/socket_base.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/bind/bind.hpp>
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__)
+#include <poll.h>
+#endif
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -18,6 +22,14 @@
 #include <type_traits>
 
 const unsigned HEADER_SIZE = 3;
+// Size of the fixed size fields of a command data package: recipe id, command type, the largest scalar argument
+// and the largest trailing arguments (the standard analog outputs)
+const std::size_t SEND_BUFFER_FIXED_SIZE = 1 + 4 + 8 + 2 + 2 * 8;
+// Initial size of the send buffer, large enough for commands filling all 48 input double registers
+const std::size_t SEND_BUFFER_INITIAL_SIZE = HEADER_SIZE + SEND_BUFFER_FIXED_SIZE + 48 * 8;
+// The package size is an uint16, the receive buffer holds at least one partial and one complete package
+const std::size_t MAX_PACKAGE_SIZE = 65535;
+const std::size_t RECEIVE_BUFFER_SIZE = 2 * MAX_PACKAGE_SIZE;
 #define RTDE_PROTOCOL_VERSION 2
 #define DEBUG_OUTPUT false
 
@@ -43,7 +55,14 @@ RTDE::RTDE(const std::string hostname, int port, bool verbose)
       port_(port),
       verbose_(verbose),
       conn_state_(ConnectionState::DISCONNECTED),
-      deadline_(io_service_)
+      buffer_(RECEIVE_BUFFER_SIZE),
+      buffer_begin_(0),
+      buffer_end_(0),
+      deadline_(io_service_),
+      send_buffer_(SEND_BUFFER_INITIAL_SIZE),
+      decode_size_(0),
+      decode_plan_bound_(false),
+      controller_version_received_(false)
 {
   // No deadline is required until the first socket operation is started. We
   // set the deadline to positive infinity so that the actor takes no action
@@ -60,7 +79,10 @@ void RTDE::connect()
 {
   try
   {
-    buffer_.clear();  // ensure empty state in case of reconnect
+    // ensure empty state in case of reconnect
+    buffer_begin_ = 0;
+    buffer_end_ = 0;
+    controller_version_received_ = false;
     socket_.reset(new boost::asio::ip::tcp::socket(io_service_));
     socket_->open(boost::asio::ip::tcp::v4());
     boost::asio::ip::tcp::no_delay no_delay_option(true);
@@ -97,8 +119,11 @@ void RTDE::disconnect(bool send_pause)
   /* We use reset() to safely close the socket,
    * see: https://stackoverflow.com/questions/3062803/how-do-i-cleanly-reconnect-a-boostsocket-following-a-disconnect
    */
-  socket_.reset();
-  conn_state_ = ConnectionState::DISCONNECTED;
+  {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    socket_.reset();
+    conn_state_ = ConnectionState::DISCONNECTED;
+  }
   if (verbose_)
     std::cout << "RTDE - Socket disconnected" << std::endl;
 }
@@ -132,11 +157,7 @@ bool RTDE::negotiateProtocolVersion()
 bool RTDE::sendInputSetup(const std::vector<std::string> &input_names)
 {
   std::uint8_t cmd = RTDE_CONTROL_PACKAGE_SETUP_INPUTS;
-  // Concatenate input_names to a single string
-  std::string input_names_str;
-  for (const auto &input_name : input_names)
-    input_names_str += input_name + ",";
-  sendAll(cmd, input_names_str);
+  sendAll(cmd, packInputSetup(input_names));
   DEBUG("Done sending RTDE_CONTROL_PACKAGE_SETUP_INPUTS");
   receive();
   return true;
@@ -148,7 +169,45 @@ bool RTDE::sendOutputSetup(const std::vector<std::string> &output_names, double
 
   // First save the output_names for use in the receiveData function
   output_names_ = output_names;
+  sendAll(cmd, packOutputSetup(output_names, frequency));
+  DEBUG("Done sending RTDE_CONTROL_PACKAGE_SETUP_OUTPUTS");
+  receive();
+  return true;
+}
+
+bool RTDE::sendRecipeSetup(const std::vector<std::string> &output_names, double frequency,
+                           const std::vector<std::vector<std::string>> &input_recipes)
+{
+  // First save the output_names for use in the receiveData function
+  output_names_ = output_names;
+
+  std::vector<char> messages;
+  packMessage(messages, RTDE_CONTROL_PACKAGE_SETUP_OUTPUTS, packOutputSetup(output_names, frequency));
+  for (const auto &input_names : input_recipes)
+    packMessage(messages, RTDE_CONTROL_PACKAGE_SETUP_INPUTS, packInputSetup(input_names));
+  write(messages);
+  DEBUG("Done sending " << input_recipes.size() + 1 << " RTDE_CONTROL_PACKAGE_SETUP messages");
+
+  // The controller answers the setup messages in the order they were sent. The replies are validated by
+  // receiveMessage(), which throws if a variable is not found or an input is already in use.
+  std::size_t replies = 0;
+  while (replies < input_recipes.size() + 1)
+  {
+    std::uint8_t expected_cmd = replies == 0 ? RTDE_CONTROL_PACKAGE_SETUP_OUTPUTS : RTDE_CONTROL_PACKAGE_SETUP_INPUTS;
+    std::uint8_t msg_cmd = receiveMessage();
+    if (msg_cmd == RTDE_TEXT_MESSAGE)
+      continue;
+    if (msg_cmd != expected_cmd)
+      throw std::runtime_error("Unexpected reply to the RTDE recipe setup, received command " +
+                               std::to_string(static_cast<int>(msg_cmd)) + " while expecting " +
+                               std::to_string(static_cast<int>(expected_cmd)));
+    replies++;
+  }
+  return true;
+}
 
+std::string RTDE::packOutputSetup(const std::vector<std::string> &output_names, double frequency) const
+{
   std::string freq_as_hexstr = RTDEUtility::double2hexstr(frequency);
   std::vector<char> freq_packed = RTDEUtility::hexToBytes(freq_as_hexstr);
   // Concatenate output_names to a single string
@@ -157,162 +216,200 @@ bool RTDE::sendOutputSetup(const std::vector<std::string> &output_names, double
     output_names_str += output_name + ",";
 
   std::copy(output_names_str.begin(), output_names_str.end(), std::back_inserter(freq_packed));
-  std::string payload(std::begin(freq_packed), std::end(freq_packed));
-  sendAll(cmd, payload);
-  DEBUG("Done sending RTDE_CONTROL_PACKAGE_SETUP_OUTPUTS");
-  receive();
-  return true;
+  return std::string(std::begin(freq_packed), std::end(freq_packed));
 }
 
-void RTDE::send(const RobotCommand &robot_cmd)
+std::string RTDE::packInputSetup(const std::vector<std::string> &input_names) const
 {
-  std::uint8_t command = RTDE_DATA_PACKAGE;
-  std::vector<char> cmd_packed;
-  cmd_packed = RTDEUtility::packInt32(robot_cmd.type_);
+  // Concatenate input_names to a single string
+  std::string input_names_str;
+  for (const auto &input_name : input_names)
+    input_names_str += input_name + ",";
+  return input_names_str;
+}
 
-  if (robot_cmd.type_ == RobotCommand::FT_RTDE_INPUT_ENABLE ||
-      robot_cmd.type_ == RobotCommand::ENABLE_EXTERNAL_FT_SENSOR)
+void RTDE::send(const RobotCommand &robot_cmd, std::uint8_t recipe_offset)
+{
+  // Upper bound of the encoded command: the fixed size fields plus the variable length vectors
+  std::size_t max_size = HEADER_SIZE + SEND_BUFFER_FIXED_SIZE + 8 * robot_cmd.val_.size() +
+                          4 * (robot_cmd.free_axes_.size() + robot_cmd.selection_vector_.size());
+  // A path append fills all integer arguments of its recipe, the waypoint count and the kinds
+  if (robot_cmd.type_ == RobotCommand::PATH_APPEND)
+    max_size += 4 * RealtimeCommand::MAX_INT_ARGUMENTS;
+
+  // The command is encoded directly into the send buffer, which only grows when a larger command than
+  // before is sent. It is guarded by the send mutex, since interfaces sharing an RTDESession send concurrently.
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  if (send_buffer_.size() < max_size)
+    send_buffer_.resize(max_size);
+
+  char *begin = send_buffer_.data();
+  char *out = begin + HEADER_SIZE;
+  *out++ = static_cast<char>(robot_cmd.recipe_id_ + recipe_offset);
+  // The watchdog is kicked by any data package, it is sent as an empty command
+  RobotCommand::Type type = robot_cmd.type_ == RobotCommand::WATCHDOG ? RobotCommand::NO_CMD : robot_cmd.type_;
+  out = RTDEUtility::writeInt32(out, type);
+
+  switch (robot_cmd.type_)
   {
-    std::vector<char> ft_rtde_input_enable_packed = RTDEUtility::packInt32(robot_cmd.ft_rtde_input_enable_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(ft_rtde_input_enable_packed.begin()),
-                      std::make_move_iterator(ft_rtde_input_enable_packed.end()));
-  }
+    case RobotCommand::FT_RTDE_INPUT_ENABLE:
+    case RobotCommand::ENABLE_EXTERNAL_FT_SENSOR:
+      out = RTDEUtility::writeInt32(out, robot_cmd.ft_rtde_input_enable_);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::FREEDRIVE_MODE)
-  {
-    std::vector<char> free_axes_packed = RTDEUtility::packVectorNInt32(robot_cmd.free_axes_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(free_axes_packed.begin()),
-                      std::make_move_iterator(free_axes_packed.end()));
-  }
+    case RobotCommand::FREEDRIVE_MODE:
+      for (auto axis : robot_cmd.free_axes_)
+        out = RTDEUtility::writeInt32(out, axis);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::SET_INPUT_INT_REGISTER)
-  {
-    std::vector<char> reg_int_packed = RTDEUtility::packInt32(robot_cmd.reg_int_val_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(reg_int_packed.begin()),
-                      std::make_move_iterator(reg_int_packed.end()));
-  }
+    case RobotCommand::SET_INPUT_INT_REGISTER:
+      out = RTDEUtility::writeInt32(out, robot_cmd.reg_int_val_);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::SET_INPUT_DOUBLE_REGISTER)
-  {
-    std::vector<char> reg_double_packed = RTDEUtility::packDouble(robot_cmd.reg_double_val_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(reg_double_packed.begin()),
-                      std::make_move_iterator(reg_double_packed.end()));
-  }
+    case RobotCommand::SET_INPUT_DOUBLE_REGISTER:
+      out = RTDEUtility::writeDouble(out, robot_cmd.reg_double_val_);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::WATCHDOG)
-  {
-    cmd_packed = RTDEUtility::packInt32(RobotCommand::NO_CMD);
-  }
+    case RobotCommand::FORCE_MODE:
+      out = RTDEUtility::writeInt32(out, robot_cmd.force_mode_type_);
+      for (auto selection : robot_cmd.selection_vector_)
+        out = RTDEUtility::writeInt32(out, selection);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::FORCE_MODE)
-  {
-    std::vector<char> force_mode_type_packed = RTDEUtility::packInt32(robot_cmd.force_mode_type_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(force_mode_type_packed.begin()),
-                      std::make_move_iterator(force_mode_type_packed.end()));
+    case RobotCommand::GET_ACTUAL_JOINT_POSITIONS_HISTORY:
+      out = RTDEUtility::writeUInt32(out, robot_cmd.steps_);
+      break;
 
-    std::vector<char> sel_vector_packed = RTDEUtility::packVectorNInt32(robot_cmd.selection_vector_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(sel_vector_packed.begin()),
-                      std::make_move_iterator(sel_vector_packed.end()));
-  }
+    case RobotCommand::PATH_APPEND:
+      // The number of waypoints followed by their kinds, padded to the integer registers of the recipe
+      out = RTDEUtility::writeInt32(out, static_cast<std::int32_t>(robot_cmd.path_entry_kinds_.size()));
+      for (std::size_t i = 0; i < RealtimeCommand::MAX_INT_ARGUMENTS - 1; i++)
+        out = RTDEUtility::writeInt32(out, i < robot_cmd.path_entry_kinds_.size() ? robot_cmd.path_entry_kinds_[i] : 0);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::GET_ACTUAL_JOINT_POSITIONS_HISTORY)
-  {
-    std::vector<char> actual_joint_positions_history_packed = RTDEUtility::packUInt32(robot_cmd.steps_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(actual_joint_positions_history_packed.begin()),
-                      std::make_move_iterator(actual_joint_positions_history_packed.end()));
+    default:
+      break;
   }
 
-  if (!robot_cmd.val_.empty())
-  {
-    std::vector<char> vector_nd_packed = RTDEUtility::packVectorNd(robot_cmd.val_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(vector_nd_packed.begin()),
-                      std::make_move_iterator(vector_nd_packed.end()));
-  }
+  for (auto value : robot_cmd.val_)
+    out = RTDEUtility::writeDouble(out, value);
 
-  if (robot_cmd.type_ == RobotCommand::MOVEJ || robot_cmd.type_ == RobotCommand::MOVEJ_IK ||
-      robot_cmd.type_ == RobotCommand::MOVEL || robot_cmd.type_ == RobotCommand::MOVEL_FK ||
-      robot_cmd.type_ == RobotCommand::MOVE_PATH || robot_cmd.type_ == RobotCommand::STOPJ ||
-      robot_cmd.type_ == RobotCommand::STOPL)
+  switch (robot_cmd.type_)
   {
-    std::vector<char> async_packed = RTDEUtility::packInt32(robot_cmd.async_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(async_packed.begin()),
-                      std::make_move_iterator(async_packed.end()));
-  }
+    case RobotCommand::MOVEJ:
+    case RobotCommand::MOVEJ_IK:
+    case RobotCommand::MOVEL:
+    case RobotCommand::MOVEL_FK:
+    case RobotCommand::MOVE_PATH:
+    case RobotCommand::STOPJ:
+    case RobotCommand::STOPL:
+      out = RTDEUtility::writeInt32(out, robot_cmd.async_);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::SET_STD_DIGITAL_OUT)
-  {
-    cmd_packed.push_back(robot_cmd.std_digital_out_mask_);
-    cmd_packed.push_back(robot_cmd.std_digital_out_);
-  }
+    case RobotCommand::SET_STD_DIGITAL_OUT:
+      *out++ = static_cast<char>(robot_cmd.std_digital_out_mask_);
+      *out++ = static_cast<char>(robot_cmd.std_digital_out_);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::SET_CONF_DIGITAL_OUT)
-  {
-    cmd_packed.push_back(robot_cmd.configurable_digital_out_mask_);
-    cmd_packed.push_back(robot_cmd.configurable_digital_out_);
-  }
+    case RobotCommand::SET_CONF_DIGITAL_OUT:
+      *out++ = static_cast<char>(robot_cmd.configurable_digital_out_mask_);
+      *out++ = static_cast<char>(robot_cmd.configurable_digital_out_);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::SET_TOOL_DIGITAL_OUT)
-  {
-    cmd_packed.push_back(robot_cmd.std_tool_out_mask_);
-    cmd_packed.push_back(robot_cmd.std_tool_out_);
-  }
+    case RobotCommand::SET_TOOL_DIGITAL_OUT:
+      *out++ = static_cast<char>(robot_cmd.std_tool_out_mask_);
+      *out++ = static_cast<char>(robot_cmd.std_tool_out_);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::SET_SPEED_SLIDER)
-  {
-    std::vector<char> speed_slider_mask_packed = RTDEUtility::packInt32(robot_cmd.speed_slider_mask_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(speed_slider_mask_packed.begin()),
-                      std::make_move_iterator(speed_slider_mask_packed.end()));
+    case RobotCommand::SET_SPEED_SLIDER:
+      out = RTDEUtility::writeInt32(out, robot_cmd.speed_slider_mask_);
+      out = RTDEUtility::writeDouble(out, robot_cmd.speed_slider_fraction_);
+      break;
 
-    std::vector<char> speed_slider_fraction_packed = RTDEUtility::packDouble(robot_cmd.speed_slider_fraction_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(speed_slider_fraction_packed.begin()),
-                      std::make_move_iterator(speed_slider_fraction_packed.end()));
-  }
+    case RobotCommand::SET_STD_ANALOG_OUT:
+      *out++ = static_cast<char>(robot_cmd.std_analog_output_mask_);
+      *out++ = static_cast<char>(robot_cmd.std_analog_output_type_);
+      out = RTDEUtility::writeDouble(out, robot_cmd.std_analog_output_0_);
+      out = RTDEUtility::writeDouble(out, robot_cmd.std_analog_output_1_);
+      break;
 
-  if (robot_cmd.type_ == RobotCommand::SET_STD_ANALOG_OUT)
-  {
-    cmd_packed.push_back(robot_cmd.std_analog_output_mask_);
-    cmd_packed.push_back(robot_cmd.std_analog_output_type_);
-    std::vector<char> std_analog_output_0_packed = RTDEUtility::packDouble(robot_cmd.std_analog_output_0_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(std_analog_output_0_packed.begin()),
-                      std::make_move_iterator(std_analog_output_0_packed.end()));
-    std::vector<char> std_analog_output_1_packed = RTDEUtility::packDouble(robot_cmd.std_analog_output_1_);
-    cmd_packed.insert(cmd_packed.end(), std::make_move_iterator(std_analog_output_1_packed.begin()),
-                      std::make_move_iterator(std_analog_output_1_packed.end()));
+    default:
+      break;
   }
 
-  cmd_packed.insert(cmd_packed.begin(), robot_cmd.recipe_id_);
-  std::string sent(cmd_packed.begin(), cmd_packed.end());
+  // Fill in the header now that the size is known
+  auto size = static_cast<std::uint16_t>(out - begin);
+  begin[0] = static_cast<char>(size >> 8);
+  begin[1] = static_cast<char>(size);
+  begin[2] = static_cast<char>(RTDE_DATA_PACKAGE);
 
-  sendAll(command, sent);
+  DEBUG("SENDING buf with len: " << size);
+  if (isConnected())
+    boost::asio::write(*socket_, boost::asio::buffer(begin, size));
+  DEBUG("Done sending RTDE_DATA_PACKAGE");
+}
+
+void RTDE::send(const RealtimeCommand &robot_cmd, std::uint8_t recipe_offset)
+{
+  // The send buffer is allocated for the largest recipe up front, so this never grows it
+  static_assert(SEND_BUFFER_INITIAL_SIZE >= HEADER_SIZE + 1 + 4 * (1 + RealtimeCommand::MAX_INT_ARGUMENTS) +
+                                                8 * RealtimeCommand::MAX_DOUBLE_ARGUMENTS,
+                "The send buffer must fit the largest realtime command");
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  char *begin = send_buffer_.data();
+  char *out = begin + HEADER_SIZE;
+  *out++ = static_cast<char>(robot_cmd.recipe_id_ + recipe_offset);
+  RobotCommand::Type type = robot_cmd.type_ == RobotCommand::WATCHDOG ? RobotCommand::NO_CMD : robot_cmd.type_;
+  out = RTDEUtility::writeInt32(out, type);
+  for (std::size_t i = 0; i < robot_cmd.int_count_; i++)
+    out = RTDEUtility::writeInt32(out, robot_cmd.int_arguments_[i]);
+  for (std::size_t i = 0; i < robot_cmd.double_count_; i++)
+    out = RTDEUtility::writeDouble(out, robot_cmd.double_arguments_[i]);
+
+  auto size = static_cast<std::uint16_t>(out - begin);
+  begin[0] = static_cast<char>(size >> 8);
+  begin[1] = static_cast<char>(size);
+  begin[2] = static_cast<char>(RTDE_DATA_PACKAGE);
+
+  DEBUG("SENDING buf with len: " << size);
+  if (isConnected())
+    boost::asio::write(*socket_, boost::asio::buffer(begin, size));
   DEBUG("Done sending RTDE_DATA_PACKAGE");
 }
 
 void RTDE::sendAll(const std::uint8_t &command, std::string payload)
 {
   DEBUG("Payload size is: " << payload.size());
+  std::vector<char> header_packed;
+  packMessage(header_packed, command, payload);
+  write(header_packed);
+}
+
+void RTDE::packMessage(std::vector<char> &buffer, std::uint8_t command, const std::string &payload)
+{
   // Pack size and command into header
   uint16_t size = htons(HEADER_SIZE + (uint16_t)payload.size());
   uint8_t type = command;
 
-  char buffer[3];
-  memcpy(buffer + 0, &size, sizeof(size));
-  memcpy(buffer + 2, &type, sizeof(type));
+  char header[3];
+  memcpy(header + 0, &size, sizeof(size));
+  memcpy(header + 2, &type, sizeof(type));
 
-  // Create vector<char> that includes the header
-  std::vector<char> header_packed;
-  std::copy(buffer, buffer + sizeof(buffer), std::back_inserter(header_packed));
-
-  // Add the payload to the header_packed vector
-  std::copy(payload.begin(), payload.end(), std::back_inserter(header_packed));
+  // Add the header and the payload to the buffer
+  buffer.insert(buffer.end(), header, header + sizeof(header));
+  buffer.insert(buffer.end(), payload.begin(), payload.end());
+}
 
-  std::string sent(header_packed.begin(), header_packed.end());
-  DEBUG("SENDING buf containing: " << sent << " with len: " << sent.size());
+void RTDE::write(const std::vector<char> &buffer)
+{
+  DEBUG("SENDING buf with len: " << buffer.size());
 
   // This is a workaround for the moment to prevent crash when calling this
   // function is RTDE is disconnected - i.e. in case of desynchronization
+  std::lock_guard<std::mutex> lock(send_mutex_);
   if (isConnected())
   {
-    boost::asio::write(*socket_, boost::asio::buffer(header_packed, header_packed.size()));
+    boost::asio::write(*socket_, boost::asio::buffer(buffer, buffer.size()));
   }
 }
 
@@ -333,6 +430,11 @@ void RTDE::sendPause()
 }
 
 void RTDE::receive()
+{
+  receiveMessage();
+}
+
+std::uint8_t RTDE::receiveMessage()
 {
   DEBUG("Receiving...");
   // Read Header
@@ -427,6 +529,7 @@ void RTDE::receive()
             "https://www.universal-robots.com/articles/ur/interface-communication/real-time-data-exchange-rtde-guide/");
         throw std::runtime_error(error_str);
       }
+      compileDecodePlan();
       break;
     }
 
@@ -467,6 +570,7 @@ void RTDE::receive()
       DEBUG("Unknown Command: " << static_cast<int>(msg_cmd));
       break;
   }
+  return msg_cmd;
 }
 
 template <typename AsyncReadStream, typename MutableBufferSequence>
@@ -521,41 +625,70 @@ bool RTDE::isDataAvailable()
     return false;
 }
 
+bool RTDE::waitForData(int timeout_ms)
+{
+  if (socket_ == nullptr)
+    return false;
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+  WSAPOLLFD poll_fd{};
+  poll_fd.fd = socket_->native_handle();
+  poll_fd.events = POLLRDNORM;
+  int ret = WSAPoll(&poll_fd, 1, timeout_ms);
+#else
+  pollfd poll_fd{};
+  poll_fd.fd = socket_->native_handle();
+  poll_fd.events = POLLIN;
+  int ret;
+  do
+  {
+    ret = ::poll(&poll_fd, 1, timeout_ms);
+  } while (ret < 0 && errno == EINTR);
+#endif
+  return ret != 0;
+}
+
 boost::system::error_code RTDE::receiveData(std::shared_ptr<RobotState> &robot_state)
 {
   boost::system::error_code error;
   uint32_t message_offset = 0;
   uint32_t packet_data_offset = 0;
 
-  // Prepare buffer of 4096 bytes
-  std::vector<char> data(4096);
-  size_t data_len = 0;
+  // Move a trailing partial package to the front of the buffer, if there is no longer room for a full package
+  // behind it. Complete packages are always consumed, so this only moves the bytes of one partial package.
+  if (RECEIVE_BUFFER_SIZE - buffer_end_ < MAX_PACKAGE_SIZE)
+  {
+    std::memmove(buffer_.data(), buffer_.data() + buffer_begin_, buffer_end_ - buffer_begin_);
+    buffer_end_ -= buffer_begin_;
+    buffer_begin_ = 0;
+  }
 
-  data_len = async_read_some(*socket_, boost::asio::buffer(data), error);
+  size_t data_len = async_read_some(
+      *socket_, boost::asio::buffer(buffer_.data() + buffer_end_, RECEIVE_BUFFER_SIZE - buffer_end_), error);
   if (error)
     return error;
+  buffer_end_ += data_len;
 
-  // Add data to the buffer
-  buffer_.insert(buffer_.end(), data.begin(), data.begin() + data_len);
-
-  while (buffer_.size() >= HEADER_SIZE)
+  while (buffer_end_ - buffer_begin_ >= HEADER_SIZE)
   {
     message_offset = 0;
     // Read RTDEControlHeader
-    RTDEControlHeader packet_header = RTDEUtility::readRTDEHeader(buffer_, message_offset);
-    // std::cout << "RTDEControlHeader: " << std::endl;
-    // std::cout << "size is: " << packet_header.msg_size << std::endl;
-    // std::cout << "command is: " << static_cast<int>(packet_header.msg_cmd) << std::endl;
+    RTDEControlHeader packet_header = RTDEUtility::readRTDEHeader(buffer_.data() + buffer_begin_, message_offset);
+    if (packet_header.msg_size < HEADER_SIZE)
+      return boost::system::errc::make_error_code(boost::system::errc::bad_message);
 
-    if (buffer_.size() >= packet_header.msg_size)
+    if (buffer_end_ - buffer_begin_ >= packet_header.msg_size)
     {
-      // Read data package and adjust buffer
-      std::vector<char> packet(buffer_.begin() + HEADER_SIZE, buffer_.begin() + packet_header.msg_size);
-      buffer_.erase(buffer_.begin(), buffer_.begin() + packet_header.msg_size);
+      // Decode the package in place and advance the read position past it
+      const char *packet = buffer_.data() + buffer_begin_ + HEADER_SIZE;
+      const std::size_t packet_size = packet_header.msg_size - HEADER_SIZE;
+      buffer_begin_ += packet_header.msg_size;
 
-      if (buffer_.size() >= HEADER_SIZE && packet_header.msg_cmd == RTDE_DATA_PACKAGE)
+      if (buffer_end_ - buffer_begin_ >= HEADER_SIZE && packet_header.msg_cmd == RTDE_DATA_PACKAGE)
       {
-        RTDEControlHeader next_packet_header = RTDEUtility::readRTDEHeader(buffer_, message_offset);
+        message_offset = 0;
+        RTDEControlHeader next_packet_header =
+            RTDEUtility::readRTDEHeader(buffer_.data() + buffer_begin_, message_offset);
         if (next_packet_header.msg_cmd == RTDE_DATA_PACKAGE)
         {
           if (verbose_)
@@ -566,56 +699,61 @@ boost::system::error_code RTDE::receiveData(std::shared_ptr<RobotState> &robot_s
 
       if (packet_header.msg_cmd == RTDE_DATA_PACKAGE)
       {
-        packet_data_offset = 0;
-        RTDEUtility::getUChar(packet, packet_data_offset);
+        if (packet_size < decode_size_)
+        {
+          if (verbose_)
+            std::cout << "skipping package(3), data package is smaller than the output recipe" << std::endl;
+          continue;
+        }
+
+        if (!decode_plan_bound_ || decode_state_.owner_before(robot_state) || robot_state.owner_before(decode_state_))
+          bindDecodePlan(robot_state);
 
         robot_state->lockUpdateStateMutex();
 
-        // Read all the variables specified by the user.
-        for (const auto &output_name : output_names_)
+        // Read all the variables specified by the user, following the precompiled decode plan.
+        for (const auto &entry : decode_plan_)
         {
-          if (robot_state->state_types_.find(output_name) != robot_state->state_types_.end())
+          if (entry.slot < 0)
+            continue;
+
+          packet_data_offset = entry.offset;
+          switch (entry.wire_type)
           {
-            rtde_type_variant_ entry = robot_state->state_types_[output_name];
-            if (entry.type() == typeid(std::vector<double>))
-            {
-              std::vector<double> parsed_data;
-              if (output_name == "actual_tool_accelerometer" || output_name == "payload_cog" ||
-                  output_name == "elbow_position" || output_name == "elbow_velocity")
-                parsed_data = RTDEUtility::unpackVector3d(packet, packet_data_offset);
-              else
-                parsed_data = RTDEUtility::unpackVector6d(packet, packet_data_offset);
-              robot_state->setStateData(output_name, parsed_data);
-            }
-            else if (entry.type() == typeid(double))
-            {
-              double parsed_data = RTDEUtility::getDouble(packet, packet_data_offset);
-              robot_state->setStateData(output_name, parsed_data);
-            }
-            else if (entry.type() == typeid(int32_t))
-            {
-              int32_t parsed_data = RTDEUtility::getInt32(packet, packet_data_offset);
-              robot_state->setStateData(output_name, parsed_data);
-            }
-            else if (entry.type() == typeid(uint32_t))
-            {
-              uint32_t parsed_data = RTDEUtility::getUInt32(packet, packet_data_offset);
-              robot_state->setStateData(output_name, parsed_data);
-            }
-            else if (entry.type() == typeid(uint64_t))
+            case WireType::DOUBLE:
+              robot_state->storeDouble(entry.slot, RTDEUtility::getDouble(packet, packet_data_offset));
+              break;
+
+            case WireType::INT32:
+              robot_state->storeInt32(entry.slot, RTDEUtility::getInt32(packet, packet_data_offset));
+              break;
+
+            case WireType::UINT32:
+              robot_state->storeUInt32(entry.slot, RTDEUtility::getUInt32(packet, packet_data_offset));
+              break;
+
+            case WireType::UINT64:
+              robot_state->storeUInt64(entry.slot, RTDEUtility::getUInt64(packet, packet_data_offset));
+              break;
+
+            case WireType::VECTOR3D:
+            case WireType::VECTOR6D:
             {
-              uint64_t parsed_data = RTDEUtility::getUInt64(packet, packet_data_offset);
-              robot_state->setStateData(output_name, parsed_data);
+              std::int32_t size = entry.wire_type == WireType::VECTOR3D ? 3 : 6;
+              for (std::int32_t i = 0; i < size; i++)
+                robot_state->storeDouble(entry.slot + i, RTDEUtility::getDouble(packet, packet_data_offset));
+              break;
             }
-            else if (entry.type() == typeid(std::vector<int32_t>))
+
+            case WireType::VECTOR6INT32:
             {
-              std::vector<int32_t> parsed_data = RTDEUtility::unpackVector6Int32(packet, packet_data_offset);
-              robot_state->setStateData(output_name, parsed_data);
+              for (std::int32_t i = 0; i < 6; i++)
+                robot_state->storeInt32(entry.slot + i, RTDEUtility::getInt32(packet, packet_data_offset));
+              break;
             }
-          }
-          else
-          {
-            DEBUG("Unknown variable name: " << output_name << " please verify the output setup!");
+
+            default:
+              break;
           }
         }
 
@@ -635,11 +773,150 @@ boost::system::error_code RTDE::receiveData(std::shared_ptr<RobotState> &robot_s
       break;
     }
   }
+
+  // All complete packages consumed, start over at the front of the buffer
+  if (buffer_begin_ == buffer_end_)
+  {
+    buffer_begin_ = 0;
+    buffer_end_ = 0;
+  }
   return error;
 }
 
+void RTDE::compileDecodePlan()
+{
+  if (output_types_.size() != output_names_.size())
+    throw std::runtime_error("The controller returned " + std::to_string(output_types_.size()) +
+                             " output types for an output recipe of " + std::to_string(output_names_.size()) +
+                             " variables");
+
+  decode_plan_.clear();
+  decode_plan_.reserve(output_types_.size());
+  // The payload of a data package starts with the recipe id
+  std::uint32_t offset = 1;
+  for (std::size_t i = 0; i < output_types_.size(); i++)
+  {
+    const std::string &type = output_types_[i];
+    DecodeEntry entry{};
+    entry.field_id = static_cast<std::uint16_t>(i);
+    entry.offset = offset;
+    entry.slot = -1;
+    if (type == "DOUBLE")
+    {
+      entry.wire_type = WireType::DOUBLE;
+      offset += 8;
+    }
+    else if (type == "INT32")
+    {
+      entry.wire_type = WireType::INT32;
+      offset += 4;
+    }
+    else if (type == "UINT32")
+    {
+      entry.wire_type = WireType::UINT32;
+      offset += 4;
+    }
+    else if (type == "UINT64")
+    {
+      entry.wire_type = WireType::UINT64;
+      offset += 8;
+    }
+    else if (type == "VECTOR3D")
+    {
+      entry.wire_type = WireType::VECTOR3D;
+      offset += 3 * 8;
+    }
+    else if (type == "VECTOR6D")
+    {
+      entry.wire_type = WireType::VECTOR6D;
+      offset += 6 * 8;
+    }
+    else if (type == "VECTOR6INT32")
+    {
+      entry.wire_type = WireType::VECTOR6INT32;
+      offset += 6 * 4;
+    }
+    else if (type == "VECTOR6UINT32")
+    {
+      entry.wire_type = WireType::VECTOR6UINT32;
+      offset += 6 * 4;
+    }
+    else if (type == "BOOL")
+    {
+      entry.wire_type = WireType::BOOL;
+      offset += 1;
+    }
+    else if (type == "UINT8")
+    {
+      entry.wire_type = WireType::UINT8;
+      offset += 1;
+    }
+    else
+    {
+      throw std::runtime_error("Unsupported RTDE data type: " + type + " for output variable: " + output_names_[i]);
+    }
+    decode_plan_.push_back(entry);
+  }
+  decode_size_ = offset;
+  decode_plan_bound_ = false;
+}
+
+void RTDE::bindDecodePlan(const std::shared_ptr<RobotState> &robot_state)
+{
+  for (auto &entry : decode_plan_)
+  {
+    const std::string &output_name = output_names_[entry.field_id];
+    bool stored = true;
+    RobotState::ValueType type = RobotState::ValueType::DOUBLE;
+    std::uint16_t size = 1;
+    switch (entry.wire_type)
+    {
+      case WireType::DOUBLE:
+        type = RobotState::ValueType::DOUBLE;
+        break;
+      case WireType::INT32:
+        type = RobotState::ValueType::INT32;
+        break;
+      case WireType::UINT32:
+        type = RobotState::ValueType::UINT32;
+        break;
+      case WireType::UINT64:
+        type = RobotState::ValueType::UINT64;
+        break;
+      case WireType::VECTOR3D:
+        type = RobotState::ValueType::VECTOR_DOUBLE;
+        size = 3;
+        break;
+      case WireType::VECTOR6D:
+        type = RobotState::ValueType::VECTOR_DOUBLE;
+        size = 6;
+        break;
+      case WireType::VECTOR6INT32:
+        type = RobotState::ValueType::VECTOR_INT32;
+        size = 6;
+        break;
+      default:
+        stored = false;
+        break;
+    }
+
+    entry.slot = stored ? robot_state->getStateOffset(output_name, type, size) : -1;
+    if (entry.slot < 0)
+    {
+      DEBUG("Output variable " << output_name << " is unknown or does not match its type in the robot state, it is "
+            "not stored");
+    }
+  }
+  decode_state_ = robot_state;
+  decode_plan_bound_ = true;
+}
+
 std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t> RTDE::getControllerVersion()
 {
+  // The version cannot change during a connection, only ask the controller once
+  if (controller_version_received_)
+    return controller_version_;
+
   std::uint8_t cmd = RTDE_GET_URCONTROL_VERSION;
   sendAll(cmd, "");
   DEBUG("Done sending RTDE_GET_URCONTROL_VERSION");
@@ -660,7 +937,9 @@ std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t> RTDE::get
     std::uint32_t v_bugfix = RTDEUtility::getUInt32(data, message_offset);
     std::uint32_t v_build = RTDEUtility::getUInt32(data, message_offset);
     DEBUG(v_major << "." << v_minor << "." << v_bugfix << "." << v_build);
-    return std::make_tuple(v_major, v_minor, v_bugfix, v_build);
+    controller_version_ = std::make_tuple(v_major, v_minor, v_bugfix, v_build);
+    controller_version_received_ = true;
+    return controller_version_;
   }
   else
   {
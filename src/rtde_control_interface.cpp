@@ -1,11 +1,14 @@
 #include <ur_rtde/dashboard_client.h>
+#include <ur_rtde/pose_math.h>
 #include <ur_rtde/robot_state.h>
 #include <ur_rtde/rtde_control_interface.h>
+#include <ur_rtde/rtde_session.h>
 #include <ur_rtde/rtde_utility.h>
 #include <ur_rtde/script_client.h>
 #if !defined(_WIN32) && !defined(__APPLE__)
 #include <urcl/script_sender.h>
 #endif
+#include <algorithm>
 #include <bitset>
 #include <boost/thread/thread.hpp>
 #include <chrono>
@@ -16,6 +19,21 @@
 namespace ur_rtde
 {
 static const std::string move_path_inject_id = "# inject move path\n";
+// Longer than the period of the slowest (125 Hz) RTDE stream
+static const int RECEIVE_WAIT_TIMEOUT_MS = 10;
+// Waypoints per path_append command, limited by the 18 double registers of RECIPE_3
+static const std::size_t PATH_APPEND_CHUNK_SIZE = 2;
+
+template <typename T>
+static void verifyVectorSize(const std::vector<T> &values, std::size_t size, const char *name)
+{
+  if (values.size() != size)
+  {
+    std::ostringstream oss;
+    oss << name << " must have " << size << " elements, it has " << values.size();
+    throw std::invalid_argument(oss.str());
+  }
+}
 
 static void verifyValueIsWithin(const double &value, const double &min, const double &max)
 {
@@ -35,6 +53,38 @@ static void verifyValueIsWithin(const double &value, const double &min, const do
   }
 }
 
+struct VelocityAccLimits
+{
+  double velocity_min;
+  double velocity_max;
+  double acceleration_min;
+  double acceleration_max;
+};
+
+static void verifyPathEntry(const PathEntry &entry)
+{
+  static const VelocityAccLimits joint_limits = {UR_JOINT_VELOCITY_MIN, UR_JOINT_VELOCITY_MAX,
+                                                 UR_JOINT_ACCELERATION_MIN, UR_JOINT_ACCELERATION_MAX};
+  static const VelocityAccLimits tool_limits = {UR_TOOL_VELOCITY_MIN, UR_TOOL_VELOCITY_MAX, UR_TOOL_ACCELERATION_MIN,
+                                                UR_TOOL_ACCELERATION_MAX};
+
+  verifyVectorSize(entry.param_, 9, "PathEntry parameters");
+  const VelocityAccLimits &limits = (PathEntry::PositionJoints == entry.pos_type_) ? joint_limits : tool_limits;
+  switch (entry.move_type_)
+  {
+    case PathEntry::MoveJ:
+    case PathEntry::MoveL:
+    case PathEntry::MoveP:
+      verifyValueIsWithin(entry.param_[6], limits.velocity_min, limits.velocity_max);
+      verifyValueIsWithin(entry.param_[7], limits.acceleration_min, limits.acceleration_max);
+      verifyValueIsWithin(entry.param_[8], UR_BLEND_MIN, UR_BLEND_MAX);
+      break;
+    case PathEntry::MoveC:
+      throw std::runtime_error("MoveC in path not supported yet");
+      break;
+  }
+}
+
 RTDEControlInterface::RTDEControlInterface(std::string hostname,
                                            std::string heartbeat_ip,
                                            std::string heartbeat_port,
@@ -42,7 +92,31 @@ RTDEControlInterface::RTDEControlInterface(std::string hostname,
                                            uint16_t flags,
                                            int ur_cap_port,
                                            int rt_priority)
-    : hostname_(std::move(hostname)),
+    : RTDEControlInterface(nullptr, std::move(hostname), std::move(heartbeat_ip), std::move(heartbeat_port), frequency,
+                           flags, ur_cap_port, rt_priority)
+{
+}
+
+RTDEControlInterface::RTDEControlInterface(std::shared_ptr<RTDESession> session,
+                                           std::string heartbeat_ip,
+                                           std::string heartbeat_port,
+                                           uint16_t flags,
+                                           int ur_cap_port)
+    : RTDEControlInterface(session, session->getHostname(), std::move(heartbeat_ip), std::move(heartbeat_port),
+                           session->getFrequency(), flags, ur_cap_port, RT_PRIORITY_UNDEFINED)
+{
+}
+
+RTDEControlInterface::RTDEControlInterface(std::shared_ptr<RTDESession> session,
+                                           std::string hostname,
+                                           std::string heartbeat_ip,
+                                           std::string heartbeat_port,
+                                           double frequency,
+                                           uint16_t flags,
+                                           int ur_cap_port,
+                                           int rt_priority)
+    : session_(std::move(session)),
+      hostname_(std::move(hostname)),
       heartbeat_ip_(std::move(heartbeat_ip)),
       heartbeat_port_(std::move(heartbeat_port)),
       frequency_(frequency),
@@ -108,13 +182,21 @@ RTDEControlInterface::RTDEControlInterface(std::string hostname,
       }
     }
   }
-  no_bytes_avail_cnt_ = 0;
   port_ = 30004;
   custom_script_running_ = false;
-  rtde_ = std::make_shared<RTDE>(hostname_, port_, verbose_);
-  rtde_->connect();
-  rtde_->negotiateProtocolVersion();
-  versions_ = rtde_->getControllerVersion();
+  if (session_ != nullptr)
+  {
+    // Share the connection of the session, which has already negotiated the protocol and fetched the version
+    rtde_ = session_->rtde();
+    versions_ = session_->getControllerVersion();
+  }
+  else
+  {
+    rtde_ = std::make_shared<RTDE>(hostname_, port_, verbose_);
+    rtde_->connect();
+    rtde_->negotiateProtocolVersion();
+    versions_ = rtde_->getControllerVersion();
+  }
 
   if (frequency_ < 0)  // frequency not specified, set it based on controller version.
   {
@@ -150,41 +232,60 @@ RTDEControlInterface::RTDEControlInterface(std::string hostname,
   // Setup default recipes
   setupRecipes(frequency_);
 
-  // Init Robot state
-  robot_state_ = std::make_shared<RobotState>(state_names_);
-
-  // Wait until RTDE data synchronization has started
-  if (verbose_)
-    std::cout << "Waiting for RTDE data synchronization to start..." << std::endl;
   std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+  if (session_ != nullptr)
+  {
+    // The session has started data synchronization with the recipes and receives the robot state
+    robot_state_ = session_->robot_state();
+  }
+  else
+  {
+    // Init Robot state
+    robot_state_ = std::make_shared<RobotState>(state_names_);
 
-  // Start RTDE data synchronization
-  rtde_->sendStart();
+    // Wait until RTDE data synchronization has started
+    if (verbose_)
+      std::cout << "Waiting for RTDE data synchronization to start..." << std::endl;
 
-  while (!rtde_->isStarted())
-  {
-    // Wait until RTDE data synchronization has started or timeout
-    std::chrono::high_resolution_clock::time_point current_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
-    if (duration > RTDE_START_SYNCHRONIZATION_TIMEOUT)
+    // Start RTDE data synchronization
+    rtde_->sendStart();
+
+    while (!rtde_->isStarted())
     {
-      break;
+      // Wait until RTDE data synchronization has started or timeout
+      std::chrono::high_resolution_clock::time_point current_time = std::chrono::high_resolution_clock::now();
+      auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+      if (duration > RTDE_START_SYNCHRONIZATION_TIMEOUT)
+      {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
     }
-    std::this_thread::sleep_for(std::chrono::microseconds(500));
-  }
 
-  if (!rtde_->isStarted())
-    throw std::logic_error("Failed to start RTDE data synchronization, before timeout");
+    if (!rtde_->isStarted())
+      throw std::logic_error("Failed to start RTDE data synchronization, before timeout");
 
-  // Start executing receiveCallback
-  th_ = std::make_shared<boost::thread>(boost::bind(&RTDEControlInterface::receiveCallback, this));
+    // Start executing receiveCallback
+    th_ = std::make_shared<boost::thread>(boost::bind(&RTDEControlInterface::receiveCallback, this));
 
-  // Wait until the first robot state has been received
-  while (!robot_state_->getFirstStateReceived())
-  {
-    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    // Wait until the first robot state has been received
+    while (!robot_state_->getFirstStateReceived())
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
   }
 
+  // A session that has not been started yet receives no robot state, the script is started from RTDESession::start()
+  if (session_ != nullptr && !session_->isStarted())
+    session_->addStartCallback(this, [this] { startControlScript(); });
+  else
+    startControlScript();
+}
+
+void RTDEControlInterface::startControlScript()
+{
+  std::chrono::high_resolution_clock::time_point start_time;
+
   // Clear command register
   sendClearCommand();
 
@@ -296,9 +397,57 @@ RTDEControlInterface::RTDEControlInterface(std::string hostname,
 
 RTDEControlInterface::~RTDEControlInterface()
 {
+  if (session_ != nullptr)
+    session_->removeStartCallbacks(this);
+  stopExecutor();
   disconnect();
 }
 
+void RTDEControlInterface::enqueueCommand(std::function<void()> command)
+{
+  std::lock_guard<std::mutex> lock(executor_mutex_);
+  if (stop_executor_)
+    throw std::logic_error("RTDEControlInterface: The command executor has been stopped");
+  executor_queue_.push_back(std::move(command));
+  if (executor_thread_ == nullptr)
+    executor_thread_ = std::make_shared<boost::thread>(boost::bind(&RTDEControlInterface::executorCallback, this));
+  executor_cv_.notify_one();
+}
+
+void RTDEControlInterface::executorCallback()
+{
+  std::unique_lock<std::mutex> lock(executor_mutex_);
+  while (true)
+  {
+    executor_cv_.wait(lock, [this] { return stop_executor_ || !executor_queue_.empty(); });
+    if (stop_executor_)
+      return;
+
+    std::function<void()> command = std::move(executor_queue_.front());
+    executor_queue_.pop_front();
+    lock.unlock();
+    // The packaged task stores the result or exception of the command in its future
+    command();
+    lock.lock();
+  }
+}
+
+void RTDEControlInterface::stopExecutor()
+{
+  std::shared_ptr<boost::thread> executor_thread;
+  {
+    std::lock_guard<std::mutex> lock(executor_mutex_);
+    stop_executor_ = true;
+    executor_thread.swap(executor_thread_);
+    executor_cv_.notify_one();
+  }
+  // A running command completes before the thread exits, pending commands are dropped
+  if (executor_thread != nullptr)
+    executor_thread->join();
+  std::lock_guard<std::mutex> lock(executor_mutex_);
+  executor_queue_.clear();
+}
+
 int RTDEControlInterface::getAsyncOperationProgress()
 {
   auto AsyncStatus = getAsyncOperationProgressEx();
@@ -314,40 +463,50 @@ int RTDEControlInterface::getAsyncOperationProgress()
 
 AsyncOperationStatus RTDEControlInterface::getAsyncOperationProgressEx()
 {
-  std::string output_int_register_key = "output_int_register_" + std::to_string(2 + register_offset_);
+  RobotState::Field output_int_register = RobotState::outputIntRegister(2 + register_offset_);
   int32_t output_int_register_val;
-  if (robot_state_->getStateData(output_int_register_key, output_int_register_val))
+  if (robot_state_->getStateData(output_int_register, output_int_register_val))
     return AsyncOperationStatus(output_int_register_val);
   else
-    throw std::runtime_error("unable to get state data for specified key: " + output_int_register_key);
+    throw std::runtime_error(std::string("unable to get state data for specified key: ") +
+                             RobotState::fieldName(output_int_register));
 }
 
 void RTDEControlInterface::waitForProgramRunning()
 {
-  int ms_count = 0;
-  static const int sleep_ms = 10;
-
+  // The program state is part of the robot state, check it once per RTDE cycle
+  auto start_time = std::chrono::steady_clock::now();
+  std::uint64_t sequence_number = robot_state_->getSequenceNumber();
   while (!isProgramRunning())
   {
-    // Wait for program to be running
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
-    ms_count += sleep_ms;
-
-    if (ms_count > 5000)
+    if (std::chrono::steady_clock::now() - start_time > std::chrono::seconds(5))
     {
       throw std::logic_error("ur_rtde: Failed to start control script, before timeout of 5 seconds");
     }
+    waitForStateUpdate(sequence_number);
   }
 }
 
+void RTDEControlInterface::waitForStateUpdate(std::uint64_t &sequence_number)
+{
+  // Woken by the receive thread as soon as a newer robot state is published, so a wait on the control script ends in
+  // the cycle its registers change instead of after a fixed sleep
+  robot_state_->waitForState(sequence_number, std::chrono::milliseconds(RECEIVE_WAIT_TIMEOUT_MS));
+  sequence_number = robot_state_->getSequenceNumber();
+}
+
 void RTDEControlInterface::disconnect()
 {
   // Stop the receive callback function
   stop_thread_ = true;
-  th_->interrupt();
-  th_->join();
+  if (th_ != nullptr)
+  {
+    th_->interrupt();
+    th_->join();
+  }
 
-  if (rtde_ != nullptr)
+  // A shared connection is closed by its session
+  if (rtde_ != nullptr && session_ == nullptr)
   {
     if (rtde_->isConnected())
       rtde_->disconnect();
@@ -379,6 +538,9 @@ bool RTDEControlInterface::isConnected()
 
 bool RTDEControlInterface::reconnect()
 {
+  // A stream is validated again on the new connection
+  streaming_ = false;
+  stream_status_sequence_ = UINT64_MAX;
   db_client_->connect();
   PolyScopeVersion polyscope_version(db_client_->polyscopeVersion());
   if (polyscope_version.major == 5 && polyscope_version.minor > 5)
@@ -386,15 +548,24 @@ bool RTDEControlInterface::reconnect()
     serial_number_ = db_client_->getSerialNumber();
   }
   script_client_->connect();
-  no_bytes_avail_cnt_ = 0;
-  rtde_->connect();
-  rtde_->negotiateProtocolVersion();
-  versions_ = rtde_->getControllerVersion();
+  if (session_ != nullptr)
+  {
+    // Re-establish the shared connection with the recipes registered when the interfaces were attached
+    session_->reconnect();
+    versions_ = session_->getControllerVersion();
+    frequency_ = session_->getFrequency();
+  }
+  else
+  {
+    rtde_->connect();
+    rtde_->negotiateProtocolVersion();
+    versions_ = rtde_->getControllerVersion();
 
-  frequency_ = 125;
-  // If e-Series Robot set frequency to 500Hz
-  if (versions_.major > CB3_MAJOR_VERSION)
-    frequency_ = 500;
+    frequency_ = 125;
+    // If e-Series Robot set frequency to 500Hz
+    if (versions_.major > CB3_MAJOR_VERSION)
+      frequency_ = 500;
+  }
 
   // Set delta time to be used by receiveCallback
   delta_time_ = 1 / frequency_;
@@ -413,42 +584,47 @@ bool RTDEControlInterface::reconnect()
     register_offset_ = 0;
   }
 
-  // Setup default recipes
-  setupRecipes(frequency_);
+  std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+  if (session_ == nullptr)
+  {
+    // Setup default recipes
+    setupRecipes(frequency_);
 
-  // Init Robot state
-  robot_state_ = std::make_shared<RobotState>(state_names_);
+    // Init Robot state
+    robot_state_ = std::make_shared<RobotState>(state_names_);
+    // The new robot state counts its packages from zero
+    last_state_sequence_number_ = 0;
 
-  // Wait until RTDE data synchronization has started.
-  if (verbose_)
-    std::cout << "Waiting for RTDE data synchronization to start..." << std::endl;
-  std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+    // Wait until RTDE data synchronization has started.
+    if (verbose_)
+      std::cout << "Waiting for RTDE data synchronization to start..." << std::endl;
 
-  // Start RTDE data synchronization
-  rtde_->sendStart();
+    // Start RTDE data synchronization
+    rtde_->sendStart();
 
-  while (!rtde_->isStarted())
-  {
-    // Wait until RTDE data synchronization has started or timeout
-    std::chrono::high_resolution_clock::time_point current_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
-    if (duration > RTDE_START_SYNCHRONIZATION_TIMEOUT)
+    while (!rtde_->isStarted())
     {
-      break;
+      // Wait until RTDE data synchronization has started or timeout
+      std::chrono::high_resolution_clock::time_point current_time = std::chrono::high_resolution_clock::now();
+      auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+      if (duration > RTDE_START_SYNCHRONIZATION_TIMEOUT)
+      {
+        break;
+      }
     }
-  }
 
-  if (!rtde_->isStarted())
-    throw std::logic_error("Failed to start RTDE data synchronization, before timeout");
+    if (!rtde_->isStarted())
+      throw std::logic_error("Failed to start RTDE data synchronization, before timeout");
 
-  // Start executing receiveCallback
-  stop_thread_ = false;
-  th_ = std::make_shared<boost::thread>(boost::bind(&RTDEControlInterface::receiveCallback, this));
+    // Start executing receiveCallback
+    stop_thread_ = false;
+    th_ = std::make_shared<boost::thread>(boost::bind(&RTDEControlInterface::receiveCallback, this));
 
-  // Wait until the first robot state has been received
-  while (!robot_state_->getFirstStateReceived())
-  {
-    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    // Wait until the first robot state has been received
+    while (!robot_state_->getFirstStateReceived())
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
   }
 
   // Clear command register
@@ -602,20 +778,19 @@ bool RTDEControlInterface::setupRecipes(const double &frequency)
     }
   }
 
-  rtde_->sendOutputSetup(state_names_, frequency);
-
   // Setup input recipes
+  std::vector<std::vector<std::string>> input_recipes;
   // Recipe 1
   std::vector<std::string> async_setp_input = {inIntReg(0),    inDoubleReg(0), inDoubleReg(1), inDoubleReg(2),
                                                inDoubleReg(3), inDoubleReg(4), inDoubleReg(5), inDoubleReg(6),
                                                inDoubleReg(7), inIntReg(1)};
-  rtde_->sendInputSetup(async_setp_input);
+  input_recipes.push_back(async_setp_input);
 
   // Recipe 2
   std::vector<std::string> servoj_input = {inIntReg(0),    inDoubleReg(0), inDoubleReg(1), inDoubleReg(2),
                                            inDoubleReg(3), inDoubleReg(4), inDoubleReg(5), inDoubleReg(6),
                                            inDoubleReg(7), inDoubleReg(8), inDoubleReg(9), inDoubleReg(10)};
-  rtde_->sendInputSetup(servoj_input);
+  input_recipes.push_back(servoj_input);
 
   // Recipe 3
   std::vector<std::string> force_mode_input = {
@@ -624,103 +799,112 @@ bool RTDEControlInterface::setupRecipes(const double &frequency)
       inDoubleReg(4),  inDoubleReg(5),  inDoubleReg(6),  inDoubleReg(7),  inDoubleReg(8),  inDoubleReg(9),
       inDoubleReg(10), inDoubleReg(11), inDoubleReg(12), inDoubleReg(13), inDoubleReg(14), inDoubleReg(15),
       inDoubleReg(16), inDoubleReg(17)};
-  rtde_->sendInputSetup(force_mode_input);
+  input_recipes.push_back(force_mode_input);
 
   // Recipe 4
   std::vector<std::string> no_cmd_input = {inIntReg(0)};
-  rtde_->sendInputSetup(no_cmd_input);
+  input_recipes.push_back(no_cmd_input);
 
   // Recipe 5
   std::vector<std::string> servoc_input = {inIntReg(0),    inDoubleReg(0), inDoubleReg(1), inDoubleReg(2),
                                            inDoubleReg(3), inDoubleReg(4), inDoubleReg(5), inDoubleReg(6),
                                            inDoubleReg(7), inDoubleReg(8)};
-  rtde_->sendInputSetup(servoc_input);
+  input_recipes.push_back(servoc_input);
 
   // Recipe 6
   std::vector<std::string> wrench_input = {inIntReg(0),    inDoubleReg(0), inDoubleReg(1), inDoubleReg(2),
                                            inDoubleReg(3), inDoubleReg(4), inDoubleReg(5)};
-  rtde_->sendInputSetup(wrench_input);
+  input_recipes.push_back(wrench_input);
 
   // Recipe 7
   std::vector<std::string> set_payload_input = {inIntReg(0), inDoubleReg(0), inDoubleReg(1), inDoubleReg(2),
                                                 inDoubleReg(3)};
-  rtde_->sendInputSetup(set_payload_input);
+  input_recipes.push_back(set_payload_input);
 
   // Recipe 8
   std::vector<std::string> force_mode_parameters_input = {inIntReg(0), inDoubleReg(0)};
-  rtde_->sendInputSetup(force_mode_parameters_input);
+  input_recipes.push_back(force_mode_parameters_input);
 
   // Recipe 9
   std::vector<std::string> get_actual_joint_positions_history_input = {inIntReg(0), inIntReg(1)};
-  rtde_->sendInputSetup(get_actual_joint_positions_history_input);
+  input_recipes.push_back(get_actual_joint_positions_history_input);
 
   // Recipe 10
   std::vector<std::string> get_inverse_kin_input = {inIntReg(0),     inDoubleReg(0),  inDoubleReg(1), inDoubleReg(2),
                                                     inDoubleReg(3),  inDoubleReg(4),  inDoubleReg(5), inDoubleReg(6),
                                                     inDoubleReg(7),  inDoubleReg(8),  inDoubleReg(9), inDoubleReg(10),
                                                     inDoubleReg(11), inDoubleReg(12), inDoubleReg(13)};
-  rtde_->sendInputSetup(get_inverse_kin_input);
+  input_recipes.push_back(get_inverse_kin_input);
 
   // Recipe 11
   std::vector<std::string> watchdog_input = {inIntReg(0)};
-  rtde_->sendInputSetup(watchdog_input);
+  input_recipes.push_back(watchdog_input);
 
   // Recipe 12
   std::vector<std::string> pose_trans_input = {
       inIntReg(0),    inDoubleReg(0), inDoubleReg(1), inDoubleReg(2), inDoubleReg(3),  inDoubleReg(4), inDoubleReg(5),
       inDoubleReg(6), inDoubleReg(7), inDoubleReg(8), inDoubleReg(9), inDoubleReg(10), inDoubleReg(11)};
-  rtde_->sendInputSetup(pose_trans_input);
+  input_recipes.push_back(pose_trans_input);
 
   // Recipe 13
   std::vector<std::string> setp_input = {inIntReg(0),    inDoubleReg(0), inDoubleReg(1), inDoubleReg(2), inDoubleReg(3),
                                          inDoubleReg(4), inDoubleReg(5), inDoubleReg(6), inDoubleReg(7)};
-  rtde_->sendInputSetup(setp_input);
+  input_recipes.push_back(setp_input);
 
   // Recipe 14
   std::vector<std::string> jog_input = {inIntReg(0),     inDoubleReg(0),  inDoubleReg(1), inDoubleReg(2),
                                         inDoubleReg(3),  inDoubleReg(4),  inDoubleReg(5), inDoubleReg(6),
                                         inDoubleReg(7),  inDoubleReg(8),  inDoubleReg(9), inDoubleReg(10),
                                         inDoubleReg(11), inDoubleReg(12), inDoubleReg(13)};
-  rtde_->sendInputSetup(jog_input);
+  input_recipes.push_back(jog_input);
 
   // Recipe 15
   std::vector<std::string> async_path_input = {inIntReg(0), inIntReg(1)};
-  rtde_->sendInputSetup(async_path_input);
+  input_recipes.push_back(async_path_input);
 
   // Recipe 16
   std::vector<std::string> move_until_contact_input = {inIntReg(0),     inDoubleReg(0), inDoubleReg(1), inDoubleReg(2),
                                                        inDoubleReg(3),  inDoubleReg(4), inDoubleReg(5), inDoubleReg(6),
                                                        inDoubleReg(7),  inDoubleReg(8), inDoubleReg(9), inDoubleReg(10),
                                                        inDoubleReg(11), inDoubleReg(12)};
-  rtde_->sendInputSetup(move_until_contact_input);
+  input_recipes.push_back(move_until_contact_input);
 
   // Recipe 17
   std::vector<std::string> freedrive_mode_input = {
       inIntReg(0),    inIntReg(1),    inIntReg(2),    inIntReg(3),    inIntReg(4),    inIntReg(5),   inIntReg(6),
       inDoubleReg(0), inDoubleReg(1), inDoubleReg(2), inDoubleReg(3), inDoubleReg(4), inDoubleReg(5)};
-  rtde_->sendInputSetup(freedrive_mode_input);
+  input_recipes.push_back(freedrive_mode_input);
 
   // Recipe 18
   std::vector<std::string> ft_rtde_input_enable = {inIntReg(0),    inIntReg(1),    inDoubleReg(0),
                                                    inDoubleReg(1), inDoubleReg(2), inDoubleReg(3),
                                                    inDoubleReg(4), inDoubleReg(5), inDoubleReg(6)};
-  rtde_->sendInputSetup(ft_rtde_input_enable);
+  input_recipes.push_back(ft_rtde_input_enable);
 
   // Recipe 19 - STOPL and STOPJ
   std::vector<std::string> stopl_stopj_input = {inIntReg(0), inDoubleReg(0), inIntReg(1)};
-  rtde_->sendInputSetup(stopl_stopj_input);
+  input_recipes.push_back(stopl_stopj_input);
 
   // Recipe 20
   std::vector<std::string> set_target_payload_input = {inIntReg(0),    inDoubleReg(0), inDoubleReg(1), inDoubleReg(2),
                                            inDoubleReg(3), inDoubleReg(4), inDoubleReg(5), inDoubleReg(6),
                                            inDoubleReg(7), inDoubleReg(8), inDoubleReg(9)};
-  rtde_->sendInputSetup(set_target_payload_input);
+  input_recipes.push_back(set_target_payload_input);
 
   // Recipe 21 - external_force_torque should be last because its optional depending on flags
   if (!no_ext_ft_)
   {
     std::vector<std::string> external_ft_input = {inIntReg(0), "external_force_torque"};
-    rtde_->sendInputSetup(external_ft_input);
+    input_recipes.push_back(external_ft_input);
+  }
+
+  if (session_ != nullptr)
+  {
+    recipe_offset_ = session_->subscribe(state_names_, input_recipes);
+  }
+  else
+  {
+    rtde_->sendRecipeSetup(state_names_, frequency, input_recipes);
   }
 
   return true;
@@ -740,44 +924,19 @@ void RTDEControlInterface::receiveCallback()
     // Receive and update the robot state
     try
     {
-      if (rtde_->isDataAvailable())
-      {
-        no_bytes_avail_cnt_ = 0;
-        boost::system::error_code ec = rtde_->receiveData(robot_state_);
-        if (ec)
-        {
-          if (ec == boost::asio::error::eof)
-          {
-            std::cerr << "RTDEControlInterface: Robot closed the connection!" << std::endl;
-          }
-          throw std::system_error(ec);
-        }
-      }
-      else
+      // Block until the next package arrives. If none arrives within a few controller cycles, the receive below
+      // falls back to the regular socket timeout, which detects de-synchronization.
+      rtde_->waitForData(RECEIVE_WAIT_TIMEOUT_MS);
+      boost::system::error_code ec = rtde_->receiveData(robot_state_);
+      if (ec)
       {
-        // Register that data was not available in this cycle
-        no_bytes_avail_cnt_++;
-        // If at least 2ms has passed without data available, try to read data again to detect de-synchronization.
-        if (no_bytes_avail_cnt_ > 20)
+        if (ec == boost::asio::error::eof)
         {
-          boost::system::error_code ec = rtde_->receiveData(robot_state_);
-          if (ec)
-          {
-            if (ec == boost::asio::error::eof)
-            {
-              std::cerr << "RTDEControlInterface: Robot closed the connection!" << std::endl;
-            }
-            throw std::system_error(ec);
-          }
-          no_bytes_avail_cnt_ = 0;
+          std::cerr << "RTDEControlInterface: Robot closed the connection!" << std::endl;
         }
-
-#if defined(__linux__) || defined(__APPLE__)
-        // Data not available on socket yet, yield to other threads and sleep before trying to receive data again.
-        std::this_thread::yield();
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-#endif
+        throw std::system_error(ec);
       }
+      updateStreamStatus();
     }
     catch (std::exception &e)
     {
@@ -860,6 +1019,29 @@ std::chrono::steady_clock::time_point RTDEControlInterface::initPeriod()
   return std::chrono::steady_clock::now();
 }
 
+bool RTDEControlInterface::waitForNextState(std::chrono::microseconds timeout)
+{
+  if (!robot_state_->waitForState(last_state_sequence_number_, timeout))
+    return false;
+  last_state_sequence_number_ = robot_state_->getSequenceNumber();
+  return true;
+}
+
+std::uint64_t RTDEControlInterface::getStateSequenceNumber()
+{
+  return robot_state_->getSequenceNumber();
+}
+
+bool RTDEControlInterface::waitForState(std::uint64_t sequence_number, std::chrono::microseconds timeout)
+{
+  return robot_state_->waitForState(sequence_number, timeout);
+}
+
+double RTDEControlInterface::getFrequency() const
+{
+  return frequency_;
+}
+
 void RTDEControlInterface::waitPeriod(const std::chrono::steady_clock::time_point &t_cycle_start)
 {
   RTDEUtility::waitPeriod(t_cycle_start, delta_time_);
@@ -867,6 +1049,7 @@ void RTDEControlInterface::waitPeriod(const std::chrono::steady_clock::time_poin
 
 bool RTDEControlInterface::reuploadScript()
 {
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (isProgramRunning())
   {
     if (verbose_)
@@ -915,6 +1098,8 @@ bool RTDEControlInterface::sendCustomScriptFunction(const std::string &function_
 
 bool RTDEControlInterface::sendCustomScript(const std::string &script)
 {
+  // Replacing the control script must not interleave with commands of other threads
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   custom_script_running_ = true;
   // First stop the running RTDE control script
   stopScript();
@@ -924,6 +1109,7 @@ bool RTDEControlInterface::sendCustomScript(const std::string &script)
   // Send custom script function
   script_client_->sendScriptCommand(script);
 
+  std::uint64_t sequence_number = robot_state_->getSequenceNumber();
   while (getControlScriptState() != UR_CONTROLLER_DONE_WITH_CMD)
   {
     // Wait until the controller is done with command
@@ -931,8 +1117,7 @@ bool RTDEControlInterface::sendCustomScript(const std::string &script)
     auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
     if (duration > UR_PATH_EXECUTION_TIMEOUT)
       return false;
-    // Sleep to avoid high CPU load
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    waitForStateUpdate(sequence_number);
   }
 
   sendClearCommand();
@@ -948,6 +1133,7 @@ bool RTDEControlInterface::sendCustomScript(const std::string &script)
 
 bool RTDEControlInterface::sendCustomScriptFile(const std::string &file_path)
 {
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   custom_script_running_ = true;
   // First stop the running RTDE control script
   stopScript();
@@ -957,6 +1143,7 @@ bool RTDEControlInterface::sendCustomScriptFile(const std::string &file_path)
   // Send custom script file
   script_client_->sendScript(file_path);
 
+  std::uint64_t sequence_number = robot_state_->getSequenceNumber();
   while (getControlScriptState() != UR_CONTROLLER_DONE_WITH_CMD)
   {
     // Wait until the controller is done with command
@@ -964,8 +1151,7 @@ bool RTDEControlInterface::sendCustomScriptFile(const std::string &file_path)
     auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
     if (duration > UR_PATH_EXECUTION_TIMEOUT)
       return false;
-    // Sleep to avoid high CPU load
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    waitForStateUpdate(sequence_number);
   }
 
   sendClearCommand();
@@ -1036,6 +1222,7 @@ bool RTDEControlInterface::moveJ(const std::vector<std::vector<double>> &path, b
   if (verbose_)
     std::cout << "PathScript: ----------------------------------------------\n" << PathScript << "\n\n" << std::endl;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   custom_script_running_ = true;
   // stop the running RTDE control script
   stopScript();
@@ -1043,10 +1230,11 @@ bool RTDEControlInterface::moveJ(const std::vector<std::vector<double>> &path, b
   script_client_->setScriptInjection(move_path_inject_id, PathScript);
   // Re-upload RTDE script to the UR Controller
   script_client_->sendScript();
+  std::uint64_t sequence_number = robot_state_->getSequenceNumber();
   while (!isProgramRunning())
   {
     // Wait for program to be running
-    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    waitForStateUpdate(sequence_number);
   }
 
   custom_script_running_ = false;
@@ -1066,6 +1254,7 @@ bool RTDEControlInterface::movePath(const Path &path, bool async)
   if (verbose_)
     std::cout << "path_script: ----------------------------------------------\n" << path_script << "\n\n" << std::endl;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   custom_script_running_ = true;
   // stop the running RTDE control script
   stopScript();
@@ -1073,10 +1262,11 @@ bool RTDEControlInterface::movePath(const Path &path, bool async)
   script_client_->setScriptInjection(move_path_inject_id, path_script);
   // Re-upload RTDE script to the UR Controller
   script_client_->sendScript();
+  std::uint64_t sequence_number = robot_state_->getSequenceNumber();
   while (!isProgramRunning())
   {
     // Wait for program to be running
-    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    waitForStateUpdate(sequence_number);
   }
 
   custom_script_running_ = false;
@@ -1089,6 +1279,83 @@ bool RTDEControlInterface::movePath(const Path &path, bool async)
   return sendCommand(robot_cmd);
 }
 
+bool RTDEControlInterface::appendPath(const Path &path)
+{
+  // Validate the whole path first, so an invalid waypoint does not leave a part of the path queued
+  const auto &waypoints = path.waypoints();
+  for (const auto &entry : waypoints)
+    verifyPathEntry(entry);
+
+  std::size_t index = 0;
+  return streamPath([&](PathEntry &entry) {
+    if (index == waypoints.size())
+      return false;
+    entry = waypoints[index++];
+    return true;
+  });
+}
+
+bool RTDEControlInterface::streamPath(const std::function<bool(PathEntry &entry)> &next_waypoint)
+{
+  PathEntry entry(PathEntry::MoveJ, PathEntry::PositionJoints, std::vector<double>());
+  RTDE::RobotCommand robot_cmd;
+  robot_cmd.type_ = RTDE::RobotCommand::Type::PATH_APPEND;
+  robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_3;
+  robot_cmd.val_.reserve(9 * PATH_APPEND_CHUNK_SIZE);
+  bool source_empty = false;
+  while (true)
+  {
+    // Fill the chunk, it keeps the waypoints the script has not accepted yet
+    while (!source_empty && robot_cmd.path_entry_kinds_.size() < PATH_APPEND_CHUNK_SIZE)
+    {
+      if (!next_waypoint(entry))
+      {
+        source_empty = true;
+        break;
+      }
+      verifyPathEntry(entry);
+      // Decoded by exec_path_stream() in the control script
+      robot_cmd.path_entry_kinds_.push_back(2 * entry.move_type_ + entry.pos_type_);
+      robot_cmd.val_.insert(robot_cmd.val_.end(), entry.param_.begin(), entry.param_.end());
+    }
+    std::size_t count = robot_cmd.path_entry_kinds_.size();
+    if (count == 0)
+      return true;
+
+    // The recipe always carries the double registers of a full chunk
+    robot_cmd.val_.resize(9 * PATH_APPEND_CHUNK_SIZE, 0.0);
+    std::int32_t progress;
+    std::size_t accepted;
+    {
+      // Only held per chunk, so the stream can be stopped from another thread while this one waits
+      std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
+      progress = getOutputIntReg(2);
+      if (!sendCommand(robot_cmd))
+        return false;
+      accepted = static_cast<std::size_t>(std::max(getOutputIntReg(1), 0));
+    }
+    robot_cmd.path_entry_kinds_.erase(robot_cmd.path_entry_kinds_.begin(),
+                                      robot_cmd.path_entry_kinds_.begin() + std::min(accepted, count));
+    robot_cmd.val_.erase(robot_cmd.val_.begin(), robot_cmd.val_.begin() + 9 * std::min(accepted, count));
+
+    if (accepted < count)
+    {
+      // The buffer of the stream is full. The script writes the progress register when it takes the next waypoint
+      // out of the buffer, so wait for that instead of polling with commands.
+      std::uint64_t sequence_number = robot_state_->getSequenceNumber();
+      while (getOutputIntReg(2) == progress)
+      {
+        if (!isProgramRunning())
+          return false;
+        waitForStateUpdate(sequence_number);
+      }
+      // With a full buffer the stream cannot have run empty, it has been stopped
+      if (!getAsyncOperationProgressEx().isAsyncOperationRunning())
+        return false;
+    }
+  }
+}
+
 bool RTDEControlInterface::moveJ(const std::vector<double> &q, double speed, double acceleration, bool async)
 {
   verifyValueIsWithin(speed, UR_JOINT_VELOCITY_MIN, UR_JOINT_VELOCITY_MAX);
@@ -1133,6 +1400,7 @@ bool RTDEControlInterface::moveL(const std::vector<std::vector<double>> &path, b
   if (verbose_)
     std::cout << "Path: ----------------------------------------------\n" << PathScript << "\n\n" << std::endl;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   custom_script_running_ = true;
   // stop the running RTDE control script
   stopScript();
@@ -1140,10 +1408,11 @@ bool RTDEControlInterface::moveL(const std::vector<std::vector<double>> &path, b
   script_client_->setScriptInjection(move_path_inject_id, PathScript);
   // Re-upload RTDE script to the UR Controller
   script_client_->sendScript();
+  std::uint64_t sequence_number = robot_state_->getSequenceNumber();
   while (!isProgramRunning())
   {
     // Wait for program to be running
-    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    waitForStateUpdate(sequence_number);
   }
 
   custom_script_running_ = false;
@@ -1225,18 +1494,23 @@ bool RTDEControlInterface::moveL_FK(const std::vector<double> &q, double speed,
 bool RTDEControlInterface::forceMode(const std::vector<double> &task_frame, const std::vector<int> &selection_vector,
                                      const std::vector<double> &wrench, int type, const std::vector<double> &limits)
 {
-  RTDE::RobotCommand robot_cmd;
-  robot_cmd.type_ = RTDE::RobotCommand::Type::FORCE_MODE;
-  robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_3;
-  robot_cmd.val_ = task_frame;
-  for (const auto &val : wrench)
-    robot_cmd.val_.push_back(val);
-
-  for (const auto &val : limits)
-    robot_cmd.val_.push_back(val);
+  verifyVectorSize(task_frame, 6, "task_frame");
+  verifyVectorSize(selection_vector, 6, "selection_vector");
+  verifyVectorSize(wrench, 6, "wrench");
+  verifyVectorSize(limits, 6, "limits");
+  return sendForceMode(task_frame.data(), selection_vector.data(), wrench.data(), type, limits.data());
+}
 
-  robot_cmd.selection_vector_ = selection_vector;
-  robot_cmd.force_mode_type_ = type;
+bool RTDEControlInterface::sendForceMode(const double *task_frame, const int *selection_vector, const double *wrench,
+                                         int type, const double *limits)
+{
+  RTDE::RealtimeCommand robot_cmd(RTDE::RobotCommand::Type::FORCE_MODE, RTDE::RobotCommand::Recipe::RECIPE_3);
+  robot_cmd.addInt(type);
+  for (std::size_t i = 0; i < 6; i++)
+    robot_cmd.addInt(selection_vector[i]);
+  robot_cmd.addDoubles(task_frame, 6);
+  robot_cmd.addDoubles(wrench, 6);
+  robot_cmd.addDoubles(limits, 6);
   return sendCommand(robot_cmd);
 }
 
@@ -1258,67 +1532,60 @@ bool RTDEControlInterface::zeroFtSensor()
 
 bool RTDEControlInterface::speedJ(const std::vector<double> &qd, double acceleration, double time)
 {
-  verifyValueIsWithin(acceleration, UR_JOINT_ACCELERATION_MIN, UR_JOINT_ACCELERATION_MAX);
-
-  RTDE::RobotCommand robot_cmd;
-  robot_cmd.type_ = RTDE::RobotCommand::Type::SPEEDJ;
-  robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_13;
-  robot_cmd.val_ = qd;
-  robot_cmd.val_.push_back(acceleration);
-  robot_cmd.val_.push_back(time);
-  return sendCommand(robot_cmd);
+  verifyVectorSize(qd, 6, "qd");
+  return sendSpeed(RTDE::RobotCommand::Type::SPEEDJ, qd.data(), acceleration, time);
 }
 
 bool RTDEControlInterface::speedL(const std::vector<double> &xd, double acceleration, double time)
 {
-  verifyValueIsWithin(acceleration, UR_TOOL_ACCELERATION_MIN, UR_TOOL_ACCELERATION_MAX);
+  verifyVectorSize(xd, 6, "xd");
+  return sendSpeed(RTDE::RobotCommand::Type::SPEEDL, xd.data(), acceleration, time);
+}
 
-  RTDE::RobotCommand robot_cmd;
-  robot_cmd.type_ = RTDE::RobotCommand::Type::SPEEDL;
-  robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_13;
-  robot_cmd.val_ = xd;
-  robot_cmd.val_.push_back(acceleration);
-  robot_cmd.val_.push_back(time);
+bool RTDEControlInterface::sendSpeed(RTDE::RobotCommand::Type type, const double *speed, double acceleration,
+                                     double time)
+{
+  if (type == RTDE::RobotCommand::Type::SPEEDJ)
+    verifyValueIsWithin(acceleration, UR_JOINT_ACCELERATION_MIN, UR_JOINT_ACCELERATION_MAX);
+  else
+    verifyValueIsWithin(acceleration, UR_TOOL_ACCELERATION_MIN, UR_TOOL_ACCELERATION_MAX);
+
+  RTDE::RealtimeCommand robot_cmd(type, RTDE::RobotCommand::Recipe::RECIPE_13);
+  robot_cmd.addDoubles(speed, 6);
+  robot_cmd.addDouble(acceleration);
+  robot_cmd.addDouble(time);
   return sendCommand(robot_cmd);
 }
 
 bool RTDEControlInterface::servoJ(const std::vector<double> &q, double speed, double acceleration, double time,
                                   double lookahead_time, double gain)
 {
-  verifyValueIsWithin(speed, UR_JOINT_VELOCITY_MIN, UR_JOINT_VELOCITY_MAX);
-  verifyValueIsWithin(acceleration, UR_JOINT_ACCELERATION_MIN, UR_JOINT_ACCELERATION_MAX);
-  verifyValueIsWithin(lookahead_time, UR_SERVO_LOOKAHEAD_TIME_MIN, UR_SERVO_LOOKAHEAD_TIME_MAX);
-  verifyValueIsWithin(gain, UR_SERVO_GAIN_MIN, UR_SERVO_GAIN_MAX);
-
-  RTDE::RobotCommand robot_cmd;
-  robot_cmd.type_ = RTDE::RobotCommand::Type::SERVOJ;
-  robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_2;
-  robot_cmd.val_ = q;
-  robot_cmd.val_.push_back(speed);
-  robot_cmd.val_.push_back(acceleration);
-  robot_cmd.val_.push_back(time);
-  robot_cmd.val_.push_back(lookahead_time);
-  robot_cmd.val_.push_back(gain);
-  return sendCommand(robot_cmd);
+  verifyVectorSize(q, 6, "q");
+  return sendServo(RTDE::RobotCommand::Type::SERVOJ, q.data(), speed, acceleration, time, lookahead_time, gain);
 }
 
 bool RTDEControlInterface::servoL(const std::vector<double> &pose, double speed, double acceleration, double time,
                                   double lookahead_time, double gain)
+{
+  verifyVectorSize(pose, 6, "pose");
+  return sendServo(RTDE::RobotCommand::Type::SERVOL, pose.data(), speed, acceleration, time, lookahead_time, gain);
+}
+
+bool RTDEControlInterface::sendServo(RTDE::RobotCommand::Type type, const double *target, double speed,
+                                     double acceleration, double time, double lookahead_time, double gain)
 {
   verifyValueIsWithin(speed, UR_JOINT_VELOCITY_MIN, UR_JOINT_VELOCITY_MAX);
   verifyValueIsWithin(acceleration, UR_JOINT_ACCELERATION_MIN, UR_JOINT_ACCELERATION_MAX);
   verifyValueIsWithin(lookahead_time, UR_SERVO_LOOKAHEAD_TIME_MIN, UR_SERVO_LOOKAHEAD_TIME_MAX);
   verifyValueIsWithin(gain, UR_SERVO_GAIN_MIN, UR_SERVO_GAIN_MAX);
 
-  RTDE::RobotCommand robot_cmd;
-  robot_cmd.type_ = RTDE::RobotCommand::Type::SERVOL;
-  robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_2;
-  robot_cmd.val_ = pose;
-  robot_cmd.val_.push_back(speed);
-  robot_cmd.val_.push_back(acceleration);
-  robot_cmd.val_.push_back(time);
-  robot_cmd.val_.push_back(lookahead_time);
-  robot_cmd.val_.push_back(gain);
+  RTDE::RealtimeCommand robot_cmd(type, RTDE::RobotCommand::Recipe::RECIPE_2);
+  robot_cmd.addDoubles(target, 6);
+  robot_cmd.addDouble(speed);
+  robot_cmd.addDouble(acceleration);
+  robot_cmd.addDouble(time);
+  robot_cmd.addDouble(lookahead_time);
+  robot_cmd.addDouble(gain);
   return sendCommand(robot_cmd);
 }
 
@@ -1341,18 +1608,22 @@ bool RTDEControlInterface::servoStop(double a)
 }
 
 bool RTDEControlInterface::servoC(const std::vector<double> &pose, double speed, double acceleration, double blend)
+{
+  verifyVectorSize(pose, 6, "pose");
+  return sendServoC(pose.data(), speed, acceleration, blend);
+}
+
+bool RTDEControlInterface::sendServoC(const double *pose, double speed, double acceleration, double blend)
 {
   verifyValueIsWithin(speed, UR_TOOL_VELOCITY_MIN, UR_TOOL_VELOCITY_MAX);
   verifyValueIsWithin(acceleration, UR_TOOL_ACCELERATION_MIN, UR_TOOL_ACCELERATION_MAX);
   verifyValueIsWithin(blend, UR_BLEND_MIN, UR_BLEND_MAX);
 
-  RTDE::RobotCommand robot_cmd;
-  robot_cmd.type_ = RTDE::RobotCommand::Type::SERVOC;
-  robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_5;
-  robot_cmd.val_ = pose;
-  robot_cmd.val_.push_back(speed);
-  robot_cmd.val_.push_back(acceleration);
-  robot_cmd.val_.push_back(blend);
+  RTDE::RealtimeCommand robot_cmd(RTDE::RobotCommand::Type::SERVOC, RTDE::RobotCommand::Recipe::RECIPE_5);
+  robot_cmd.addDoubles(pose, 6);
+  robot_cmd.addDouble(speed);
+  robot_cmd.addDouble(acceleration);
+  robot_cmd.addDouble(blend);
   return sendCommand(robot_cmd);
 }
 
@@ -1416,6 +1687,8 @@ int RTDEControlInterface::toolContact(const std::vector<double> &direction)
   robot_cmd.type_ = RTDE::RobotCommand::Type::TOOL_CONTACT;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_6;
   robot_cmd.val_ = direction;
+  // Held until the result registers are read, the next command of another thread overwrites them
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     return getToolContactValue();
@@ -1431,6 +1704,7 @@ double RTDEControlInterface::getStepTime()
   RTDE::RobotCommand robot_cmd;
   robot_cmd.type_ = RTDE::RobotCommand::Type::GET_STEPTIME;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     return getStepTimeValue();
@@ -1447,6 +1721,7 @@ std::vector<double> RTDEControlInterface::getActualJointPositionsHistory(int ste
   robot_cmd.type_ = RTDE::RobotCommand::Type::GET_ACTUAL_JOINT_POSITIONS_HISTORY;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_9;
   robot_cmd.steps_ = steps;
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     return getActualJointPositionsHistoryValue();
@@ -1462,6 +1737,7 @@ std::vector<double> RTDEControlInterface::getTargetWaypoint()
   RTDE::RobotCommand robot_cmd;
   robot_cmd.type_ = RTDE::RobotCommand::Type::GET_TARGET_WAYPOINT;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     return getTargetWaypointValue();
@@ -1475,7 +1751,7 @@ std::vector<double> RTDEControlInterface::getTargetWaypoint()
 bool RTDEControlInterface::isProgramRunning()
 {
   uint32_t runtime_state;
-  if (!robot_state_->getStateData("runtime_state", runtime_state))
+  if (!robot_state_->getStateData(RobotState::Field::runtime_state, runtime_state))
     throw std::runtime_error("unable to get state data for specified key: runtime_state");
 
   if (runtime_state == RuntimeState::PLAYING)
@@ -1488,7 +1764,7 @@ uint32_t RTDEControlInterface::getRobotStatus()
 {
   checkRobotStateMemberValid();
   uint32_t robot_status;
-  if (robot_state_->getStateData("robot_status_bits", robot_status))
+  if (robot_state_->getStateData(RobotState::Field::robot_status_bits, robot_status))
     return robot_status;
   else
     throw std::runtime_error("unable to get state data for specified key: robot_status_bits");
@@ -1569,20 +1845,6 @@ std::vector<double> RTDEControlInterface::getInverseKinematicsValue()
   }
 }
 
-std::vector<double> RTDEControlInterface::poseTransValue()
-{
-  if (robot_state_ != nullptr)
-  {
-    std::vector<double> pose = {getOutputDoubleReg(0), getOutputDoubleReg(1), getOutputDoubleReg(2),
-                                getOutputDoubleReg(3), getOutputDoubleReg(4), getOutputDoubleReg(5)};
-    return pose;
-  }
-  else
-  {
-    throw std::logic_error("Please initialize the RobotState, before using it!");
-  }
-}
-
 bool RTDEControlInterface::setTcp(const std::vector<double> &tcp_offset)
 {
   RTDE::RobotCommand robot_cmd;
@@ -1613,6 +1875,7 @@ std::vector<double> RTDEControlInterface::getInverseKinematics(const std::vector
     robot_cmd.val_ = x;
   }
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     return getInverseKinematicsValue();
@@ -1627,19 +1890,8 @@ std::vector<double> RTDEControlInterface::getInverseKinematics(const std::vector
 std::vector<double> RTDEControlInterface::poseTrans(const std::vector<double> &p_from,
                                                     const std::vector<double> &p_from_to)
 {
-  RTDE::RobotCommand robot_cmd;
-  robot_cmd.type_ = RTDE::RobotCommand::Type::POSE_TRANS;
-  robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_12;
-  robot_cmd.val_ = p_from;
-  robot_cmd.val_.insert(robot_cmd.val_.end(), p_from_to.begin(), p_from_to.end());
-  if (sendCommand(robot_cmd))
-  {
-    return poseTransValue();
-  }
-  else
-  {
-    throw std::runtime_error("poseTrans() function did not succeed!");
-  }
+  // Evaluated in the client, the result is identical to pose_trans() of the controller
+  return pose_math::poseTrans(p_from, p_from_to);
 }
 
 int RTDEControlInterface::getControlScriptState()
@@ -1659,7 +1911,7 @@ bool RTDEControlInterface::isProtectiveStopped()
   if (robot_state_ != nullptr)
   {
     uint32_t safety_status_bits;
-    if (robot_state_->getStateData("safety_status_bits", safety_status_bits))
+    if (robot_state_->getStateData(RobotState::Field::safety_status_bits, safety_status_bits))
     {
       std::bitset<32> safety_status_bitset(safety_status_bits);
       return safety_status_bitset.test(SafetyStatus::IS_PROTECTIVE_STOPPED);
@@ -1678,7 +1930,7 @@ bool RTDEControlInterface::isEmergencyStopped()
   if (robot_state_ != nullptr)
   {
     uint32_t safety_status_bits;
-    if (robot_state_->getStateData("safety_status_bits", safety_status_bits))
+    if (robot_state_->getStateData(RobotState::Field::safety_status_bits, safety_status_bits))
     {
       std::bitset<32> safety_status_bitset(safety_status_bits);
       return safety_status_bitset.test(SafetyStatus::IS_EMERGENCY_STOPPED);
@@ -1724,6 +1976,7 @@ bool RTDEControlInterface::isPoseWithinSafetyLimits(const std::vector<double> &p
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_6;
   robot_cmd.val_ = pose;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -1756,6 +2009,7 @@ bool RTDEControlInterface::stopContactDetection()
   robot_cmd.type_ = RTDE::RobotCommand::Type::STOP_CONTACT_DETECTION;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -1779,6 +2033,7 @@ bool RTDEControlInterface::readContactDetection()
   robot_cmd.type_ = RTDE::RobotCommand::Type::READ_CONTACT_DETECTION;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -1803,6 +2058,7 @@ bool RTDEControlInterface::isJointsWithinSafetyLimits(const std::vector<double>
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_6;
   robot_cmd.val_ = q;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -1826,6 +2082,7 @@ std::vector<double> RTDEControlInterface::getJointTorques()
   robot_cmd.type_ = RTDE::RobotCommand::Type::GET_JOINT_TORQUES;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -1851,6 +2108,7 @@ std::vector<double> RTDEControlInterface::getTCPOffset()
   robot_cmd.type_ = RTDE::RobotCommand::Type::GET_TCP_OFFSET;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -1893,6 +2151,7 @@ std::vector<double> RTDEControlInterface::getForwardKinematics(const std::vector
     robot_cmd.val_.insert(robot_cmd.val_.end(), tcp_offset.begin(), tcp_offset.end());
   }
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -1918,6 +2177,7 @@ bool RTDEControlInterface::isSteady()
   robot_cmd.type_ = RTDE::RobotCommand::Type::IS_STEADY;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -1974,6 +2234,7 @@ int RTDEControlInterface::getFreedriveStatus()
   RTDE::RobotCommand robot_cmd;
   robot_cmd.type_ = RTDE::RobotCommand::Type::GET_FREEDRIVE_STATUS;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -2052,6 +2313,7 @@ std::vector<double> RTDEControlInterface::getActualToolFlangePose()
   robot_cmd.type_ = RTDE::RobotCommand::Type::GET_ACTUAL_TOOL_FLANGE_POSE;
   robot_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     if (robot_state_ != nullptr)
@@ -2103,6 +2365,7 @@ bool RTDEControlInterface::getInverseKinematicsHasSolution(const std::vector<dou
     robot_cmd.val_ = x;
   }
 
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   if (sendCommand(robot_cmd))
   {
     // check status of output integer register 1, indicates if a solution was found
@@ -2164,101 +2427,156 @@ std::string RTDEControlInterface::inIntReg(int reg) const
 
 double RTDEControlInterface::getOutputDoubleReg(int reg)
 {
-  std::string output_double_register_key = "output_double_register_" + std::to_string(register_offset_ + reg);
+  RobotState::Field output_double_register = RobotState::outputDoubleRegister(register_offset_ + reg);
   double output_double_register_val;
-  if (robot_state_->getStateData(output_double_register_key, output_double_register_val))
+  if (robot_state_->getStateData(output_double_register, output_double_register_val))
     return output_double_register_val;
   else
-    throw std::runtime_error("unable to get state data for specified key: " + output_double_register_key);
+    throw std::runtime_error(std::string("unable to get state data for specified key: ") +
+                             RobotState::fieldName(output_double_register));
 };
 
 int RTDEControlInterface::getOutputIntReg(int reg)
 {
-  std::string output_int_register_key = "output_int_register_" + std::to_string(register_offset_ + reg);
+  RobotState::Field output_int_register = RobotState::outputIntRegister(register_offset_ + reg);
   int32_t output_int_register_val;
-  if (robot_state_->getStateData(output_int_register_key, output_int_register_val))
+  if (robot_state_->getStateData(output_int_register, output_int_register_val))
     return output_int_register_val;
   else
-    throw std::runtime_error("unable to get state data for specified key: " + output_int_register_key);
+    throw std::runtime_error(std::string("unable to get state data for specified key: ") +
+                             RobotState::fieldName(output_int_register));
 };
 
+bool RTDEControlInterface::waitForReadyForCommand()
+{
+  std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+  uint32_t runtime_state;
+  if (!robot_state_->getStateData(RobotState::Field::runtime_state, runtime_state))
+    throw std::runtime_error("unable to get state data for specified key: runtime_state");
+
+  if (runtime_state == RuntimeState::STOPPED)
+  {
+    if (!custom_script_running_)
+    {
+      sendClearCommand();
+      return false;
+    }
+  }
+
+  if (!(isProgramRunning() || custom_script_ || custom_script_running_ || use_external_control_ur_cap_))
+  {
+    std::cerr << "RTDEControlInterface: RTDE control script is not running!" << std::endl;
+    sendClearCommand();
+    return false;
+  }
+
+  std::uint64_t sequence_number = robot_state_->getSequenceNumber();
+  while (getControlScriptState() != UR_CONTROLLER_RDY_FOR_CMD)
+  {
+    // If robot is in an emergency or protective stop return false
+    if (isProtectiveStopped() || isEmergencyStopped())
+    {
+      sendClearCommand();
+      return false;
+    }
+
+    // Wait until the controller is ready for a command or timeout
+    std::chrono::steady_clock::time_point current_time = std::chrono::steady_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+    if (duration > UR_GET_READY_TIMEOUT)
+    {
+      sendClearCommand();
+      return false;
+    }
+    waitForStateUpdate(sequence_number);
+  }
+  return true;
+}
+
 bool RTDEControlInterface::sendCommand(const RTDE::RobotCommand &cmd)
 {
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
   std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
 
   try
   {
-    uint32_t runtime_state;
-    if (!robot_state_->getStateData("runtime_state", runtime_state))
-      throw std::runtime_error("unable to get state data for specified key: runtime_state");
+    if (!waitForReadyForCommand())
+      return false;
 
-    if (runtime_state == RuntimeState::STOPPED)
+    if (cmd.type_ == RTDE::RobotCommand::Type::SERVOJ || cmd.type_ == RTDE::RobotCommand::Type::SERVOL ||
+        cmd.type_ == RTDE::RobotCommand::Type::SERVOC || cmd.type_ == RTDE::RobotCommand::Type::SPEEDJ ||
+        cmd.type_ == RTDE::RobotCommand::Type::SPEEDL || cmd.type_ == RTDE::RobotCommand::Type::FORCE_MODE ||
+        cmd.type_ == RTDE::RobotCommand::Type::WATCHDOG || cmd.type_ == RTDE::RobotCommand::Type::GET_JOINT_TORQUES ||
+        cmd.type_ == RTDE::RobotCommand::Type::TOOL_CONTACT || cmd.type_ == RTDE::RobotCommand::Type::GET_STEPTIME ||
+        cmd.type_ == RTDE::RobotCommand::Type::GET_ACTUAL_JOINT_POSITIONS_HISTORY ||
+        cmd.type_ == RTDE::RobotCommand::Type::SET_EXTERNAL_FORCE_TORQUE)
     {
-      if (!custom_script_running_)
-      {
-        sendClearCommand();
-        return false;
-      }
-    }
+      // Send command to the controller
+      rtde_->send(cmd, recipe_offset_);
+
+      // We do not wait for 'continuous' / RT commands to finish.
 
-    if (isProgramRunning() || custom_script_ || custom_script_running_ || use_external_control_ur_cap_)
+      return true;
+    }
+    else
     {
-      while (getControlScriptState() != UR_CONTROLLER_RDY_FOR_CMD)
-      {
-        // If robot is in an emergency or protective stop return false
-        if (isProtectiveStopped() || isEmergencyStopped())
-        {
-          sendClearCommand();
-          return false;
-        }
+      // Any other command ends a stream of realtime commands
+      streaming_ = false;
 
-        // Wait until the controller is ready for a command or timeout
-        std::chrono::steady_clock::time_point current_time = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
-        if (duration > UR_GET_READY_TIMEOUT)
-        {
-          sendClearCommand();
-          return false;
-        }
-      }
+      // Send command to the controller
+      rtde_->send(cmd, recipe_offset_);
 
-      if (cmd.type_ == RTDE::RobotCommand::Type::SERVOJ || cmd.type_ == RTDE::RobotCommand::Type::SERVOL ||
-          cmd.type_ == RTDE::RobotCommand::Type::SERVOC || cmd.type_ == RTDE::RobotCommand::Type::SPEEDJ ||
-          cmd.type_ == RTDE::RobotCommand::Type::SPEEDL || cmd.type_ == RTDE::RobotCommand::Type::FORCE_MODE ||
-          cmd.type_ == RTDE::RobotCommand::Type::WATCHDOG || cmd.type_ == RTDE::RobotCommand::Type::GET_JOINT_TORQUES ||
-          cmd.type_ == RTDE::RobotCommand::Type::TOOL_CONTACT || cmd.type_ == RTDE::RobotCommand::Type::GET_STEPTIME ||
-          cmd.type_ == RTDE::RobotCommand::Type::GET_ACTUAL_JOINT_POSITIONS_HISTORY ||
-          cmd.type_ == RTDE::RobotCommand::Type::SET_EXTERNAL_FORCE_TORQUE)
+      if (cmd.type_ != RTDE::RobotCommand::Type::STOP_SCRIPT)
       {
-        // Send command to the controller
-        rtde_->send(cmd);
+        start_time = std::chrono::steady_clock::now();
+        std::uint64_t sequence_number = robot_state_->getSequenceNumber();
+        while (getControlScriptState() != UR_CONTROLLER_DONE_WITH_CMD)
+        {
+          // if the script causes an error, for example because of inverse
+          // kinematics calculation failed, then it may be that the script no
+          // longer runs an we will never receive the UR_CONTROLLER_DONE_WITH_CMD
+          // signal
+          if (!isProgramRunning())
+          {
+            std::cerr << "RTDEControlInterface: RTDE control script is not running!" << std::endl;
+//              throw std::runtime_error("RTDE control script is not running!");
+            sendClearCommand();
+            return false;
+          }
 
-        // We do not wait for 'continuous' / RT commands to finish.
+          // If robot is in an emergency or protective stop return false
+          if (isProtectiveStopped() || isEmergencyStopped())
+          {
+            sendClearCommand();
+            return false;
+          }
 
-        return true;
+          // Wait until the controller has finished executing or timeout
+          auto current_time = std::chrono::steady_clock::now();
+          auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+          if (duration > UR_EXECUTION_TIMEOUT)
+          {
+            sendClearCommand();
+            return false;
+          }
+          waitForStateUpdate(sequence_number);
+        }
       }
       else
       {
-        // Send command to the controller
-        rtde_->send(cmd);
-
-        if (cmd.type_ != RTDE::RobotCommand::Type::STOP_SCRIPT)
+        if (use_external_control_ur_cap_)
         {
-          start_time = std::chrono::steady_clock::now();
-          while (getControlScriptState() != UR_CONTROLLER_DONE_WITH_CMD)
+          // Program is allowed to still be running when using the ExternalControl UR Cap.
+          // So we simply wait a bit for the stop script command to go through and clear the cmd register and return.
+          std::this_thread::sleep_for(std::chrono::milliseconds(2));
+          sendClearCommand();
+          return true;
+        }
+        else
+        {
+          std::uint64_t sequence_number = robot_state_->getSequenceNumber();
+          while (isProgramRunning())
           {
-            // if the script causes an error, for example because of inverse
-            // kinematics calculation failed, then it may be that the script no
-            // longer runs an we will never receive the UR_CONTROLLER_DONE_WITH_CMD
-            // signal
-            if (!isProgramRunning())
-            {
-              std::cerr << "RTDEControlInterface: RTDE control script is not running!" << std::endl;
-//              throw std::runtime_error("RTDE control script is not running!");
-              sendClearCommand();
-              return false;
-            }
-
             // If robot is in an emergency or protective stop return false
             if (isProtectiveStopped() || isEmergencyStopped())
             {
@@ -2266,7 +2584,7 @@ bool RTDEControlInterface::sendCommand(const RTDE::RobotCommand &cmd)
               return false;
             }
 
-            // Wait until the controller has finished executing or timeout
+            // Wait for program to stop running or timeout
             auto current_time = std::chrono::steady_clock::now();
             auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
             if (duration > UR_EXECUTION_TIMEOUT)
@@ -2274,57 +2592,58 @@ bool RTDEControlInterface::sendCommand(const RTDE::RobotCommand &cmd)
               sendClearCommand();
               return false;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            waitForStateUpdate(sequence_number);
           }
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
-        else
-        {
-          if (use_external_control_ur_cap_)
-          {
-            // Program is allowed to still be running when using the ExternalControl UR Cap.
-            // So we simply wait a bit for the stop script command to go through and clear the cmd register and return.
-            std::this_thread::sleep_for(std::chrono::milliseconds(2));
-            sendClearCommand();
-            return true;
-          }
-          else
-          {
-            while (isProgramRunning())
-            {
-              // If robot is in an emergency or protective stop return false
-              if (isProtectiveStopped() || isEmergencyStopped())
-              {
-                sendClearCommand();
-                return false;
-              }
-
-              // Wait for program to stop running or timeout
-              auto current_time = std::chrono::steady_clock::now();
-              auto duration = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
-              if (duration > UR_EXECUTION_TIMEOUT)
-              {
-                sendClearCommand();
-                return false;
-              }
-              std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-          }
-        }
-
-        // Make controller ready for next command
-        sendClearCommand();
-        return true;
       }
+
+      // Make controller ready for next command
+      sendClearCommand();
+      return true;
     }
-    else
+  }
+  catch (std::exception &e)
+  {
+    std::cerr << "RTDEControlInterface: Lost connection to robot..." << std::endl;
+    std::cerr << e.what() << std::endl;
+    if (rtde_ != nullptr)
     {
-      std::cerr << "RTDEControlInterface: RTDE control script is not running!" << std::endl;
-//      throw std::runtime_error("RTDE control script is not running!");
-      sendClearCommand();
-      return false;
+      if (rtde_->isConnected())
+        rtde_->disconnect();
     }
   }
+
+  if (!rtde_->isConnected())
+  {
+    std::cerr << "RTDEControlInterface: Robot is disconnected, reconnecting..." << std::endl;
+    reconnect();
+    return sendCommand(cmd);
+  }
+  sendClearCommand();
+  return false;
+}
+
+bool RTDEControlInterface::sendCommand(const RTDE::RealtimeCommand &cmd)
+{
+  std::lock_guard<std::recursive_mutex> command_lock(command_mutex_);
+  try
+  {
+    // Only the first command of a stream waits until the control script is ready. The script processes a realtime
+    // command within one cycle and is ready again, so the following setpoints are written right away while the
+    // robot state reports the script running and the robot not stopped.
+    if (!streaming_ || !isStreamReady())
+    {
+      streaming_ = false;
+      if (!waitForReadyForCommand())
+        return false;
+      streaming_ = true;
+    }
+
+    // Realtime commands are not waited for, like the realtime RobotCommand types
+    rtde_->send(cmd, recipe_offset_);
+    return true;
+  }
   catch (std::exception &e)
   {
     std::cerr << "RTDEControlInterface: Lost connection to robot..." << std::endl;
@@ -2346,43 +2665,46 @@ bool RTDEControlInterface::sendCommand(const RTDE::RobotCommand &cmd)
   return false;
 }
 
+void RTDEControlInterface::updateStreamStatus()
+{
+  // Evaluated once per received state: by the receive thread of this interface, or on the first command after a new
+  // state when the state is received by an RTDESession
+  std::uint64_t sequence = robot_state_->getSequenceNumber();
+  if (sequence == stream_status_sequence_.load(std::memory_order_acquire))
+    return;
+
+  uint32_t runtime_state = 0;
+  uint32_t safety_status_bits = 0;
+  robot_state_->getStateData(RobotState::Field::runtime_state, runtime_state);
+  robot_state_->getStateData(RobotState::Field::safety_status_bits, safety_status_bits);
+  std::bitset<32> safety_status_bitset(safety_status_bits);
+
+  bool script_running = runtime_state == RuntimeState::PLAYING || custom_script_ || custom_script_running_ ||
+                        use_external_control_ur_cap_;
+  bool stopped = runtime_state == RuntimeState::STOPPED && !custom_script_running_;
+  bool safety_stopped = safety_status_bitset.test(SafetyStatus::IS_PROTECTIVE_STOPPED) ||
+                        safety_status_bitset.test(SafetyStatus::IS_EMERGENCY_STOPPED);
+  stream_ready_.store(script_running && !stopped && !safety_stopped, std::memory_order_relaxed);
+  stream_status_sequence_.store(sequence, std::memory_order_release);
+}
+
+bool RTDEControlInterface::isStreamReady()
+{
+  updateStreamStatus();
+  return stream_ready_.load(std::memory_order_relaxed);
+}
+
 void RTDEControlInterface::sendClearCommand()
 {
   RTDE::RobotCommand clear_cmd;
   clear_cmd.type_ = RTDE::RobotCommand::Type::NO_CMD;
   clear_cmd.recipe_id_ = RTDE::RobotCommand::Recipe::RECIPE_4;
-  rtde_->send(clear_cmd);
+  rtde_->send(clear_cmd, recipe_offset_);
 }
 
-struct VelocityAccLimits
-{
-  double velocity_min;
-  double velocity_max;
-  double acceleration_min;
-  double acceleration_max;
-};
-
 std::string PathEntry::toScriptCode() const
 {
-  static const VelocityAccLimits joint_limits = {UR_JOINT_VELOCITY_MIN, UR_JOINT_VELOCITY_MAX,
-                                                 UR_JOINT_ACCELERATION_MIN, UR_JOINT_ACCELERATION_MAX};
-  static const VelocityAccLimits tool_limits = {UR_TOOL_VELOCITY_MIN, UR_TOOL_VELOCITY_MAX, UR_TOOL_ACCELERATION_MIN,
-                                                UR_TOOL_ACCELERATION_MAX};
-
-  const VelocityAccLimits &limits = (PositionJoints == pos_type_) ? joint_limits : tool_limits;
-  switch (move_type_)
-  {
-    case MoveJ:
-    case MoveL:
-    case MoveP:
-      verifyValueIsWithin(param_[6], limits.velocity_min, limits.velocity_max);
-      verifyValueIsWithin(param_[7], limits.acceleration_min, limits.acceleration_max);
-      verifyValueIsWithin(param_[8], UR_BLEND_MIN, UR_BLEND_MAX);
-      break;
-    case MoveC:
-      throw std::runtime_error("MoveC in path not supported yet");
-      break;
-  }
+  verifyPathEntry(*this);
 
   std::stringstream ss;
   ss << "\t";
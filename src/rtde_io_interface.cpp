@@ -1,5 +1,6 @@
 #include <ur_rtde/rtde.h>
 #include <ur_rtde/rtde_io_interface.h>
+#include <ur_rtde/rtde_session.h>
 #include <ur_rtde/rtde_utility.h>
 
 #include <bitset>
@@ -10,8 +11,19 @@
 namespace ur_rtde
 {
 RTDEIOInterface::RTDEIOInterface(std::string hostname, bool verbose, bool use_upper_range_registers, int rt_priority)
-    : hostname_(std::move(hostname)), verbose_(verbose), use_upper_range_registers_(use_upper_range_registers),
-      rt_priority_(rt_priority)
+    : RTDEIOInterface(nullptr, std::move(hostname), verbose, use_upper_range_registers, rt_priority)
+{
+}
+
+RTDEIOInterface::RTDEIOInterface(std::shared_ptr<RTDESession> session, bool verbose, bool use_upper_range_registers)
+    : RTDEIOInterface(session, session->getHostname(), verbose, use_upper_range_registers, RT_PRIORITY_UNDEFINED)
+{
+}
+
+RTDEIOInterface::RTDEIOInterface(std::shared_ptr<RTDESession> session, std::string hostname, bool verbose,
+                                 bool use_upper_range_registers, int rt_priority)
+    : session_(std::move(session)), hostname_(std::move(hostname)), verbose_(verbose),
+      use_upper_range_registers_(use_upper_range_registers), rt_priority_(rt_priority)
 {
   // Check if realtime kernel is available and set realtime priority for the interface.
   if (RTDEUtility::isRealtimeKernelAvailable())
@@ -38,9 +50,17 @@ RTDEIOInterface::RTDEIOInterface(std::string hostname, bool verbose, bool use_up
   }
 
   port_ = 30004;
-  rtde_ = std::make_shared<RTDE>(hostname_, port_, verbose_);
-  rtde_->connect();
-  rtde_->negotiateProtocolVersion();
+  if (session_ != nullptr)
+  {
+    // Share the connection of the session
+    rtde_ = session_->rtde();
+  }
+  else
+  {
+    rtde_ = std::make_shared<RTDE>(hostname_, port_, verbose_);
+    rtde_->connect();
+    rtde_->negotiateProtocolVersion();
+  }
 
   if(use_upper_range_registers_)
     register_offset_ = 24;
@@ -51,22 +71,20 @@ RTDEIOInterface::RTDEIOInterface(std::string hostname, bool verbose, bool use_up
   // Setup recipes
   setupRecipes();
 
-  // Wait for connection to be fully established before returning
-  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // Wait for connection to be fully established before returning, a session has already started synchronization
+  if (session_ == nullptr)
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
 }
 
 RTDEIOInterface::~RTDEIOInterface()
 {
-  if (rtde_ != nullptr)
-  {
-    if (rtde_->isConnected())
-      rtde_->disconnect();
-  }
+  disconnect();
 }
 
 void RTDEIOInterface::disconnect()
 {
-  if (rtde_ != nullptr)
+  // A shared connection is closed by its session
+  if (rtde_ != nullptr && session_ == nullptr)
   {
     if (rtde_->isConnected())
       rtde_->disconnect();
@@ -75,6 +93,9 @@ void RTDEIOInterface::disconnect()
 
 bool RTDEIOInterface::reconnect()
 {
+  if (session_ != nullptr)
+    return session_->reconnect();
+
   rtde_->connect();
   rtde_->negotiateProtocolVersion();
 
@@ -89,74 +110,86 @@ bool RTDEIOInterface::reconnect()
 
 bool RTDEIOInterface::setupRecipes()
 {
+  std::vector<std::vector<std::string>> input_recipes;
+
   // Recipe 1
   std::vector<std::string> no_cmd_input = {inIntReg(23)};
-  rtde_->sendInputSetup(no_cmd_input);
+  input_recipes.push_back(no_cmd_input);
 
   // Recipe 2
   std::vector<std::string> set_std_digital_out_input = {inIntReg(23), "standard_digital_output_mask",
                                                         "standard_digital_output"};
-  rtde_->sendInputSetup(set_std_digital_out_input);
+  input_recipes.push_back(set_std_digital_out_input);
 
   // Recipe 3
   std::vector<std::string> set_tool_digital_out_input = {inIntReg(23), "tool_digital_output_mask",
                                                          "tool_digital_output"};
-  rtde_->sendInputSetup(set_tool_digital_out_input);
+  input_recipes.push_back(set_tool_digital_out_input);
 
   // Recipe 4
   std::vector<std::string> set_speed_slider = {inIntReg(23), "speed_slider_mask", "speed_slider_fraction"};
-  rtde_->sendInputSetup(set_speed_slider);
+  input_recipes.push_back(set_speed_slider);
 
   // Recipe 5
   std::vector<std::string> set_std_analog_output = {inIntReg(23), "standard_analog_output_mask",
                                                     "standard_analog_output_type", "standard_analog_output_0",
                                                     "standard_analog_output_1"};
-  rtde_->sendInputSetup(set_std_analog_output);
+  input_recipes.push_back(set_std_analog_output);
 
   // Recipe 6
   std::vector<std::string> set_conf_digital_out_input = {inIntReg(23), "configurable_digital_output_mask",
                                                          "configurable_digital_output"};
-  rtde_->sendInputSetup(set_conf_digital_out_input);
+  input_recipes.push_back(set_conf_digital_out_input);
 
   // Recipe 7
   std::vector<std::string> set_input_int_reg_0_input = {inIntReg(23), inIntReg(18)};
-  rtde_->sendInputSetup(set_input_int_reg_0_input);
+  input_recipes.push_back(set_input_int_reg_0_input);
 
   // Recipe 8
   std::vector<std::string> set_input_int_reg_1_input = {inIntReg(23), inIntReg(19)};
-  rtde_->sendInputSetup(set_input_int_reg_1_input);
+  input_recipes.push_back(set_input_int_reg_1_input);
 
   // Recipe 9
   std::vector<std::string> set_input_int_reg_2_input = {inIntReg(23), inIntReg(20)};
-  rtde_->sendInputSetup(set_input_int_reg_2_input);
+  input_recipes.push_back(set_input_int_reg_2_input);
 
   // Recipe 10
   std::vector<std::string> set_input_int_reg_3_input = {inIntReg(23), inIntReg(21)};
-  rtde_->sendInputSetup(set_input_int_reg_3_input);
+  input_recipes.push_back(set_input_int_reg_3_input);
 
   // Recipe 11
   std::vector<std::string> set_input_int_reg_4_input = {inIntReg(23), inIntReg(22)};
-  rtde_->sendInputSetup(set_input_int_reg_4_input);
+  input_recipes.push_back(set_input_int_reg_4_input);
 
   // Recipe 12
   std::vector<std::string> set_input_double_reg_0_input = {inIntReg(23), inDoubleReg(18)};
-  rtde_->sendInputSetup(set_input_double_reg_0_input);
+  input_recipes.push_back(set_input_double_reg_0_input);
 
   // Recipe 13
   std::vector<std::string> set_input_double_reg_1_input = {inIntReg(23), inDoubleReg(19)};
-  rtde_->sendInputSetup(set_input_double_reg_1_input);
+  input_recipes.push_back(set_input_double_reg_1_input);
 
   // Recipe 14
   std::vector<std::string> set_input_double_reg_2_input = {inIntReg(23), inDoubleReg(20)};
-  rtde_->sendInputSetup(set_input_double_reg_2_input);
+  input_recipes.push_back(set_input_double_reg_2_input);
 
   // Recipe 15
   std::vector<std::string> set_input_double_reg_3_input = {inIntReg(23), inDoubleReg(21)};
-  rtde_->sendInputSetup(set_input_double_reg_3_input);
+  input_recipes.push_back(set_input_double_reg_3_input);
 
   // Recipe 16
   std::vector<std::string> set_input_double_reg_4_input = {inIntReg(23), inDoubleReg(22)};
-  rtde_->sendInputSetup(set_input_double_reg_4_input);
+  input_recipes.push_back(set_input_double_reg_4_input);
+
+  if (session_ != nullptr)
+  {
+    recipe_offset_ = session_->subscribe({}, input_recipes);
+  }
+  else
+  {
+    for (const auto &input_recipe : input_recipes)
+      rtde_->sendInputSetup(input_recipe);
+  }
   return true;
 }
 
@@ -383,7 +416,7 @@ bool RTDEIOInterface::sendCommand(const RTDE::RobotCommand &cmd)
   try
   {
     // Send command to the controller
-    rtde_->send(cmd);
+    rtde_->send(cmd, recipe_offset_);
     return true;
   }
   catch (std::exception &e)
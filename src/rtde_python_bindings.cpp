@@ -1,8 +1,11 @@
 #include <pybind11/functional.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/chrono.h>
 #include <ur_rtde/dashboard_client.h>
+#include <ur_rtde/online_trajectory_generator.h>
+#include <ur_rtde/pose_math.h>
 #include <ur_rtde/rtde_control_interface.h>
 #include <ur_rtde/rtde_control_interface_doc.h>
 #include <ur_rtde/rtde_io_interface.h>
@@ -10,12 +13,24 @@
 #include <ur_rtde/rtde_receive_interface.h>
 #include <ur_rtde/rtde_receive_interface_doc.h>
 #include <ur_rtde/script_client.h>
+#include <ur_rtde/trajectory_streamer.h>
+#include <ur_rtde/ur_kinematics.h>
 
 namespace py = pybind11;
 using namespace ur_rtde;
 
 namespace rtde_control
 {
+// Contiguous double arrays, other layouts and dtypes are converted once for the whole batch
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> DoubleArray;
+
+static std::size_t batchSize(const DoubleArray &array, const char *name)
+{
+  if (array.ndim() != 2 || array.shape(1) != 6)
+    throw std::invalid_argument(std::string(name) + " must have the shape (N, 6)");
+  return static_cast<std::size_t>(array.shape(0));
+}
+
 PYBIND11_MODULE(rtde_control, m)
 {
   m.doc() = "RTDE Control Interface";
@@ -56,6 +71,123 @@ PYBIND11_MODULE(rtde_control, m)
 	.def("equals", &AsyncOperationStatus::equals, py::arg("other"), py::call_guard<py::gil_scoped_release>())
 	.def("__repr__", [](const AsyncOperationStatus &a) { return "<rtde_control.AsyncOperationStatus>"; });
 
+  typedef std::vector<double> (*PoseFunction)(const std::vector<double> &, const std::vector<double> &);
+  typedef std::vector<double> (*VectorFunction)(const std::vector<double> &);
+  py::module pose_math_module = m.def_submodule("pose_math", "Pose algebra of URScript, computed in the client");
+  pose_math_module.def("poseTrans", static_cast<PoseFunction>(&pose_math::poseTrans), py::arg("p_from"),
+                       py::arg("p_from_to"));
+  pose_math_module.def("poseInv", static_cast<VectorFunction>(&pose_math::poseInv), py::arg("pose"));
+  pose_math_module.def("poseAdd", static_cast<PoseFunction>(&pose_math::poseAdd), py::arg("p_1"), py::arg("p_2"));
+  pose_math_module.def("poseSub", static_cast<PoseFunction>(&pose_math::poseSub), py::arg("p_to"),
+                       py::arg("p_from"));
+  pose_math_module.def("interpolatePose",
+                       static_cast<std::vector<double> (*)(const std::vector<double> &, const std::vector<double> &,
+                                                           double)>(&pose_math::interpolatePose),
+                       py::arg("p_from"), py::arg("p_to"), py::arg("alpha"));
+  pose_math_module.def("rotationVectorToQuaternion",
+                       static_cast<VectorFunction>(&pose_math::rotationVectorToQuaternion), py::arg("rotation"));
+  pose_math_module.def("quaternionToRotationVector",
+                       static_cast<VectorFunction>(&pose_math::quaternionToRotationVector), py::arg("q"));
+  pose_math_module.def("rotationVectorToMatrix", static_cast<VectorFunction>(&pose_math::rotationVectorToMatrix),
+                       py::arg("rotation"));
+  pose_math_module.def("matrixToRotationVector", static_cast<VectorFunction>(&pose_math::matrixToRotationVector),
+                       py::arg("matrix"));
+
+  py::class_<DHParameters>(m, "DHParameters")
+      .def(py::init<>())
+      .def_readwrite("a", &DHParameters::a)
+      .def_readwrite("d", &DHParameters::d)
+      .def_readwrite("alpha", &DHParameters::alpha)
+      .def_readwrite("theta", &DHParameters::theta)
+      .def("__repr__", [](const DHParameters &a) { return "<rtde_control.DHParameters>"; });
+
+  py::class_<URKinematics> kinematics(m, "URKinematics");
+  py::enum_<URKinematics::RobotModel>(kinematics, "RobotModel")
+      .value("UR3", URKinematics::RobotModel::UR3)
+      .value("UR5", URKinematics::RobotModel::UR5)
+      .value("UR10", URKinematics::RobotModel::UR10)
+      .value("UR3e", URKinematics::RobotModel::UR3e)
+      .value("UR5e", URKinematics::RobotModel::UR5e)
+      .value("UR10e", URKinematics::RobotModel::UR10e)
+      .value("UR16e", URKinematics::RobotModel::UR16e)
+      .value("UR20", URKinematics::RobotModel::UR20)
+      .value("UR30", URKinematics::RobotModel::UR30)
+      .export_values();
+  kinematics.def(py::init<URKinematics::RobotModel>(), py::arg("model"))
+      .def(py::init<const DHParameters &>(), py::arg("dh_parameters"))
+      .def_static("nominalParameters", &URKinematics::nominalParameters, py::arg("model"))
+      .def("setCalibration", &URKinematics::setCalibration, py::arg("delta"))
+      .def("loadCalibration", &URKinematics::loadCalibration, py::arg("file_path"))
+      .def("isCalibrated", &URKinematics::isCalibrated)
+      .def("getParameters", &URKinematics::getParameters)
+      .def("setTcp", &URKinematics::setTcp, py::arg("tcp_offset"))
+      .def("forwardKinematics",
+           (std::vector<double>(URKinematics::*)(const std::vector<double> &) const) & URKinematics::forwardKinematics,
+           py::arg("q"), py::call_guard<py::gil_scoped_release>())
+      .def("inverseKinematicsAll", &URKinematics::inverseKinematicsAll, py::arg("pose"),
+           py::call_guard<py::gil_scoped_release>())
+      .def("inverseKinematics",
+           (std::vector<double>(URKinematics::*)(const std::vector<double> &, const std::vector<double> &) const) &
+               URKinematics::inverseKinematics,
+           py::arg("pose"), py::arg("qnear"), py::call_guard<py::gil_scoped_release>())
+      .def("inverseKinematicsHasSolution", &URKinematics::inverseKinematicsHasSolution, py::arg("pose"),
+           py::call_guard<py::gil_scoped_release>())
+      .def(
+          "forwardKinematicsBatch",
+          [](const URKinematics &kinematics, const DoubleArray &q, unsigned int threads) {
+            std::size_t count = batchSize(q, "q");
+            py::array_t<double> poses(std::vector<std::size_t>{count, 6});
+            const double *q_data = q.data();
+            double *poses_data = poses.mutable_data();
+            {
+              py::gil_scoped_release release;
+              kinematics.forwardKinematicsBatch(q_data, count, poses_data, threads);
+            }
+            return poses;
+          },
+          "Forward kinematics of an (N, 6) array of joint positions, returns an (N, 6) array of poses", py::arg("q"),
+          py::arg("threads") = 0)
+      .def(
+          "inverseKinematicsBatch",
+          [](const URKinematics &kinematics, const DoubleArray &poses, const DoubleArray &qnear, unsigned int threads) {
+            std::size_t count = batchSize(poses, "poses");
+            if (qnear.size() != 6)
+              throw std::invalid_argument("qnear must have 6 elements");
+            py::array_t<double> q(std::vector<std::size_t>{count, 6});
+            py::array_t<bool> found(std::vector<std::size_t>{count});
+            const double *poses_data = poses.data();
+            const double *qnear_data = qnear.data();
+            double *q_data = q.mutable_data();
+            auto *found_data = reinterpret_cast<std::uint8_t *>(found.mutable_data());
+            {
+              py::gil_scoped_release release;
+              kinematics.inverseKinematicsBatch(poses_data, qnear_data, count, q_data, found_data, threads);
+            }
+            return py::make_tuple(q, found);
+          },
+          "Inverse kinematics of an (N, 6) array of poses, returns the (N, 6) solutions closest to qnear and an (N,) "
+          "array telling which poses are reachable",
+          py::arg("poses"), py::arg("qnear"), py::arg("threads") = 0)
+      .def(
+          "inverseKinematicsAllBatch",
+          [](const URKinematics &kinematics, const DoubleArray &poses, unsigned int threads) {
+            std::size_t count = batchSize(poses, "poses");
+            py::array_t<double> solutions(std::vector<std::size_t>{count, URKinematics::MAX_IK_SOLUTIONS, 6});
+            py::array_t<std::uint8_t> solution_counts(std::vector<std::size_t>{count});
+            const double *poses_data = poses.data();
+            double *solutions_data = solutions.mutable_data();
+            std::uint8_t *counts_data = solution_counts.mutable_data();
+            {
+              py::gil_scoped_release release;
+              kinematics.inverseKinematicsAllBatch(poses_data, count, solutions_data, counts_data, threads);
+            }
+            return py::make_tuple(solutions, solution_counts);
+          },
+          "All inverse kinematics solutions of an (N, 6) array of poses, returns an (N, 8, 6) array with NaN for "
+          "unused solutions and the (N,) solution counts",
+          py::arg("poses"), py::arg("threads") = 0)
+      .def("__repr__", [](const URKinematics &a) { return "<rtde_control.URKinematics>"; });
+
 
   py::class_<RTDEControlInterface> control(m, "RTDEControlInterface");
   py::enum_<RTDEControlInterface::Flags>(control, "Flags", py::arithmetic())
@@ -102,6 +234,24 @@ PYBIND11_MODULE(rtde_control, m)
   control.def("movePath",
            (bool (RTDEControlInterface::*)(const Path &path, bool asynchronous)) & RTDEControlInterface::movePath, DOC(ur_rtde, RTDEControlInterface, movePath),
            "", py::arg("path"), py::arg("asynchronous") = false, py::call_guard<py::gil_scoped_release>());
+  control.def("appendPath", &RTDEControlInterface::appendPath, DOC(ur_rtde, RTDEControlInterface, appendPath),
+              py::arg("path"), py::call_guard<py::gil_scoped_release>());
+  control.def(
+      "streamPath",
+      [](RTDEControlInterface &self, py::iterable waypoints) {
+        py::iterator it = py::iter(waypoints);
+        // Released before the iterator is destroyed, the source takes the GIL back for each waypoint
+        py::gil_scoped_release release;
+        return self.streamPath([&it](PathEntry &entry) {
+          py::gil_scoped_acquire acquire;
+          if (it == py::iterator::sentinel())
+            return false;
+          entry = it->cast<PathEntry>();
+          ++it;
+          return true;
+        });
+      },
+      DOC(ur_rtde, RTDEControlInterface, streamPath), py::arg("waypoints"));
   control.def("moveJ",
            (bool (RTDEControlInterface::*)(const std::vector<double> &q, double speed, double acceleration, bool asynchronous)) &
                RTDEControlInterface::moveJ,
@@ -224,6 +374,13 @@ PYBIND11_MODULE(rtde_control, m)
   control.def("setGravity", &RTDEControlInterface::setGravity, py::call_guard<py::gil_scoped_release>());
   control.def("initPeriod", &RTDEControlInterface::initPeriod, py::call_guard<py::gil_scoped_release>());
   control.def("waitPeriod", &RTDEControlInterface::waitPeriod, py::call_guard<py::gil_scoped_release>());
+  control.def("waitForNextState", &RTDEControlInterface::waitForNextState,
+              py::arg("timeout") = std::chrono::milliseconds(100), py::call_guard<py::gil_scoped_release>());
+  control.def("getStateSequenceNumber", &RTDEControlInterface::getStateSequenceNumber,
+              py::call_guard<py::gil_scoped_release>());
+  control.def("waitForState", &RTDEControlInterface::waitForState, py::arg("sequence_number"), py::arg("timeout"),
+              py::call_guard<py::gil_scoped_release>());
+  control.def("getFrequency", &RTDEControlInterface::getFrequency);
   control.def("getInverseKinematicsHasSolution", &RTDEControlInterface::getInverseKinematicsHasSolution,
               py::arg("x"), py::arg("qnear") = std::vector<double>(),
               py::arg("max_position_error") = 1e-10, py::arg("max_orientation_error") = 1e-10,
@@ -233,6 +390,67 @@ PYBIND11_MODULE(rtde_control, m)
               py::arg("inertia") = std::vector<double>{0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
               py::call_guard<py::gil_scoped_release>());
   control.def("__repr__", [](const RTDEControlInterface &a) { return "<rtde_control.RTDEControlInterface>"; });
+
+  py::class_<TrajectoryStreamer> streamer(m, "TrajectoryStreamer");
+  py::enum_<TrajectoryStreamer::Mode>(streamer, "Mode")
+      .value("SERVO_J", TrajectoryStreamer::Mode::SERVO_J)
+      .value("SERVO_L", TrajectoryStreamer::Mode::SERVO_L)
+      .export_values();
+  py::class_<TrajectoryStreamer::Statistics>(streamer, "Statistics")
+      .def_readonly("cycles", &TrajectoryStreamer::Statistics::cycles)
+      .def_readonly("underruns", &TrajectoryStreamer::Statistics::underruns)
+      .def_readonly("max_consecutive_underruns", &TrajectoryStreamer::Statistics::max_consecutive_underruns)
+      .def_readonly("missed_packages", &TrajectoryStreamer::Statistics::missed_packages)
+      .def_readonly("max_cycle_time_us", &TrajectoryStreamer::Statistics::max_cycle_time_us);
+  // The streamer keeps a reference to the control interface
+  streamer
+      .def(py::init<RTDEControlInterface &, TrajectoryStreamer::Mode, std::size_t, double, double>(),
+           py::arg("rtde_control"), py::arg("mode") = TrajectoryStreamer::Mode::SERVO_J, py::arg("capacity") = 4096,
+           py::arg("lookahead_time") = 0.1, py::arg("gain") = 300, py::keep_alive<1, 2>())
+      .def("start", &TrajectoryStreamer::start, py::arg("cpu_core") = -1, py::arg("rt_priority") = 0,
+           py::call_guard<py::gil_scoped_release>())
+      .def("push",
+           static_cast<bool (TrajectoryStreamer::*)(double, const std::array<double, 6> &)>(&TrajectoryStreamer::push),
+           py::arg("time"), py::arg("target"))
+      .def("finish", &TrajectoryStreamer::finish)
+      // milliseconds::max() overflows the timedelta conversion of pybind11, None selects the infinite wait
+      .def(
+          "waitUntilFinished",
+          [](TrajectoryStreamer &streamer, py::object timeout) {
+            std::chrono::milliseconds wait_timeout = std::chrono::milliseconds::max();
+            if (!timeout.is_none())
+              wait_timeout = timeout.cast<std::chrono::milliseconds>();
+            py::gil_scoped_release release;
+            return streamer.waitUntilFinished(wait_timeout);
+          },
+          py::arg("timeout") = py::none())
+      .def("stop", &TrajectoryStreamer::stop, py::call_guard<py::gil_scoped_release>())
+      .def("isRunning", &TrajectoryStreamer::isRunning)
+      .def("getStreamTime", &TrajectoryStreamer::getStreamTime)
+      .def("getQueueSize", &TrajectoryStreamer::getQueueSize)
+      .def("getStatistics", &TrajectoryStreamer::getStatistics)
+      .def("__repr__", [](const TrajectoryStreamer &a) { return "<rtde_control.TrajectoryStreamer>"; });
+
+  py::class_<OnlineTrajectoryGenerator>(m, "OnlineTrajectoryGenerator")
+      .def(py::init<double, double, double, double>(), py::arg("delta_time"), py::arg("max_velocity"),
+           py::arg("max_acceleration"), py::arg("max_jerk"))
+      .def("setLimits", &OnlineTrajectoryGenerator::setLimits, py::arg("max_velocity"), py::arg("max_acceleration"),
+           py::arg("max_jerk"))
+      .def("setPositionLimits", &OnlineTrajectoryGenerator::setPositionLimits, py::arg("min_position"),
+           py::arg("max_position"))
+      .def("reset", &OnlineTrajectoryGenerator::reset, py::arg("q"), py::arg("qd") = std::vector<double>(),
+           py::arg("qdd") = std::vector<double>())
+      .def("setTarget",
+           static_cast<void (OnlineTrajectoryGenerator::*)(const std::vector<double> &)>(
+               &OnlineTrajectoryGenerator::setTarget),
+           py::arg("q"))
+      .def("update", &OnlineTrajectoryGenerator::update)
+      .def("isTargetReached", &OnlineTrajectoryGenerator::isTargetReached)
+      .def("getPosition", &OnlineTrajectoryGenerator::getPosition)
+      .def("getVelocity", &OnlineTrajectoryGenerator::getVelocity)
+      .def("getAcceleration", &OnlineTrajectoryGenerator::getAcceleration)
+      .def("getDeltaTime", &OnlineTrajectoryGenerator::getDeltaTime)
+      .def("__repr__", [](const OnlineTrajectoryGenerator &a) { return "<rtde_control.OnlineTrajectoryGenerator>"; });
 }
 };  // namespace rtde_control
 
@@ -241,7 +459,13 @@ namespace rtde_receive
 PYBIND11_MODULE(rtde_receive, m)
 {
   m.doc() = "RTDE Receive Interface";
-  py::class_<RTDEReceiveInterface>(m, "RTDEReceiveInterface")
+  py::class_<RTDEReceiveInterface> receive(m, "RTDEReceiveInterface");
+  py::enum_<RTDEReceiveInterface::RecordingFormat>(receive, "RecordingFormat")
+      .value("CSV", RTDEReceiveInterface::RecordingFormat::CSV)
+      .value("BINARY", RTDEReceiveInterface::RecordingFormat::BINARY)
+      .export_values();
+
+  receive
       .def(py::init<std::string, double, std::vector<std::string>, bool, bool, int>(), py::arg("hostname"),
            py::arg("frequency") = -1.0,
            py::arg("variables") = std::vector<std::string>(), py::arg("verbose") = false,
@@ -251,8 +475,11 @@ PYBIND11_MODULE(rtde_receive, m)
       .def("reconnect", &RTDEReceiveInterface::reconnect, DOC(ur_rtde, RTDEReceiveInterface, reconnect),
            py::call_guard<py::gil_scoped_release>())
       .def("startFileRecording", &RTDEReceiveInterface::startFileRecording, py::arg("filename"),
-           py::arg("variables") = std::vector<std::string>(), py::call_guard<py::gil_scoped_release>())
+           py::arg("variables") = std::vector<std::string>(),
+           py::arg("format") = RTDEReceiveInterface::RecordingFormat::CSV, py::call_guard<py::gil_scoped_release>())
       .def("stopFileRecording", &RTDEReceiveInterface::stopFileRecording, py::call_guard<py::gil_scoped_release>())
+      .def_static("convertRecordingToCsv", &RTDEReceiveInterface::convertRecordingToCsv,
+                  py::arg("recording_filename"), py::arg("csv_filename"), py::call_guard<py::gil_scoped_release>())
       .def("isConnected", &RTDEReceiveInterface::isConnected, DOC(ur_rtde, RTDEReceiveInterface, isConnected),
            py::call_guard<py::gil_scoped_release>())
       .def("getTimestamp", &RTDEReceiveInterface::getTimestamp, DOC(ur_rtde, RTDEReceiveInterface, getTimestamp),
@@ -357,6 +584,10 @@ PYBIND11_MODULE(rtde_receive, m)
            py::call_guard<py::gil_scoped_release>())
       .def("waitPeriod", &RTDEReceiveInterface::waitPeriod,
            py::call_guard<py::gil_scoped_release>())
+      .def("waitForNextState", &RTDEReceiveInterface::waitForNextState,
+           py::arg("timeout") = std::chrono::milliseconds(100), py::call_guard<py::gil_scoped_release>())
+      .def("getStateSequenceNumber", &RTDEReceiveInterface::getStateSequenceNumber,
+           py::call_guard<py::gil_scoped_release>())
       .def("__repr__", [](const RTDEReceiveInterface &a) { return "<rtde_receive.RTDEReceiveInterface>"; });
 }
 };  // namespace rtde_receive
@@ -415,6 +646,7 @@ PYBIND11_MODULE(script_client, m)
            py::call_guard<py::gil_scoped_release>())
       .def("sendScriptCommand", &ScriptClient::sendScriptCommand, py::call_guard<py::gil_scoped_release>())
       .def("getScript", &ScriptClient::getScript, py::call_guard<py::gil_scoped_release>())
+      .def_static("setScriptCacheDirectory", &ScriptClient::setScriptCacheDirectory, py::arg("directory"))
       .def("__repr__", [](const ScriptClient &a) { return "<script_client.ScriptClient>"; });
 }
 };  // namespace script_client
@@ -1,9 +1,12 @@
 #include <ur_rtde/robot_state.h>
 #include <ur_rtde/rtde.h>
 #include <ur_rtde/rtde_receive_interface.h>
+#include <ur_rtde/rtde_session.h>
 #include <ur_rtde/rtde_utility.h>
+#include <ur_rtde/state_recorder.h>
 
 #include <bitset>
+#include <cstddef>
 #include <boost/thread/thread.hpp>
 #include <chrono>
 #include <iostream>
@@ -13,9 +16,28 @@
 
 namespace ur_rtde
 {
+// Longer than the period of the slowest (125 Hz) RTDE stream
+static const int RECEIVE_WAIT_TIMEOUT_MS = 10;
+
 RTDEReceiveInterface::RTDEReceiveInterface(std::string hostname, double frequency, std::vector<std::string> variables,
                                            bool verbose, bool use_upper_range_registers, int rt_priority)
-    : hostname_(std::move(hostname)),
+    : RTDEReceiveInterface(nullptr, std::move(hostname), frequency, std::move(variables), verbose,
+                           use_upper_range_registers, rt_priority)
+{
+}
+
+RTDEReceiveInterface::RTDEReceiveInterface(std::shared_ptr<RTDESession> session, std::vector<std::string> variables,
+                                           bool verbose, bool use_upper_range_registers)
+    : RTDEReceiveInterface(session, session->getHostname(), session->getFrequency(), std::move(variables), verbose,
+                           use_upper_range_registers, RT_PRIORITY_UNDEFINED)
+{
+}
+
+RTDEReceiveInterface::RTDEReceiveInterface(std::shared_ptr<RTDESession> session, std::string hostname,
+                                           double frequency, std::vector<std::string> variables, bool verbose,
+                                           bool use_upper_range_registers, int rt_priority)
+    : session_(std::move(session)),
+      hostname_(std::move(hostname)),
       frequency_(frequency),
       variables_(std::move(variables)),
       verbose_(verbose),
@@ -49,10 +71,20 @@ RTDEReceiveInterface::RTDEReceiveInterface(std::string hostname, double frequenc
   }
 
   port_ = 30004;
-  rtde_ = std::make_shared<RTDE>(hostname_, port_, verbose_);
-  rtde_->connect();
-  rtde_->negotiateProtocolVersion();
-  auto controller_version = rtde_->getControllerVersion();
+  std::tuple<uint32_t, uint32_t, uint32_t, uint32_t> controller_version;
+  if (session_ != nullptr)
+  {
+    // Share the connection of the session, which has already negotiated the protocol and fetched the version
+    rtde_ = session_->rtde();
+    controller_version = session_->getControllerVersion();
+  }
+  else
+  {
+    rtde_ = std::make_shared<RTDE>(hostname_, port_, verbose_);
+    rtde_->connect();
+    rtde_->negotiateProtocolVersion();
+    controller_version = rtde_->getControllerVersion();
+  }
   uint32_t major_version = std::get<MAJOR_VERSION>(controller_version);
 
   if (frequency_ < 0) // frequency not specified, set it based on controller version.
@@ -78,8 +110,17 @@ RTDEReceiveInterface::RTDEReceiveInterface(std::string hostname, double frequenc
   // Setup recipes
   setupRecipes(frequency_);
 
+  if (session_ != nullptr)
+  {
+    // The session has started data synchronization with the recipe and receives the robot state
+    robot_state_ = session_->robot_state();
+    bindSnapshotPlan();
+    return;
+  }
+
   // Init Robot state
   robot_state_ = std::make_shared<RobotState>(variables_);
+  bindSnapshotPlan();
 
   // Start RTDE data synchronization
   rtde_->sendStart();
@@ -104,8 +145,15 @@ void RTDEReceiveInterface::disconnect()
 {
   // Stop the receive callback function
   stop_receive_thread = true;
-  th_->interrupt();
-  th_->join();
+  if (th_ != nullptr)
+  {
+    th_->interrupt();
+    th_->join();
+  }
+
+  // A shared connection is closed by its session
+  if (session_ != nullptr)
+    return;
 
   if (rtde_ != nullptr)
   {
@@ -217,7 +265,10 @@ bool RTDEReceiveInterface::setupRecipes(const double& frequency)
   }
 
   // Setup output
-  rtde_->sendOutputSetup(variables_, frequency);
+  if (session_ != nullptr)
+    session_->subscribe(variables_, {});
+  else
+    rtde_->sendOutputSetup(variables_, frequency);
   return true;
 }
 
@@ -228,43 +279,17 @@ void RTDEReceiveInterface::receiveCallback()
     // Receive and update the robot state
     try
     {
-      if (rtde_->isDataAvailable())
-      {
-        no_bytes_avail_cnt_ = 0;
-        boost::system::error_code ec = rtde_->receiveData(robot_state_);
-        if(ec)
-        {
-          if(ec == boost::asio::error::eof)
-          {
-            std::cerr << "RTDEReceiveInterface: Robot closed the connection!" << std::endl;
-          }
-          throw std::system_error(ec);
-        }
-      }
-      else
+      // Block until the next package arrives. If none arrives within a few controller cycles, the receive below
+      // falls back to the regular socket timeout, which detects de-synchronization.
+      rtde_->waitForData(RECEIVE_WAIT_TIMEOUT_MS);
+      boost::system::error_code ec = rtde_->receiveData(robot_state_);
+      if (ec)
       {
-        // Register that data was not available in this cycle
-        no_bytes_avail_cnt_++;
-        // If at least 2ms has passed without data available, try to read data again to detect de-synchronization.
-        if (no_bytes_avail_cnt_ > 20)
+        if (ec == boost::asio::error::eof)
         {
-          boost::system::error_code ec = rtde_->receiveData(robot_state_);
-          if(ec)
-          {
-            if(ec == boost::asio::error::eof)
-            {
-              std::cerr << "RTDEReceiveInterface: Robot closed the connection!" << std::endl;
-            }
-            throw std::system_error(ec);
-          }
-          no_bytes_avail_cnt_ = 0;
+          std::cerr << "RTDEReceiveInterface: Robot closed the connection!" << std::endl;
         }
-
-#if defined(__linux__) || defined(__APPLE__)
-        // Data not available on socket yet, yield to other threads and sleep before trying to receive data again.
-        std::this_thread::yield();
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-#endif
+        throw std::system_error(ec);
       }     
     }
     catch (const boost::system::system_error& e) { // catch the boost exception
@@ -280,9 +305,11 @@ void RTDEReceiveInterface::receiveCallback()
 
 bool RTDEReceiveInterface::reconnect()
 {
+  if (session_ != nullptr)
+    return session_->reconnect();
+
   if (rtde_ != nullptr)
   {
-    no_bytes_avail_cnt_ = 0;
     rtde_->connect();
     rtde_->negotiateProtocolVersion();
     auto controller_version = rtde_->getControllerVersion();
@@ -301,6 +328,12 @@ bool RTDEReceiveInterface::reconnect()
 
     // Init Robot state
     robot_state_ = std::make_shared<RobotState>(variables_);
+    // The new robot state counts its packages from zero
+    last_state_sequence_number_ = 0;
+    bindSnapshotPlan();
+    // A binary recording waits on the robot state it was started with, continue it on the new one
+    if (state_recorder_ != nullptr)
+      state_recorder_->setRobotState(robot_state_);
 
     // Start RTDE data synchronization
     rtde_->sendStart();
@@ -327,18 +360,27 @@ std::chrono::steady_clock::time_point RTDEReceiveInterface::initPeriod()
   return std::chrono::steady_clock::now();
 }
 
+bool RTDEReceiveInterface::waitForNextState(std::chrono::microseconds timeout)
+{
+  if (!robot_state_->waitForState(last_state_sequence_number_, timeout))
+    return false;
+  last_state_sequence_number_ = robot_state_->getSequenceNumber();
+  return true;
+}
+
+std::uint64_t RTDEReceiveInterface::getStateSequenceNumber()
+{
+  return robot_state_->getSequenceNumber();
+}
+
 void RTDEReceiveInterface::waitPeriod(const std::chrono::steady_clock::time_point &t_cycle_start)
 {
   RTDEUtility::waitPeriod(t_cycle_start, delta_time_);
 }
 
-bool RTDEReceiveInterface::startFileRecording(const std::string &filename, const std::vector<std::string> &variables)
+bool RTDEReceiveInterface::startFileRecording(const std::string &filename, const std::vector<std::string> &variables,
+                                              RecordingFormat format)
 {
-  // Init file recording
-  file_recording_ = std::make_shared<std::ofstream>(filename);
-  *file_recording_ << std::fixed << std::setprecision(6);
-
-  // Write header
   if (!variables.empty())
   {
     record_variables_ = variables;
@@ -348,6 +390,19 @@ bool RTDEReceiveInterface::startFileRecording(const std::string &filename, const
     record_variables_ = variables_;
   }
 
+  if (format == RecordingFormat::BINARY)
+  {
+    state_recorder_ = std::make_shared<StateRecorder>(robot_state_, record_variables_, frequency_);
+    state_recorder_->start(filename);
+    return true;
+  }
+
+  // Init file recording
+  file_recording_ = std::make_shared<std::ofstream>(filename);
+  *file_recording_ << std::fixed << std::setprecision(6);
+
+  // Write header
+
   for (size_t i=0; i < record_variables_.size() ; i++)
   {
       uint16_t entry_size = robot_state_->getStateEntrySize(record_variables_[i]);
@@ -376,14 +431,26 @@ bool RTDEReceiveInterface::startFileRecording(const std::string &filename, const
   *file_recording_ << std::endl;
 
   // Start recorder thread
+  stop_record_thread = false;
   record_thrd_ = std::make_shared<boost::thread>(boost::bind(&RTDEReceiveInterface::recordCallback, this));
   return true;
 }
 
 bool RTDEReceiveInterface::stopFileRecording()
 {
+  if (state_recorder_ != nullptr)
+  {
+    bool success = state_recorder_->stop();
+    state_recorder_.reset();
+    return success;
+  }
+
   stop_record_thread = true;
-  record_thrd_->join();
+  if (record_thrd_ != nullptr)
+  {
+    record_thrd_->join();
+    record_thrd_.reset();
+  }
 
   // Close the file
   if (file_recording_ != nullptr)
@@ -392,6 +459,12 @@ bool RTDEReceiveInterface::stopFileRecording()
   return true;
 }
 
+void RTDEReceiveInterface::convertRecordingToCsv(const std::string &recording_filename,
+                                                 const std::string &csv_filename)
+{
+  StateRecorder::convertToCsv(recording_filename, csv_filename);
+}
+
 void RTDEReceiveInterface::recordCallback()
 {
   while (!stop_record_thread)
@@ -404,7 +477,7 @@ void RTDEReceiveInterface::recordCallback()
       if (i != record_variables_.size() - 1)  // No comma at the end of line
         *file_recording_ << ",";
     }
-    *file_recording_ << std::endl;  // End row
+    *file_recording_ << '\n';  // End row, flushed by the stream buffer instead of every period
     waitPeriod(t_start);
   }
 }
@@ -417,7 +490,7 @@ bool RTDEReceiveInterface::isConnected()
 double RTDEReceiveInterface::getTimestamp()
 {
   double timestamp;
-  if (robot_state_->getStateData("timestamp", timestamp))
+  if (robot_state_->getStateData(RobotState::Field::timestamp, timestamp))
     return timestamp;
   else
     throw std::runtime_error("unable to get state data for specified key: timestamp");
@@ -426,7 +499,7 @@ double RTDEReceiveInterface::getTimestamp()
 std::vector<double> RTDEReceiveInterface::getTargetQ()
 {
   std::vector<double> target_q;
-  if (robot_state_->getStateData("target_q", target_q))
+  if (robot_state_->getStateData(RobotState::Field::target_q, target_q))
     return target_q;
   else
     throw std::runtime_error("unable to get state data for specified key: target_q");
@@ -435,7 +508,7 @@ std::vector<double> RTDEReceiveInterface::getTargetQ()
 std::vector<double> RTDEReceiveInterface::getTargetQd()
 {
   std::vector<double> target_qd;
-  if (robot_state_->getStateData("target_qd", target_qd))
+  if (robot_state_->getStateData(RobotState::Field::target_qd, target_qd))
     return target_qd;
   else
     throw std::runtime_error("unable to get state data for specified key: target_qd");
@@ -444,7 +517,7 @@ std::vector<double> RTDEReceiveInterface::getTargetQd()
 std::vector<double> RTDEReceiveInterface::getTargetQdd()
 {
   std::vector<double> target_qdd;
-  if (robot_state_->getStateData("target_qdd", target_qdd))
+  if (robot_state_->getStateData(RobotState::Field::target_qdd, target_qdd))
     return target_qdd;
   else
     throw std::runtime_error("unable to get state data for specified key: target_qdd");
@@ -453,7 +526,7 @@ std::vector<double> RTDEReceiveInterface::getTargetQdd()
 std::vector<double> RTDEReceiveInterface::getTargetCurrent()
 {
   std::vector<double> target_current;
-  if (robot_state_->getStateData("target_current", target_current))
+  if (robot_state_->getStateData(RobotState::Field::target_current, target_current))
     return target_current;
   else
     throw std::runtime_error("unable to get state data for specified key: target_current");
@@ -462,7 +535,7 @@ std::vector<double> RTDEReceiveInterface::getTargetCurrent()
 std::vector<double> RTDEReceiveInterface::getTargetMoment()
 {
   std::vector<double> target_moment;
-  if (robot_state_->getStateData("target_moment", target_moment))
+  if (robot_state_->getStateData(RobotState::Field::target_moment, target_moment))
     return target_moment;
   else
     throw std::runtime_error("unable to get state data for specified key: target_moment");
@@ -471,7 +544,7 @@ std::vector<double> RTDEReceiveInterface::getTargetMoment()
 std::vector<double> RTDEReceiveInterface::getActualQ()
 {
   std::vector<double> actual_q;
-  if (robot_state_->getStateData("actual_q", actual_q))
+  if (robot_state_->getStateData(RobotState::Field::actual_q, actual_q))
     return actual_q;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_q");
@@ -480,7 +553,7 @@ std::vector<double> RTDEReceiveInterface::getActualQ()
 std::vector<double> RTDEReceiveInterface::getActualQd()
 {
   std::vector<double> actual_qd;
-  if (robot_state_->getStateData("actual_qd", actual_qd))
+  if (robot_state_->getStateData(RobotState::Field::actual_qd, actual_qd))
     return actual_qd;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_qd");
@@ -489,7 +562,7 @@ std::vector<double> RTDEReceiveInterface::getActualQd()
 std::vector<double> RTDEReceiveInterface::getActualCurrent()
 {
   std::vector<double> actual_current;
-  if (robot_state_->getStateData("actual_current", actual_current))
+  if (robot_state_->getStateData(RobotState::Field::actual_current, actual_current))
     return actual_current;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_current");
@@ -498,7 +571,7 @@ std::vector<double> RTDEReceiveInterface::getActualCurrent()
 std::vector<double> RTDEReceiveInterface::getJointControlOutput()
 {
   std::vector<double> joint_control_output;
-  if (robot_state_->getStateData("joint_control_output", joint_control_output))
+  if (robot_state_->getStateData(RobotState::Field::joint_control_output, joint_control_output))
     return joint_control_output;
   else
     throw std::runtime_error("unable to get state data for specified key: joint_control_output");
@@ -507,7 +580,7 @@ std::vector<double> RTDEReceiveInterface::getJointControlOutput()
 std::vector<double> RTDEReceiveInterface::getActualTCPPose()
 {
   std::vector<double> actual_tcp_pose;
-  if (robot_state_->getStateData("actual_TCP_pose", actual_tcp_pose))
+  if (robot_state_->getStateData(RobotState::Field::actual_TCP_pose, actual_tcp_pose))
     return actual_tcp_pose;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_TCP_pose");
@@ -516,7 +589,7 @@ std::vector<double> RTDEReceiveInterface::getActualTCPPose()
 std::vector<double> RTDEReceiveInterface::getActualTCPSpeed()
 {
   std::vector<double> actual_tcp_speed;
-  if (robot_state_->getStateData("actual_TCP_speed", actual_tcp_speed))
+  if (robot_state_->getStateData(RobotState::Field::actual_TCP_speed, actual_tcp_speed))
     return actual_tcp_speed;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_TCP_speed");
@@ -525,7 +598,7 @@ std::vector<double> RTDEReceiveInterface::getActualTCPSpeed()
 std::vector<double> RTDEReceiveInterface::getActualTCPForce()
 {
   std::vector<double> actual_tcp_force;
-  if (robot_state_->getStateData("actual_TCP_force", actual_tcp_force))
+  if (robot_state_->getStateData(RobotState::Field::actual_TCP_force, actual_tcp_force))
     return actual_tcp_force;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_TCP_force");
@@ -534,7 +607,7 @@ std::vector<double> RTDEReceiveInterface::getActualTCPForce()
 std::vector<double> RTDEReceiveInterface::getTargetTCPPose()
 {
   std::vector<double> target_tcp_pose;
-  if (robot_state_->getStateData("target_TCP_pose", target_tcp_pose))
+  if (robot_state_->getStateData(RobotState::Field::target_TCP_pose, target_tcp_pose))
     return target_tcp_pose;
   else
     throw std::runtime_error("unable to get state data for specified key: target_TCP_pose");
@@ -543,7 +616,7 @@ std::vector<double> RTDEReceiveInterface::getTargetTCPPose()
 std::vector<double> RTDEReceiveInterface::getTargetTCPSpeed()
 {
   std::vector<double> target_tcp_speed;
-  if (robot_state_->getStateData("target_TCP_speed", target_tcp_speed))
+  if (robot_state_->getStateData(RobotState::Field::target_TCP_speed, target_tcp_speed))
     return target_tcp_speed;
   else
     throw std::runtime_error("unable to get state data for specified key: target_TCP_speed");
@@ -552,7 +625,7 @@ std::vector<double> RTDEReceiveInterface::getTargetTCPSpeed()
 uint64_t RTDEReceiveInterface::getActualDigitalInputBits()
 {
   uint64_t actual_digital_input_bits;
-  if (robot_state_->getStateData("actual_digital_input_bits", actual_digital_input_bits))
+  if (robot_state_->getStateData(RobotState::Field::actual_digital_input_bits, actual_digital_input_bits))
     return actual_digital_input_bits;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_digital_input_bits");
@@ -568,7 +641,7 @@ bool RTDEReceiveInterface::getDigitalInState(std::uint8_t input_id)
 std::vector<double> RTDEReceiveInterface::getJointTemperatures()
 {
   std::vector<double> joint_temperatures;
-  if (robot_state_->getStateData("joint_temperatures", joint_temperatures))
+  if (robot_state_->getStateData(RobotState::Field::joint_temperatures, joint_temperatures))
     return joint_temperatures;
   else
     throw std::runtime_error("unable to get state data for specified key: joint_temperatures");
@@ -577,7 +650,7 @@ std::vector<double> RTDEReceiveInterface::getJointTemperatures()
 double RTDEReceiveInterface::getActualExecutionTime()
 {
   double actual_execution_time;
-  if (robot_state_->getStateData("actual_execution_time", actual_execution_time))
+  if (robot_state_->getStateData(RobotState::Field::actual_execution_time, actual_execution_time))
     return actual_execution_time;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_execution_time");
@@ -586,7 +659,7 @@ double RTDEReceiveInterface::getActualExecutionTime()
 int32_t RTDEReceiveInterface::getRobotMode()
 {
   int32_t robot_mode;
-  if (robot_state_->getStateData("robot_mode", robot_mode))
+  if (robot_state_->getStateData(RobotState::Field::robot_mode, robot_mode))
     return robot_mode;
   else
     throw std::runtime_error("unable to get state data for specified key: robot_mode");
@@ -595,7 +668,7 @@ int32_t RTDEReceiveInterface::getRobotMode()
 uint32_t RTDEReceiveInterface::getRobotStatus()
 {
   uint32_t robot_status;
-  if (robot_state_->getStateData("robot_status_bits", robot_status))
+  if (robot_state_->getStateData(RobotState::Field::robot_status_bits, robot_status))
     return robot_status;
   else
     throw std::runtime_error("unable to get state data for specified key: robot_status");
@@ -604,7 +677,7 @@ uint32_t RTDEReceiveInterface::getRobotStatus()
 std::vector<int32_t> RTDEReceiveInterface::getJointMode()
 {
   std::vector<int32_t> joint_mode;
-  if (robot_state_->getStateData("joint_mode", joint_mode))
+  if (robot_state_->getStateData(RobotState::Field::joint_mode, joint_mode))
     return joint_mode;
   else
     throw std::runtime_error("unable to get state data for specified key: joint_mode");
@@ -613,7 +686,7 @@ std::vector<int32_t> RTDEReceiveInterface::getJointMode()
 int32_t RTDEReceiveInterface::getSafetyMode()
 {
   int32_t safety_mode;
-  if (robot_state_->getStateData("safety_mode", safety_mode))
+  if (robot_state_->getStateData(RobotState::Field::safety_mode, safety_mode))
     return safety_mode;
   else
     throw std::runtime_error("unable to get state data for specified key: safety_mode");
@@ -622,7 +695,7 @@ int32_t RTDEReceiveInterface::getSafetyMode()
 uint32_t RTDEReceiveInterface::getSafetyStatusBits()
 {
   uint32_t safety_status_bits;
-  if (robot_state_->getStateData("safety_status_bits", safety_status_bits))
+  if (robot_state_->getStateData(RobotState::Field::safety_status_bits, safety_status_bits))
     return safety_status_bits;
   else
     throw std::runtime_error("unable to get state data for specified key: safety_status_bits");
@@ -631,7 +704,7 @@ uint32_t RTDEReceiveInterface::getSafetyStatusBits()
 std::vector<double> RTDEReceiveInterface::getActualToolAccelerometer()
 {
   std::vector<double> actual_tool_accelerometer;
-  if (robot_state_->getStateData("actual_tool_accelerometer", actual_tool_accelerometer))
+  if (robot_state_->getStateData(RobotState::Field::actual_tool_accelerometer, actual_tool_accelerometer))
     return actual_tool_accelerometer;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_tool_accelerometer");
@@ -640,7 +713,7 @@ std::vector<double> RTDEReceiveInterface::getActualToolAccelerometer()
 double RTDEReceiveInterface::getSpeedScaling()
 {
   double speed_scaling;
-  if (robot_state_->getStateData("speed_scaling", speed_scaling))
+  if (robot_state_->getStateData(RobotState::Field::speed_scaling, speed_scaling))
     return speed_scaling;
   else
     throw std::runtime_error("unable to get state data for specified key: speed_scaling");
@@ -649,7 +722,7 @@ double RTDEReceiveInterface::getSpeedScaling()
 double RTDEReceiveInterface::getTargetSpeedFraction()
 {
   double target_speed_fraction;
-  if (robot_state_->getStateData("target_speed_fraction", target_speed_fraction))
+  if (robot_state_->getStateData(RobotState::Field::target_speed_fraction, target_speed_fraction))
     return target_speed_fraction;
   else
     throw std::runtime_error("unable to get state data for specified key: target_speed_fraction");
@@ -658,7 +731,7 @@ double RTDEReceiveInterface::getTargetSpeedFraction()
 double RTDEReceiveInterface::getActualMomentum()
 {
   double actual_momentum;
-  if (robot_state_->getStateData("actual_momentum", actual_momentum))
+  if (robot_state_->getStateData(RobotState::Field::actual_momentum, actual_momentum))
     return actual_momentum;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_momentum");
@@ -667,7 +740,7 @@ double RTDEReceiveInterface::getActualMomentum()
 double RTDEReceiveInterface::getActualMainVoltage()
 {
   double actual_main_voltage;
-  if (robot_state_->getStateData("actual_main_voltage", actual_main_voltage))
+  if (robot_state_->getStateData(RobotState::Field::actual_main_voltage, actual_main_voltage))
     return actual_main_voltage;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_main_voltage");
@@ -676,7 +749,7 @@ double RTDEReceiveInterface::getActualMainVoltage()
 double RTDEReceiveInterface::getActualRobotVoltage()
 {
   double actual_robot_voltage;
-  if (robot_state_->getStateData("actual_robot_voltage", actual_robot_voltage))
+  if (robot_state_->getStateData(RobotState::Field::actual_robot_voltage, actual_robot_voltage))
     return actual_robot_voltage;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_robot_voltage");
@@ -685,7 +758,7 @@ double RTDEReceiveInterface::getActualRobotVoltage()
 double RTDEReceiveInterface::getActualRobotCurrent()
 {
   double actual_robot_current;
-  if (robot_state_->getStateData("actual_robot_current", actual_robot_current))
+  if (robot_state_->getStateData(RobotState::Field::actual_robot_current, actual_robot_current))
     return actual_robot_current;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_robot_current");
@@ -694,7 +767,7 @@ double RTDEReceiveInterface::getActualRobotCurrent()
 std::vector<double> RTDEReceiveInterface::getActualJointVoltage()
 {
   std::vector<double> actual_joint_voltage;
-  if (robot_state_->getStateData("actual_joint_voltage", actual_joint_voltage))
+  if (robot_state_->getStateData(RobotState::Field::actual_joint_voltage, actual_joint_voltage))
     return actual_joint_voltage;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_joint_voltage");
@@ -703,7 +776,7 @@ std::vector<double> RTDEReceiveInterface::getActualJointVoltage()
 uint64_t RTDEReceiveInterface::getActualDigitalOutputBits()
 {
   uint64_t actual_digital_output_bits;
-  if (robot_state_->getStateData("actual_digital_output_bits", actual_digital_output_bits))
+  if (robot_state_->getStateData(RobotState::Field::actual_digital_output_bits, actual_digital_output_bits))
     return actual_digital_output_bits;
   else
     throw std::runtime_error("unable to get state data for specified key: actual_digital_output_bits");
@@ -719,7 +792,7 @@ bool RTDEReceiveInterface::getDigitalOutState(std::uint8_t output_id)
 uint32_t RTDEReceiveInterface::getRuntimeState()
 {
   uint32_t runtime_state;
-  if (robot_state_->getStateData("runtime_state", runtime_state))
+  if (robot_state_->getStateData(RobotState::Field::runtime_state, runtime_state))
     return runtime_state;
   else
     throw std::runtime_error("unable to get state data for specified key: runtime_state");
@@ -728,7 +801,7 @@ uint32_t RTDEReceiveInterface::getRuntimeState()
 double RTDEReceiveInterface::getStandardAnalogInput0()
 {
   double standard_analog_input0;
-  if (robot_state_->getStateData("standard_analog_input0", standard_analog_input0))
+  if (robot_state_->getStateData(RobotState::Field::standard_analog_input0, standard_analog_input0))
     return standard_analog_input0;
   else
     throw std::runtime_error("unable to get state data for specified key: standard_analog_input_0");
@@ -737,7 +810,7 @@ double RTDEReceiveInterface::getStandardAnalogInput0()
 double RTDEReceiveInterface::getStandardAnalogInput1()
 {
   double standard_analog_input1;
-  if (robot_state_->getStateData("standard_analog_input1", standard_analog_input1))
+  if (robot_state_->getStateData(RobotState::Field::standard_analog_input1, standard_analog_input1))
     return standard_analog_input1;
   else
     throw std::runtime_error("unable to get state data for specified key: standard_analog_input_1");
@@ -746,7 +819,7 @@ double RTDEReceiveInterface::getStandardAnalogInput1()
 double RTDEReceiveInterface::getStandardAnalogOutput0()
 {
   double standard_analog_output0;
-  if (robot_state_->getStateData("standard_analog_output0", standard_analog_output0))
+  if (robot_state_->getStateData(RobotState::Field::standard_analog_output0, standard_analog_output0))
     return standard_analog_output0;
   else
     throw std::runtime_error("unable to get state data for specified key: standard_analog_output_0");
@@ -755,7 +828,7 @@ double RTDEReceiveInterface::getStandardAnalogOutput0()
 double RTDEReceiveInterface::getStandardAnalogOutput1()
 {
   double standard_analog_output1;
-  if (robot_state_->getStateData("standard_analog_output1", standard_analog_output1))
+  if (robot_state_->getStateData(RobotState::Field::standard_analog_output1, standard_analog_output1))
     return standard_analog_output1;
   else
     throw std::runtime_error("unable to get state data for specified key: standard_analog_output_1");
@@ -764,7 +837,7 @@ double RTDEReceiveInterface::getStandardAnalogOutput1()
 double RTDEReceiveInterface::getPayload()
 {
   double payload;
-  if (robot_state_->getStateData("payload", payload))
+  if (robot_state_->getStateData(RobotState::Field::payload, payload))
     return payload;
   else
     throw std::runtime_error("unable to get state data for specified key: payload");
@@ -773,7 +846,7 @@ double RTDEReceiveInterface::getPayload()
 std::vector<double> RTDEReceiveInterface::getPayloadCog()
 {
   std::vector<double> payload_cog;
-  if (robot_state_->getStateData("payload_cog", payload_cog))
+  if (robot_state_->getStateData(RobotState::Field::payload_cog, payload_cog))
     return payload_cog;
   else
     throw std::runtime_error("unable to get state data for specified key: payload_cog");
@@ -782,12 +855,132 @@ std::vector<double> RTDEReceiveInterface::getPayloadCog()
 std::vector<double> RTDEReceiveInterface::getPayloadInertia()
 {
   std::vector<double> payload_inertia;
-  if (robot_state_->getStateData("payload_inertia", payload_inertia))
+  if (robot_state_->getStateData(RobotState::Field::payload_inertia, payload_inertia))
     return payload_inertia;
   else
     throw std::runtime_error("unable to get state data for specified key: payload_inertia");
 }
 
+namespace
+{
+template <typename T>
+struct SnapshotType;
+template <>
+struct SnapshotType<double>
+{
+  static const RobotState::ValueType type = RobotState::ValueType::DOUBLE;
+  static const std::uint16_t size = 1;
+};
+template <>
+struct SnapshotType<std::int32_t>
+{
+  static const RobotState::ValueType type = RobotState::ValueType::INT32;
+  static const std::uint16_t size = 1;
+};
+template <>
+struct SnapshotType<std::uint32_t>
+{
+  static const RobotState::ValueType type = RobotState::ValueType::UINT32;
+  static const std::uint16_t size = 1;
+};
+template <>
+struct SnapshotType<std::uint64_t>
+{
+  static const RobotState::ValueType type = RobotState::ValueType::UINT64;
+  static const std::uint16_t size = 1;
+};
+template <std::size_t N>
+struct SnapshotType<std::array<double, N>>
+{
+  static const RobotState::ValueType type = RobotState::ValueType::VECTOR_DOUBLE;
+  static const std::uint16_t size = N;
+};
+template <std::size_t N>
+struct SnapshotType<std::array<std::int32_t, N>>
+{
+  static const RobotState::ValueType type = RobotState::ValueType::VECTOR_INT32;
+  static const std::uint16_t size = N;
+};
+
+struct SnapshotField
+{
+  RobotState::Field field;
+  RobotState::ValueType type;
+  std::uint16_t size;
+  std::size_t destination;
+};
+
+#define SNAPSHOT_FIELD(member)                                                                             \
+  {                                                                                                         \
+    RobotState::Field::member, SnapshotType<decltype(RobotStateSnapshot::member)>::type,                    \
+        SnapshotType<decltype(RobotStateSnapshot::member)>::size, offsetof(RobotStateSnapshot, member)      \
+  }
+
+const SnapshotField snapshot_fields[] = {
+    SNAPSHOT_FIELD(timestamp),
+    SNAPSHOT_FIELD(target_q),
+    SNAPSHOT_FIELD(target_qd),
+    SNAPSHOT_FIELD(target_qdd),
+    SNAPSHOT_FIELD(target_current),
+    SNAPSHOT_FIELD(target_moment),
+    SNAPSHOT_FIELD(actual_q),
+    SNAPSHOT_FIELD(actual_qd),
+    SNAPSHOT_FIELD(actual_current),
+    SNAPSHOT_FIELD(joint_control_output),
+    SNAPSHOT_FIELD(actual_TCP_pose),
+    SNAPSHOT_FIELD(actual_TCP_speed),
+    SNAPSHOT_FIELD(actual_TCP_force),
+    SNAPSHOT_FIELD(target_TCP_pose),
+    SNAPSHOT_FIELD(target_TCP_speed),
+    SNAPSHOT_FIELD(actual_digital_input_bits),
+    SNAPSHOT_FIELD(joint_temperatures),
+    SNAPSHOT_FIELD(actual_execution_time),
+    SNAPSHOT_FIELD(robot_mode),
+    SNAPSHOT_FIELD(joint_mode),
+    SNAPSHOT_FIELD(safety_mode),
+    SNAPSHOT_FIELD(actual_tool_accelerometer),
+    SNAPSHOT_FIELD(speed_scaling),
+    SNAPSHOT_FIELD(target_speed_fraction),
+    SNAPSHOT_FIELD(actual_momentum),
+    SNAPSHOT_FIELD(actual_main_voltage),
+    SNAPSHOT_FIELD(actual_robot_voltage),
+    SNAPSHOT_FIELD(actual_robot_current),
+    SNAPSHOT_FIELD(actual_joint_voltage),
+    SNAPSHOT_FIELD(actual_digital_output_bits),
+    SNAPSHOT_FIELD(runtime_state),
+    SNAPSHOT_FIELD(robot_status_bits),
+    SNAPSHOT_FIELD(safety_status_bits),
+    SNAPSHOT_FIELD(standard_analog_input0),
+    SNAPSHOT_FIELD(standard_analog_input1),
+    SNAPSHOT_FIELD(standard_analog_output0),
+    SNAPSHOT_FIELD(standard_analog_output1),
+    SNAPSHOT_FIELD(ft_raw_wrench),
+    SNAPSHOT_FIELD(payload),
+    SNAPSHOT_FIELD(payload_cog),
+    SNAPSHOT_FIELD(payload_inertia),
+};
+
+#undef SNAPSHOT_FIELD
+}  // namespace
+
+void RTDEReceiveInterface::bindSnapshotPlan()
+{
+  // Resolve the storage of the snapshot members once, so getSnapshot() is a plain copy loop
+  snapshot_plan_.clear();
+  for (const auto &field : snapshot_fields)
+  {
+    std::int32_t offset = robot_state_->getStateOffset(field.field);
+    if (offset >= 0 && RobotState::fieldType(field.field) == field.type &&
+        RobotState::fieldSize(field.field) == field.size)
+      snapshot_plan_.push_back({offset, field.size, field.type, field.destination});
+  }
+}
+
+void RTDEReceiveInterface::getSnapshot(RobotStateSnapshot &snapshot)
+{
+  snapshot.sequence_number = robot_state_->copyState(snapshot_plan_, &snapshot);
+}
+
 double RTDEReceiveInterface::getRtdeFrequency()
 {
     auto controller_version = rtde_->getControllerVersion();
@@ -851,12 +1044,13 @@ int RTDEReceiveInterface::getOutputIntRegister(int output_id)
           std::to_string(output_id));
     }
   }
-  std::string output_int_register_key = "output_int_register_" + std::to_string(output_id);
+  RobotState::Field output_int_register = RobotState::outputIntRegister(output_id);
   int32_t output_int_register_val;
-  if (robot_state_->getStateData(output_int_register_key, output_int_register_val))
+  if (robot_state_->getStateData(output_int_register, output_int_register_val))
     return output_int_register_val;
   else
-    throw std::runtime_error("unable to get state data for specified key: "+output_int_register_key);
+    throw std::runtime_error(std::string("unable to get state data for specified key: ") +
+                             RobotState::fieldName(output_int_register));
 }
 
 double RTDEReceiveInterface::getOutputDoubleRegister(int output_id)
@@ -880,18 +1074,19 @@ double RTDEReceiveInterface::getOutputDoubleRegister(int output_id)
     }
   }
 
-  std::string output_double_register_key = "output_double_register_" + std::to_string(output_id);
+  RobotState::Field output_double_register = RobotState::outputDoubleRegister(output_id);
   double output_double_register_val;
-  if (robot_state_->getStateData(output_double_register_key, output_double_register_val))
+  if (robot_state_->getStateData(output_double_register, output_double_register_val))
     return output_double_register_val;
   else
-    throw std::runtime_error("unable to get state data for specified key: " + output_double_register_key);
+    throw std::runtime_error(std::string("unable to get state data for specified key: ") +
+                             RobotState::fieldName(output_double_register));
 }
 
 std::vector<double> RTDEReceiveInterface::getFtRawWrench()
 {
   std::vector<double> ft_raw_wrench;
-  if (robot_state_->getStateData("ft_raw_wrench", ft_raw_wrench))
+  if (robot_state_->getStateData(RobotState::Field::ft_raw_wrench, ft_raw_wrench))
   {
     if (!ft_raw_wrench.empty())
       return ft_raw_wrench;
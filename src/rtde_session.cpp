@@ -0,0 +1,241 @@
+#include <ur_rtde/robot_state.h>
+#include <ur_rtde/rtde.h>
+#include <ur_rtde/rtde_session.h>
+#include <ur_rtde/rtde_utility.h>
+
+#include <algorithm>
+#include <boost/thread/thread.hpp>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace ur_rtde
+{
+// Longer than the period of the slowest (125 Hz) RTDE stream
+static const int RECEIVE_WAIT_TIMEOUT_MS = 10;
+static const std::uint32_t CB3_MAJOR_VERSION = 3;
+
+RTDESession::RTDESession(std::string hostname, double frequency, bool verbose, int rt_priority)
+    : hostname_(std::move(hostname)), frequency_(frequency), verbose_(verbose), rt_priority_(rt_priority)
+{
+  rtde_ = std::make_shared<RTDE>(hostname_, 30004, verbose_);
+  rtde_->connect();
+  rtde_->negotiateProtocolVersion();
+  auto controller_version = rtde_->getControllerVersion();
+
+  if (frequency_ < 0)  // frequency not specified, set it based on controller version.
+  {
+    frequency_ = 125;
+    // If e-Series Robot set frequency to 500Hz
+    if (std::get<0>(controller_version) > CB3_MAJOR_VERSION)
+      frequency_ = 500;
+  }
+
+  // The controller does not start synchronization without an output recipe, so the timestamp is always subscribed,
+  // also when only an RTDEIOInterface is attached.
+  output_names_ = {"timestamp"};
+  robot_state_ = std::make_shared<RobotState>(output_names_);
+}
+
+RTDESession::~RTDESession()
+{
+  disconnect();
+}
+
+std::uint8_t RTDESession::subscribe(const std::vector<std::string> &output_names,
+                                    const std::vector<std::vector<std::string>> &input_recipes)
+{
+  std::lock_guard<std::mutex> lock(setup_mutex_);
+  if (input_recipes_.size() + input_recipes.size() > 255)
+    throw std::logic_error("RTDESession: The input recipes of the attached interfaces exceed 255 recipes");
+
+  auto recipe_offset = static_cast<std::uint8_t>(input_recipes_.size());
+  for (const auto &output_name : output_names)
+  {
+    if (std::find(output_names_.begin(), output_names_.end(), output_name) == output_names_.end())
+      output_names_.push_back(output_name);
+  }
+  input_recipes_.insert(input_recipes_.end(), input_recipes.begin(), input_recipes.end());
+
+  // Entries are only added to the robot state, so the interfaces can resolve their offsets before the session is
+  // started and the state pointers they hold stay valid
+  robot_state_->initRobotState(output_names_);
+  if (!started_)
+    return recipe_offset;
+
+  // Recipes can only be set up before synchronization is started, so a running session starts over on a new
+  // connection. The controller numbers the input recipes in the order they are set up, which keeps the recipe
+  // offsets handed out earlier valid.
+  restartConnection();
+  startSynchronization();
+  return recipe_offset;
+}
+
+void RTDESession::start()
+{
+  std::vector<std::pair<const void *, std::function<void()>>> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(setup_mutex_);
+    if (started_)
+      return;
+
+    if (!rtde_->isConnected())
+      restartConnection();
+    startSynchronization();
+    started_ = true;
+    callbacks.swap(start_callbacks_);
+  }
+
+  // Run without the setup mutex, a control interface waits for its script on the robot state here
+  for (const auto &callback : callbacks)
+    callback.second();
+}
+
+bool RTDESession::isStarted() const
+{
+  return started_;
+}
+
+void RTDESession::addStartCallback(const void *owner, std::function<void()> callback)
+{
+  std::lock_guard<std::mutex> lock(setup_mutex_);
+  start_callbacks_.emplace_back(owner, std::move(callback));
+}
+
+void RTDESession::removeStartCallbacks(const void *owner)
+{
+  std::lock_guard<std::mutex> lock(setup_mutex_);
+  start_callbacks_.erase(std::remove_if(start_callbacks_.begin(), start_callbacks_.end(),
+                                        [owner](const std::pair<const void *, std::function<void()>> &callback) {
+                                          return callback.first == owner;
+                                        }),
+                         start_callbacks_.end());
+}
+
+void RTDESession::startSynchronization()
+{
+  rtde_->sendRecipeSetup(output_names_, frequency_, input_recipes_);
+  rtde_->sendStart();
+  if (!rtde_->isStarted())
+    throw std::logic_error("RTDESession: Failed to start RTDE data synchronization");
+
+  stop_receive_thread_ = false;
+  th_ = std::make_shared<boost::thread>(boost::bind(&RTDESession::receiveCallback, this));
+
+  // Wait until the first robot state has been received
+  while (rtde_->isConnected() && !robot_state_->getFirstStateReceived())
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+void RTDESession::restartConnection()
+{
+  stopReceiveThread();
+  if (rtde_->isConnected())
+    rtde_->disconnect(false);
+
+  rtde_->connect();
+  rtde_->negotiateProtocolVersion();
+  // Cache the version while no data packages are streamed
+  rtde_->getControllerVersion();
+}
+
+void RTDESession::stopReceiveThread()
+{
+  stop_receive_thread_ = true;
+  if (th_ != nullptr)
+  {
+    th_->interrupt();
+    th_->join();
+    th_.reset();
+  }
+}
+
+void RTDESession::disconnect()
+{
+  std::lock_guard<std::mutex> lock(setup_mutex_);
+  stopReceiveThread();
+  if (rtde_ != nullptr)
+  {
+    if (rtde_->isConnected())
+      rtde_->disconnect();
+  }
+}
+
+bool RTDESession::reconnect()
+{
+  std::lock_guard<std::mutex> lock(setup_mutex_);
+  // A session that has not been started connects in start()
+  if (!started_)
+    return rtde_->isConnected();
+  // Another attached interface may already have re-established the connection
+  if (rtde_->isStarted())
+    return true;
+
+  restartConnection();
+  startSynchronization();
+  return rtde_->isConnected();
+}
+
+bool RTDESession::isConnected()
+{
+  return rtde_->isConnected();
+}
+
+const std::string &RTDESession::getHostname() const
+{
+  return hostname_;
+}
+
+double RTDESession::getFrequency() const
+{
+  return frequency_;
+}
+
+std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t> RTDESession::getControllerVersion() const
+{
+  return rtde_->getControllerVersion();
+}
+
+void RTDESession::receiveCallback()
+{
+  if (RTDEUtility::isRealtimeKernelAvailable())
+  {
+    if (!RTDEUtility::setRealtimePriority(rt_priority_))
+      std::cerr << "RTDESession: Warning! Failed to set realtime priority even though a realtime kernel is "
+                   "available." << std::endl;
+    else if (verbose_)
+      std::cout << "RTDESession: realtime priority set successfully!" << std::endl;
+  }
+
+  while (!stop_receive_thread_)
+  {
+    // Receive and update the shared robot state
+    try
+    {
+      // Block until the next package arrives. If none arrives within a few controller cycles, the receive below
+      // falls back to the regular socket timeout, which detects de-synchronization.
+      rtde_->waitForData(RECEIVE_WAIT_TIMEOUT_MS);
+      boost::system::error_code ec = rtde_->receiveData(robot_state_);
+      if (ec)
+      {
+        if (ec == boost::asio::error::eof)
+        {
+          std::cerr << "RTDESession: Robot closed the connection!" << std::endl;
+        }
+        throw std::system_error(ec);
+      }
+    }
+    catch (const std::exception &e)
+    {
+      // The attached interfaces see the lost connection through isConnected() and call reconnect()
+      std::cerr << "RTDESession Exception: " << e.what() << std::endl;
+      if (rtde_->isConnected())
+        rtde_->disconnect(false);
+      stop_receive_thread_ = true;
+    }
+  }
+}
+
+}  // namespace ur_rtde
@@ -0,0 +1,1017 @@
+#include <ur_rtde/rtde_simulator.h>
+#include <ur_rtde/rtde_utility.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace ur_rtde
+{
+namespace
+{
+const unsigned HEADER_SIZE = 3;
+const int POLL_TIMEOUT_MS = 100;
+const int SCRIPT_IDLE_TIMEOUT_MS = 20;
+
+bool isRealtimeCommand(int cmd)
+{
+  // Must match the realtime commands of the main loop in rtde_control.script
+  return cmd == 24 || cmd == 11 || cmd == 9 || cmd == 10 || cmd == 6 || cmd == 25 || cmd == 26 || cmd == 27 ||
+         cmd == 38 || cmd == 58;
+}
+
+const char *wireTypeName(RTDE::WireType type)
+{
+  switch (type)
+  {
+    case RTDE::WireType::BOOL:
+      return "BOOL";
+    case RTDE::WireType::UINT8:
+      return "UINT8";
+    case RTDE::WireType::UINT32:
+      return "UINT32";
+    case RTDE::WireType::UINT64:
+      return "UINT64";
+    case RTDE::WireType::INT32:
+      return "INT32";
+    case RTDE::WireType::DOUBLE:
+      return "DOUBLE";
+    case RTDE::WireType::VECTOR3D:
+      return "VECTOR3D";
+    case RTDE::WireType::VECTOR6D:
+      return "VECTOR6D";
+    case RTDE::WireType::VECTOR6INT32:
+      return "VECTOR6INT32";
+    case RTDE::WireType::VECTOR6UINT32:
+      return "VECTOR6UINT32";
+  }
+  return "NOT_FOUND";
+}
+
+std::size_t wireTypeCount(RTDE::WireType type)
+{
+  switch (type)
+  {
+    case RTDE::WireType::VECTOR3D:
+      return 3;
+    case RTDE::WireType::VECTOR6D:
+    case RTDE::WireType::VECTOR6INT32:
+    case RTDE::WireType::VECTOR6UINT32:
+      return 6;
+    default:
+      return 1;
+  }
+}
+
+void putUInt32(std::vector<char> &out, std::uint32_t value)
+{
+  out.push_back(static_cast<char>(value >> 24));
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+void putUInt64(std::vector<char> &out, std::uint64_t value)
+{
+  putUInt32(out, static_cast<std::uint32_t>(value >> 32));
+  putUInt32(out, static_cast<std::uint32_t>(value));
+}
+
+void putDouble(std::vector<char> &out, double value)
+{
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  putUInt64(out, bits);
+}
+
+void putField(std::vector<char> &out, RTDE::WireType type, const double *value)
+{
+  for (std::size_t i = 0; i < wireTypeCount(type); i++)
+  {
+    switch (type)
+    {
+      case RTDE::WireType::BOOL:
+      case RTDE::WireType::UINT8:
+        out.push_back(static_cast<char>(static_cast<std::uint8_t>(value[i])));
+        break;
+      case RTDE::WireType::UINT32:
+      case RTDE::WireType::VECTOR6UINT32:
+        putUInt32(out, static_cast<std::uint32_t>(value[i]));
+        break;
+      case RTDE::WireType::INT32:
+      case RTDE::WireType::VECTOR6INT32:
+        putUInt32(out, static_cast<std::uint32_t>(static_cast<std::int32_t>(value[i])));
+        break;
+      case RTDE::WireType::UINT64:
+        putUInt64(out, static_cast<std::uint64_t>(value[i]));
+        break;
+      default:
+        putDouble(out, value[i]);
+        break;
+    }
+  }
+}
+
+bool getField(const std::vector<char> &in, std::uint32_t &offset, RTDE::WireType type, double *value)
+{
+  for (std::size_t i = 0; i < wireTypeCount(type); i++)
+  {
+    switch (type)
+    {
+      case RTDE::WireType::BOOL:
+      case RTDE::WireType::UINT8:
+        if (offset + 1 > in.size())
+          return false;
+        value[i] = RTDEUtility::getUInt8(in, offset);
+        break;
+      case RTDE::WireType::UINT32:
+      case RTDE::WireType::VECTOR6UINT32:
+        if (offset + 4 > in.size())
+          return false;
+        value[i] = RTDEUtility::getUInt32(in, offset);
+        break;
+      case RTDE::WireType::INT32:
+      case RTDE::WireType::VECTOR6INT32:
+        if (offset + 4 > in.size())
+          return false;
+        value[i] = RTDEUtility::getInt32(in, offset);
+        break;
+      case RTDE::WireType::UINT64:
+        if (offset + 8 > in.size())
+          return false;
+        value[i] = static_cast<double>(RTDEUtility::getUInt64(in, offset));
+        break;
+      default:
+        if (offset + 8 > in.size())
+          return false;
+        value[i] = RTDEUtility::getDouble(in, offset);
+        break;
+    }
+  }
+  return true;
+}
+
+// Read exactly size bytes, returns false on disconnect or when the simulator is stopped
+bool readFully(int fd, char *data, std::size_t size, const std::atomic<bool> &running)
+{
+  std::size_t received = 0;
+  while (received < size)
+  {
+    pollfd pfd{fd, POLLIN, 0};
+    int ret = ::poll(&pfd, 1, POLL_TIMEOUT_MS);
+    if (!running)
+      return false;
+    if (ret < 0 && errno != EINTR)
+      return false;
+    if (ret <= 0)
+      continue;
+    ssize_t n = ::recv(fd, data + received, size - received, 0);
+    if (n <= 0)
+      return false;
+    received += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+bool writeFully(int fd, const char *data, std::size_t size)
+{
+  std::size_t sent = 0;
+  while (sent < size)
+  {
+    ssize_t n = ::send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    sent += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+std::vector<std::string> splitNames(const std::string &names)
+{
+  std::vector<std::string> result;
+  for (const auto &name : RTDEUtility::split(names, ','))
+  {
+    if (!name.empty())
+      result.push_back(name);
+  }
+  return result;
+}
+}  // namespace
+
+RTDESimulator::RTDESimulator(std::string address, double frequency, bool verbose)
+    : address_(std::move(address)),
+      frequency_(frequency),
+      verbose_(verbose),
+      rtde_port_(30004),
+      script_port_(30003),
+      dashboard_port_(29999),
+      version_{5, 11, 0, 0},
+      running_(false),
+      statistics_(),
+      script_running_(false),
+      executing_cmd_(false),
+      register_offset_(0)
+{
+  if (frequency_ <= 0)
+    throw std::invalid_argument("RTDESimulator: the frequency must be positive");
+
+  using WT = RTDE::WireType;
+  addVariable("timestamp", WT::DOUBLE, false);
+  for (const char *name : {"target_q", "target_qd", "target_qdd", "target_current", "target_moment", "actual_q",
+                           "actual_qd", "actual_qdd", "actual_current", "actual_moment", "joint_control_output",
+                           "actual_TCP_pose", "actual_TCP_speed", "actual_TCP_force", "target_TCP_pose",
+                           "target_TCP_speed", "joint_temperatures", "actual_joint_voltage", "ft_raw_wrench",
+                           "payload_inertia"})
+    addVariable(name, WT::VECTOR6D, false);
+  for (const char *name : {"actual_tool_accelerometer", "payload_cog", "elbow_position", "elbow_velocity"})
+    addVariable(name, WT::VECTOR3D, false);
+  for (const char *name : {"actual_execution_time", "speed_scaling", "target_speed_fraction", "actual_momentum",
+                           "actual_main_voltage", "actual_robot_voltage", "actual_robot_current",
+                           "standard_analog_input0", "standard_analog_input1", "standard_analog_output0",
+                           "standard_analog_output1", "payload"})
+    addVariable(name, WT::DOUBLE, false);
+  for (const char *name : {"actual_digital_input_bits", "actual_digital_output_bits"})
+    addVariable(name, WT::UINT64, false);
+  for (const char *name : {"runtime_state", "robot_status_bits", "safety_status_bits", "output_bit_registers0_to_31",
+                           "output_bit_registers32_to_63"})
+    addVariable(name, WT::UINT32, false);
+  addVariable("robot_mode", WT::INT32, false);
+  addVariable("safety_mode", WT::INT32, false);
+  addVariable("joint_mode", WT::VECTOR6INT32, false);
+
+  for (int i = 0; i < 48; i++)
+  {
+    addVariable("output_int_register_" + std::to_string(i), WT::INT32, false);
+    addVariable("output_double_register_" + std::to_string(i), WT::DOUBLE, false);
+    addVariable("input_int_register_" + std::to_string(i), WT::INT32, true);
+    addVariable("input_double_register_" + std::to_string(i), WT::DOUBLE, true);
+    out_int_[i] = variable("output_int_register_" + std::to_string(i));
+    out_double_[i] = variable("output_double_register_" + std::to_string(i));
+    in_int_[i] = variable("input_int_register_" + std::to_string(i));
+    in_double_[i] = variable("input_double_register_" + std::to_string(i));
+  }
+
+  for (const char *name : {"input_bit_registers0_to_31", "input_bit_registers32_to_63", "speed_slider_mask"})
+    addVariable(name, WT::UINT32, true);
+  for (const char *name : {"standard_digital_output_mask", "standard_digital_output", "configurable_digital_output_mask",
+                           "configurable_digital_output", "tool_digital_output_mask", "tool_digital_output",
+                           "standard_analog_output_mask", "standard_analog_output_type"})
+    addVariable(name, WT::UINT8, true);
+  for (const char *name : {"speed_slider_fraction", "standard_analog_output_0", "standard_analog_output_1"})
+    addVariable(name, WT::DOUBLE, true);
+  addVariable("external_force_torque", WT::VECTOR6D, true);
+
+  // A powered on robot in normal mode with no program running
+  variables_["actual_q"].value = {0, -1.57, 1.57, -1.57, -1.57, 0};
+  variables_["target_q"].value = variables_["actual_q"].value;
+  variables_["actual_TCP_pose"].value = {-0.1, -0.4, 0.4, 0, 3.14, 0};
+  variables_["target_TCP_pose"].value = variables_["actual_TCP_pose"].value;
+  variables_["joint_temperatures"].value = {30, 30, 30, 30, 30, 30};
+  variables_["joint_mode"].value = {253, 253, 253, 253, 253, 253};
+  variables_["robot_mode"].value = {7};
+  variables_["safety_mode"].value = {1};
+  variables_["robot_status_bits"].value = {1};
+  variables_["safety_status_bits"].value = {1};
+  variables_["runtime_state"].value = {1};
+  variables_["speed_scaling"].value = {1};
+  variables_["target_speed_fraction"].value = {1};
+  variables_["actual_main_voltage"].value = {48};
+  variables_["actual_robot_voltage"].value = {48};
+}
+
+RTDESimulator::~RTDESimulator()
+{
+  stop();
+}
+
+void RTDESimulator::addVariable(const std::string &name, RTDE::WireType type, bool input)
+{
+  Variable var;
+  var.type = type;
+  var.value.assign(wireTypeCount(type), 0.0);
+  var.input = input;
+  variables_[name] = var;
+}
+
+double *RTDESimulator::variable(const std::string &name)
+{
+  return variables_.at(name).value.data();
+}
+
+void RTDESimulator::setControllerVersion(std::uint32_t major, std::uint32_t minor, std::uint32_t bugfix,
+                                         std::uint32_t build)
+{
+  version_[0] = major;
+  version_[1] = minor;
+  version_[2] = bugfix;
+  version_[3] = build;
+}
+
+void RTDESimulator::setPorts(int rtde_port, int script_port, int dashboard_port)
+{
+  rtde_port_ = rtde_port;
+  script_port_ = script_port;
+  dashboard_port_ = dashboard_port;
+}
+
+int RTDESimulator::listenOn(int port)
+{
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    throw std::runtime_error("RTDESimulator: unable to create socket");
+  int enable = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (::inet_pton(AF_INET, address_.c_str(), &addr.sin_addr) != 1)
+  {
+    ::close(fd);
+    throw std::invalid_argument("RTDESimulator: invalid address " + address_);
+  }
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, 8) != 0)
+  {
+    ::close(fd);
+    throw std::runtime_error("RTDESimulator: unable to listen on " + address_ + ":" + std::to_string(port) + " (" +
+                             std::strerror(errno) + ")");
+  }
+  return fd;
+}
+
+void RTDESimulator::start()
+{
+  if (running_)
+    return;
+
+  for (int port : {rtde_port_, script_port_, dashboard_port_})
+  {
+    try
+    {
+      listen_fds_.push_back(listenOn(port));
+    }
+    catch (...)
+    {
+      for (int fd : listen_fds_)
+        ::close(fd);
+      listen_fds_.clear();
+      throw;
+    }
+  }
+
+  running_ = true;
+  threads_.emplace_back(&RTDESimulator::acceptLoop, this, listen_fds_[0], rtde_port_);
+  threads_.emplace_back(&RTDESimulator::acceptLoop, this, listen_fds_[1], script_port_);
+  threads_.emplace_back(&RTDESimulator::acceptLoop, this, listen_fds_[2], dashboard_port_);
+  threads_.emplace_back(&RTDESimulator::controllerLoop, this);
+  if (verbose_)
+    std::cout << "RTDESimulator: listening on " << address_ << " at " << frequency_ << " Hz" << std::endl;
+}
+
+void RTDESimulator::stop()
+{
+  if (!running_)
+    return;
+
+  running_ = false;
+  for (auto &thread : threads_)
+    thread.join();
+  threads_.clear();
+  for (int fd : listen_fds_)
+    ::close(fd);
+  listen_fds_.clear();
+
+  std::vector<std::shared_ptr<Client>> clients;
+  std::vector<std::thread> service_threads;
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    clients.swap(clients_);
+    service_threads.swap(service_threads_);
+  }
+  for (auto &client : clients)
+  {
+    if (client->thread.joinable())
+      client->thread.join();
+  }
+  for (auto &thread : service_threads)
+    thread.join();
+}
+
+bool RTDESimulator::isRunning() const
+{
+  return running_;
+}
+
+bool RTDESimulator::isScriptRunning()
+{
+  std::lock_guard<std::mutex> lock(model_mutex_);
+  return script_running_;
+}
+
+RTDESimulator::Statistics RTDESimulator::getStatistics()
+{
+  std::lock_guard<std::mutex> lock(model_mutex_);
+  return statistics_;
+}
+
+std::vector<double> RTDESimulator::getVariable(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(model_mutex_);
+  auto it = variables_.find(name);
+  if (it == variables_.end())
+    return {};
+  return it->second.value;
+}
+
+bool RTDESimulator::setVariable(const std::string &name, const std::vector<double> &value)
+{
+  std::lock_guard<std::mutex> lock(model_mutex_);
+  auto it = variables_.find(name);
+  if (it == variables_.end() || it->second.value.size() != value.size())
+    return false;
+  std::copy(value.begin(), value.end(), it->second.value.begin());
+  return true;
+}
+
+void RTDESimulator::acceptLoop(int listen_fd, int port)
+{
+  while (running_)
+  {
+    pollfd pfd{listen_fd, POLLIN, 0};
+    if (::poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0)
+      continue;
+    int fd = ::accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+      continue;
+    int enable = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    if (verbose_)
+      std::cout << "RTDESimulator: client connected on port " << port << std::endl;
+
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    if (port == rtde_port_)
+    {
+      // Clean up clients that have disconnected
+      for (auto it = clients_.begin(); it != clients_.end();)
+      {
+        if (!(*it)->alive && (*it)->fd < 0)
+        {
+          (*it)->thread.join();
+          it = clients_.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+
+      auto client = std::make_shared<Client>();
+      client->fd = fd;
+      client->thread = std::thread(&RTDESimulator::rtdeClientLoop, this, client);
+      clients_.push_back(client);
+    }
+    else if (port == script_port_)
+    {
+      service_threads_.emplace_back(&RTDESimulator::scriptClientLoop, this, fd);
+    }
+    else
+    {
+      service_threads_.emplace_back(&RTDESimulator::dashboardClientLoop, this, fd);
+    }
+  }
+}
+
+void RTDESimulator::controllerLoop()
+{
+  const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1.0 / frequency_));
+  auto next = std::chrono::steady_clock::now();
+  while (running_)
+  {
+    next += period;
+    tick(1.0 / frequency_);
+    auto now = std::chrono::steady_clock::now();
+    if (now > next + period)
+    {
+      std::lock_guard<std::mutex> lock(model_mutex_);
+      statistics_.overruns++;
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void RTDESimulator::tick(double dt)
+{
+  std::vector<std::shared_ptr<Client>> clients;
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    clients = clients_;
+  }
+
+  std::vector<std::shared_ptr<Client>> receivers;
+  {
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    statistics_.ticks++;
+    double *timestamp = variable("timestamp");
+    *timestamp += dt;
+
+    // Joint and tool speeds are integrated, everything else is applied by the emulated control script
+    double *q = variable("actual_q");
+    double *qd = variable("actual_qd");
+    double *pose = variable("actual_TCP_pose");
+    double *speed = variable("actual_TCP_speed");
+    for (int i = 0; i < 6; i++)
+    {
+      q[i] += qd[i] * dt;
+      pose[i] += speed[i] * dt;
+    }
+    std::copy(q, q + 6, variable("target_q"));
+    std::copy(pose, pose + 6, variable("target_TCP_pose"));
+
+    // Masked writes of the standard digital outputs
+    double *mask = variable("standard_digital_output_mask");
+    if (*mask != 0)
+    {
+      auto bits = static_cast<std::uint64_t>(*variable("actual_digital_output_bits"));
+      auto mask_bits = static_cast<std::uint64_t>(*mask);
+      bits = (bits & ~mask_bits) | (static_cast<std::uint64_t>(*variable("standard_digital_output")) & mask_bits);
+      *variable("actual_digital_output_bits") = static_cast<double>(bits);
+      *mask = 0;
+    }
+
+    if (script_running_)
+      emulateScript();
+
+    for (auto &client : clients)
+    {
+      std::lock_guard<std::mutex> recipe_lock(client->recipe_mutex);
+      if (!client->alive || !client->started || (client->cycle++ % client->decimation) != 0)
+        continue;
+
+      std::vector<char> &package = client->package;
+      package.clear();
+      package.resize(HEADER_SIZE);
+      package.push_back(1);  // output recipe id
+      for (const auto &field : client->outputs)
+        putField(package, field.type, field.value);
+      uint16_t size = htons(static_cast<uint16_t>(package.size()));
+      std::memcpy(package.data(), &size, sizeof(size));
+      package[2] = static_cast<char>(RTDE::RTDE_DATA_PACKAGE);
+      receivers.push_back(client);
+    }
+    statistics_.packages_sent += receivers.size();
+  }
+
+  for (auto &client : receivers)
+  {
+    std::lock_guard<std::mutex> lock(client->write_mutex);
+    if (client->fd >= 0 && !writeFully(client->fd, client->package.data(), client->package.size()))
+      client->alive = false;
+  }
+}
+
+void RTDESimulator::emulateScript()
+{
+  // Mirrors the main loop of rtde_control.script, output_int_register 0 is 1 when ready for a command and 2 when
+  // done with the current command.
+  int cmd = static_cast<int>(*in_int_[register_offset_]);
+  bool keep_running = true;
+  if (isRealtimeCommand(cmd))
+  {
+    keep_running = processCommand(cmd);
+    *out_int_[register_offset_] = 1;
+  }
+  else if (cmd == 0)
+  {
+    executing_cmd_ = false;
+    *out_int_[register_offset_] = 1;
+  }
+  else
+  {
+    if (!executing_cmd_)
+    {
+      keep_running = processCommand(cmd);
+      if (cmd != RTDE::RobotCommand::STOP_SCRIPT)
+        *out_int_[register_offset_] = 2;
+    }
+    executing_cmd_ = true;
+  }
+
+  if (!keep_running)
+    stopScript();
+}
+
+bool RTDESimulator::processCommand(int cmd)
+{
+  statistics_.commands_processed++;
+  const int off = register_offset_;
+  auto copy_inputs = [&](const char *name)
+  {
+    double *dst = variable(name);
+    for (int i = 0; i < 6; i++)
+      dst[i] = *in_double_[off + i];
+  };
+  auto set_outputs = [&](const double *src)
+  {
+    for (int i = 0; i < 6; i++)
+      *out_double_[off + i] = src ? src[i] : 0.0;
+  };
+
+  using Cmd = RTDE::RobotCommand;
+  switch (cmd)
+  {
+    case Cmd::MOVEJ:
+    case Cmd::SERVOJ:
+      copy_inputs("actual_q");
+      std::fill_n(variable("actual_qd"), 6, 0.0);
+      break;
+    case Cmd::MOVEL:
+    case Cmd::SERVOL:
+    case Cmd::SERVOC:
+      copy_inputs("actual_TCP_pose");
+      std::fill_n(variable("actual_TCP_speed"), 6, 0.0);
+      break;
+    case Cmd::SPEEDJ:
+      copy_inputs("actual_qd");
+      break;
+    case Cmd::SPEEDL:
+      copy_inputs("actual_TCP_speed");
+      break;
+    case Cmd::SPEED_STOP:
+    case Cmd::SERVO_STOP:
+    case Cmd::STOPJ:
+    case Cmd::STOPL:
+      std::fill_n(variable("actual_qd"), 6, 0.0);
+      std::fill_n(variable("actual_TCP_speed"), 6, 0.0);
+      break;
+    case Cmd::GET_INVERSE_KINEMATICS_ARGS:
+    case Cmd::GET_INVERSE_KINEMATICS_DEFAULT:
+    case Cmd::GET_ACTUAL_JOINT_POSITIONS_HISTORY:
+      set_outputs(variable("actual_q"));
+      break;
+    case Cmd::GET_FORWARD_KINEMATICS_DEFAULT:
+    case Cmd::GET_FORWARD_KINEMATICS_ARGS:
+    case Cmd::GET_ACTUAL_TOOL_FLANGE_POSE:
+    case Cmd::GET_TARGET_WAYPOINT:
+      set_outputs(variable("actual_TCP_pose"));
+      break;
+    case Cmd::GET_TCP_OFFSET:
+    case Cmd::GET_JOINT_TORQUES:
+    case Cmd::POSE_TRANS:
+      set_outputs(nullptr);
+      break;
+    case Cmd::GET_STEPTIME:
+      *out_double_[off] = 1.0 / frequency_;
+      break;
+    case Cmd::IS_POSE_WITHIN_SAFETY_LIMITS:
+    case Cmd::IS_JOINTS_WITHIN_SAFETY_LIMITS:
+    case Cmd::IS_STEADY:
+    case Cmd::GET_INVERSE_KINEMATICS_HAS_SOLUTION_DEFAULT:
+    case Cmd::GET_INVERSE_KINEMATICS_HAS_SOLUTION_ARGS:
+      *out_int_[off + 1] = 1;
+      break;
+    case Cmd::GET_FREEDRIVE_STATUS:
+      *out_int_[off + 1] = 0;
+      break;
+    case Cmd::PATH_APPEND:
+      // The path stream accepts all waypoints, they are not executed
+      *out_int_[off + 1] = *in_int_[off + 1];
+      break;
+    case Cmd::STOP_SCRIPT:
+      return false;
+    default:
+      break;
+  }
+  return true;
+}
+
+void RTDESimulator::startScript(const std::string &script)
+{
+  int offset = script.find("reg_offset_int = 24") != std::string::npos ? 24 : 0;
+  std::lock_guard<std::mutex> lock(model_mutex_);
+  register_offset_ = offset;
+  script_running_ = true;
+  executing_cmd_ = false;
+  *variable("runtime_state") = 2;  // PLAYING
+  double *status = variable("robot_status_bits");
+  *status = static_cast<double>(static_cast<std::uint32_t>(*status) | 2u);
+  *out_int_[register_offset_] = 1;  // signal_ready()
+  if (verbose_)
+    std::cout << "RTDESimulator: control script started with register offset " << register_offset_ << std::endl;
+}
+
+void RTDESimulator::stopScript()
+{
+  script_running_ = false;
+  *variable("runtime_state") = 1;  // STOPPED
+  double *status = variable("robot_status_bits");
+  *status = static_cast<double>(static_cast<std::uint32_t>(*status) & ~2u);
+  std::fill_n(variable("actual_qd"), 6, 0.0);
+  std::fill_n(variable("actual_TCP_speed"), 6, 0.0);
+  if (verbose_)
+    std::cout << "RTDESimulator: control script stopped" << std::endl;
+}
+
+void RTDESimulator::rtdeClientLoop(std::shared_ptr<Client> client)
+{
+  std::vector<char> header(HEADER_SIZE);
+  std::vector<char> payload;
+  while (running_ && client->alive)
+  {
+    if (!readFully(client->fd, header.data(), HEADER_SIZE, running_))
+      break;
+    uint32_t offset = 0;
+    RTDEControlHeader msg_header = RTDEUtility::readRTDEHeader(header, offset);
+    if (msg_header.msg_size < HEADER_SIZE)
+      break;
+    payload.resize(msg_header.msg_size - HEADER_SIZE);
+    if (!payload.empty() && !readFully(client->fd, payload.data(), payload.size(), running_))
+      break;
+    handleRTDEMessage(client, msg_header.msg_cmd, payload);
+  }
+
+  client->alive = false;
+  std::lock_guard<std::mutex> lock(client->write_mutex);
+  ::close(client->fd);
+  client->fd = -1;
+  if (verbose_)
+    std::cout << "RTDESimulator: RTDE client disconnected" << std::endl;
+}
+
+bool RTDESimulator::sendRTDEMessage(const std::shared_ptr<Client> &client, std::uint8_t cmd,
+                                    const std::vector<char> &payload)
+{
+  std::vector<char> message(HEADER_SIZE);
+  uint16_t size = htons(static_cast<uint16_t>(HEADER_SIZE + payload.size()));
+  std::memcpy(message.data(), &size, sizeof(size));
+  message[2] = static_cast<char>(cmd);
+  message.insert(message.end(), payload.begin(), payload.end());
+  std::lock_guard<std::mutex> lock(client->write_mutex);
+  return client->fd >= 0 && writeFully(client->fd, message.data(), message.size());
+}
+
+void RTDESimulator::handleRTDEMessage(const std::shared_ptr<Client> &client, std::uint8_t cmd,
+                                      const std::vector<char> &payload)
+{
+  switch (cmd)
+  {
+    case RTDE::RTDE_REQUEST_PROTOCOL_VERSION:
+    {
+      sendRTDEMessage(client, cmd, {1});
+      break;
+    }
+
+    case RTDE::RTDE_GET_URCONTROL_VERSION:
+    {
+      std::vector<char> reply;
+      for (std::uint32_t v : version_)
+        putUInt32(reply, v);
+      sendRTDEMessage(client, cmd, reply);
+      break;
+    }
+
+    case RTDE::RTDE_CONTROL_PACKAGE_SETUP_OUTPUTS:
+    {
+      uint32_t offset = 0;
+      double frequency = payload.size() >= 8 ? RTDEUtility::getDouble(payload, offset) : frequency_;
+      std::vector<std::string> names = splitNames(std::string(payload.begin() + offset, payload.end()));
+      std::vector<Field> outputs;
+      std::string types;
+      bool all_found = true;
+      {
+        std::lock_guard<std::mutex> lock(model_mutex_);
+        for (const auto &name : names)
+        {
+          auto it = variables_.find(name);
+          if (!types.empty())
+            types += ",";
+          if (it == variables_.end())
+          {
+            types += "NOT_FOUND";
+            all_found = false;
+            continue;
+          }
+          types += wireTypeName(it->second.type);
+          outputs.push_back(Field{it->second.type, it->second.value.data()});
+        }
+      }
+
+      if (all_found)
+      {
+        std::lock_guard<std::mutex> lock(client->recipe_mutex);
+        client->outputs = outputs;
+        double ratio = frequency > 0 ? frequency_ / frequency : 1.0;
+        client->decimation = static_cast<std::uint32_t>(std::max(1.0, std::round(ratio)));
+      }
+      if (verbose_)
+        std::cout << "RTDESimulator: output setup of " << names.size() << " variables at " << frequency << " Hz"
+                  << std::endl;
+      std::vector<char> reply;
+      reply.reserve(1 + types.size());
+      reply.push_back(static_cast<char>(all_found ? 1 : 0));
+      reply.insert(reply.end(), types.begin(), types.end());
+      sendRTDEMessage(client, cmd, reply);
+      break;
+    }
+
+    case RTDE::RTDE_CONTROL_PACKAGE_SETUP_INPUTS:
+    {
+      std::vector<std::string> names = splitNames(std::string(payload.begin(), payload.end()));
+      std::vector<Field> inputs;
+      std::string types;
+      bool all_found = true;
+      {
+        std::lock_guard<std::mutex> lock(model_mutex_);
+        for (const auto &name : names)
+        {
+          auto it = variables_.find(name);
+          if (!types.empty())
+            types += ",";
+          if (it == variables_.end() || !it->second.input)
+          {
+            types += "NOT_FOUND";
+            all_found = false;
+            continue;
+          }
+          types += wireTypeName(it->second.type);
+          inputs.push_back(Field{it->second.type, it->second.value.data()});
+        }
+      }
+
+      char recipe_id = 0;
+      if (all_found)
+      {
+        std::lock_guard<std::mutex> lock(client->recipe_mutex);
+        client->input_recipes.push_back(inputs);
+        recipe_id = static_cast<char>(client->input_recipes.size());
+      }
+      std::vector<char> reply;
+      reply.reserve(1 + types.size());
+      reply.push_back(recipe_id);
+      reply.insert(reply.end(), types.begin(), types.end());
+      sendRTDEMessage(client, cmd, reply);
+      break;
+    }
+
+    case RTDE::RTDE_CONTROL_PACKAGE_START:
+    case RTDE::RTDE_CONTROL_PACKAGE_PAUSE:
+    {
+      {
+        std::lock_guard<std::mutex> lock(client->recipe_mutex);
+        client->started = cmd == RTDE::RTDE_CONTROL_PACKAGE_START;
+        client->cycle = 0;
+      }
+      sendRTDEMessage(client, cmd, {1});
+      break;
+    }
+
+    case RTDE::RTDE_DATA_PACKAGE:
+    {
+      if (payload.empty())
+        break;
+      std::size_t recipe_id = static_cast<std::uint8_t>(payload[0]);
+      std::lock_guard<std::mutex> recipe_lock(client->recipe_mutex);
+      if (recipe_id == 0 || recipe_id > client->input_recipes.size())
+      {
+        std::cerr << "RTDESimulator: data package for unknown input recipe " << recipe_id << std::endl;
+        break;
+      }
+      std::lock_guard<std::mutex> lock(model_mutex_);
+      uint32_t offset = 1;
+      for (const auto &field : client->input_recipes[recipe_id - 1])
+      {
+        if (!getField(payload, offset, field.type, field.value))
+        {
+          std::cerr << "RTDESimulator: data package for input recipe " << recipe_id << " is too short" << std::endl;
+          break;
+        }
+      }
+      statistics_.packages_received++;
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+void RTDESimulator::scriptClientLoop(int fd)
+{
+  std::string script;
+  char data[4096];
+  while (running_)
+  {
+    pollfd pfd{fd, POLLIN, 0};
+    int ret = ::poll(&pfd, 1, script.empty() ? POLL_TIMEOUT_MS : SCRIPT_IDLE_TIMEOUT_MS);
+    if (ret > 0)
+    {
+      ssize_t n = ::recv(fd, data, sizeof(data), 0);
+      if (n <= 0)
+        break;
+      script.append(data, static_cast<std::size_t>(n));
+      continue;
+    }
+
+    // The script is complete once the client has been idle for a short while
+    if (ret == 0 && !script.empty())
+    {
+      if (script.find("def ") != std::string::npos)
+        startScript(script);
+      else if (verbose_)
+        std::cout << "RTDESimulator: ignoring script command: " << script << std::endl;
+      script.clear();
+    }
+  }
+  if (running_ && script.find("def ") != std::string::npos)
+    startScript(script);
+  ::close(fd);
+}
+
+void RTDESimulator::dashboardClientLoop(int fd)
+{
+  const std::string welcome = "Connected: Universal Robots Dashboard Server\n";
+  writeFully(fd, welcome.data(), welcome.size());
+
+  std::string line;
+  char c;
+  while (running_)
+  {
+    if (!readFully(fd, &c, 1, running_))
+      break;
+    if (c != '\n')
+    {
+      line += c;
+      continue;
+    }
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    std::string reply = dashboardReply(line) + "\n";
+    if (!writeFully(fd, reply.data(), reply.size()) || line == "quit")
+      break;
+    line.clear();
+  }
+  ::close(fd);
+}
+
+std::string RTDESimulator::dashboardReply(const std::string &request)
+{
+  if (request == "PolyscopeVersion")
+    return "URSoftware " + std::to_string(version_[0]) + "." + std::to_string(version_[1]) + "." +
+           std::to_string(version_[2]) + "." + std::to_string(version_[3]) + " (simulated)";
+  if (request == "get serial number")
+    return "20235500000";
+  if (request == "get robot model")
+    return "UR5";
+  if (request == "is in remote control")
+    return "true";
+  if (request == "robotmode")
+    return "Robotmode: RUNNING";
+  if (request == "safetymode")
+    return "Safetymode: NORMAL";
+  if (request == "safetystatus")
+    return "Safetystatus: NORMAL";
+  if (request == "running")
+    return std::string("Program running: ") + (isScriptRunning() ? "true" : "false");
+  if (request == "programState")
+    return isScriptRunning() ? "PLAYING rtde_control" : "STOPPED <unnamed>";
+  if (request == "stop")
+  {
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    if (script_running_)
+      stopScript();
+    return "Stopped";
+  }
+  if (request == "play")
+    return "Starting program";
+  if (request == "pause")
+    return "Pausing program";
+  if (request == "power on")
+    return "Powering on";
+  if (request == "power off")
+    return "Powering off";
+  if (request == "brake release")
+    return "Brake releasing";
+  if (request == "unlock protective stop")
+    return "Protective stop releasing";
+  if (request == "close safety popup")
+    return "closing safety popup";
+  if (request == "close popup")
+    return "closing popup";
+  if (request == "quit")
+    return "Disconnected";
+  return "could not understand: '" + request + "'";
+}
+
+}  // namespace ur_rtde
@@ -5,10 +5,16 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/socket_base.hpp>
 #include <boost/asio/write.hpp>
+#include <cstdio>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <streambuf>
 #include <string>
+#include <utility>
 
 #include "ur_rtde/rtde_control_script.h"
 
@@ -17,22 +23,42 @@ using boost::asio::ip::tcp;
 // heart beat func =============================================================
 namespace
 {
-    template<typename ... Args>
-    std::string script_format(const std::string &format, Args ... args)
+    std::string k_heartbeat_ip = "foo";
+    std::string k_heartbeat_port = "foo";
+
+    // Substitute the heartbeat ip and port for the %s placeholders of the script, in this order. Unlike formatting
+    // the script with snprintf() this leaves every other % alone, e.g. the modulo operator.
+    void insertHeartbeatConfig(std::string &ur_script)
     {
-        int size_s = std::snprintf(nullptr, 0, format.c_str(), args ...) +
-                     1; // Extra space for '\0'
-        if (size_s <= 0)
-        { throw std::runtime_error("Error during formatting."); }
-        auto size = static_cast<size_t>( size_s );
-        std::unique_ptr<char[]> buf(new char[size]);
-        std::snprintf(buf.get(), size, format.c_str(), args ...);
-        return std::string(buf.get(), buf.get() + size -
-                                      1); // We don't want the '\0' inside
+        const std::string placeholder = "%s";
+        const std::string *values[] = {&k_heartbeat_ip, &k_heartbeat_port};
+        std::size_t pos = 0;
+        for (const std::string *value : values)
+        {
+            pos = ur_script.find(placeholder, pos);
+            if (pos == std::string::npos)
+                return;
+            ur_script.replace(pos, placeholder.size(), *value);
+            pos += value->size();
+        }
     }
 
-    std::string k_heartbeat_ip = "foo";
-    std::string k_heartbeat_port = "foo";
+    // Version filtered control scripts of all clients in the process, by (major, minor) controller version
+    std::mutex script_cache_mutex;
+    std::map<std::pair<uint32_t, uint32_t>, std::shared_ptr<const std::string>> script_cache;
+    std::string script_cache_directory;
+
+    // FNV-1a, stable across platforms and runs unlike std::hash, identifies the script a cache file was made from
+    uint64_t scriptHash(const std::string &script)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (char c : script)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
 }
 
 // =============================================================================
@@ -138,11 +164,16 @@ static bool loadScript(const std::string& file_name, std::string& str)
 
 bool ScriptClient::removeUnsupportedFunctions(std::string& ur_script)
 {
-  // Remove lines not fitting for the specific version of the controller
-  auto n = ur_script.find("$");
+  // Remove lines not fitting for the specific version of the controller. The result is built in a single pass, erasing
+  // in place would move the rest of the script for every version tag.
+  std::string filtered;
+  filtered.reserve(ur_script.size());
+  std::size_t pos = 0;
+  auto n = ur_script.find('$');
 
   while (n != std::string::npos)
   {
+    filtered.append(ur_script, pos, n - pos);
     const std::string version_str = ur_script.substr(n+1, 9);
     const std::string major_str(1, version_str.at(0));
     const std::string minor_str = version_str.substr(2, 4);
@@ -170,22 +201,16 @@ bool ScriptClient::removeUnsupportedFunctions(std::string& ur_script)
           (major_control_version_ == major_version_needed && minor_control_version_ >= minor_version_needed) ||
           (major_control_version_ == extra_major_version_needed && minor_control_version_ >= extra_minor_version_needed))
       {
-        // Keep the line
-        if (additional_version_specified)
-        {
-          ur_script.erase(n, 10);
-          ur_script.insert(n, "          ");
-        }
-        else
-        {
-          ur_script.erase(n, 5);
-          ur_script.insert(n, "     ");
-        }
+        // Keep the line, the tag is replaced by spaces to keep the indentation
+        std::size_t tag_length = additional_version_specified ? 10 : 5;
+        filtered.append(tag_length, ' ');
+        pos = std::min(n + tag_length, ur_script.size());
       }
       else
       {
         // Erase the line
-        ur_script.erase(n, ur_script.find("\n", n) - n + 1);
+        auto end_of_line = ur_script.find('\n', n);
+        pos = end_of_line == std::string::npos ? ur_script.size() : end_of_line + 1;
       }
     }
     else
@@ -194,69 +219,147 @@ bool ScriptClient::removeUnsupportedFunctions(std::string& ur_script)
       return false;
     }
 
-    n = ur_script.find("$");
+    n = ur_script.find('$', pos);
   }
+  filtered.append(ur_script, pos, std::string::npos);
+  ur_script.swap(filtered);
   return true;
 }
 
 bool ScriptClient::scanAndInjectAdditionalScriptCode(std::string& ur_script)
 {
-  unsigned long n = 0;
-  // Now scan the script for injection points where we can inject additional
-  // script code
+  ur_script = spliceScript(ur_script, std::string(), std::string());
+  return true;
+}
+
+std::string ScriptClient::spliceScript(const std::string& base_script, const std::string& prefix,
+                                       const std::string& suffix) const
+{
+  // Scan the base script for the injection points, then copy it once with the additional script code spliced in
+  std::vector<std::pair<std::size_t, const ScriptInjectItem*>> injections;
+  std::size_t size = prefix.size() + base_script.size() + suffix.size();
   for (const auto& script_injection : script_injections_)
   {
-    n = ur_script.find(script_injection.search_string);
+    auto n = base_script.find(script_injection.search_string);
     if (std::string::npos == n)
     {
       if (verbose_)
         std::cout << "script_injection [" << script_injection.search_string << "] not found in script" << std::endl;
       continue;
     }
-
-    // Now inject custom script code into the script
-    ur_script.insert(n + script_injection.search_string.length(), script_injection.inject_string);
     if (verbose_)
-    {
       std::cout << "script_injection [" << script_injection.search_string << "] found at pos " << n << std::endl;
-      std::cout << ur_script.substr(n - 100, n + script_injection.search_string.length() +
-                                                 script_injection.inject_string.length() + 100)
-                << std::endl;
-    }
+    injections.emplace_back(n + script_injection.search_string.length(), &script_injection);
+    size += script_injection.inject_string.size();
   }
-  return true;
+  std::stable_sort(injections.begin(), injections.end(),
+                   [](const std::pair<std::size_t, const ScriptInjectItem*>& a,
+                      const std::pair<std::size_t, const ScriptInjectItem*>& b) { return a.first < b.first; });
+
+  std::string ur_script;
+  ur_script.reserve(size);
+  ur_script += prefix;
+  std::size_t pos = 0;
+  for (const auto& injection : injections)
+  {
+    ur_script.append(base_script, pos, injection.first - pos);
+    ur_script += injection.second->inject_string;
+    pos = injection.first;
+  }
+  ur_script.append(base_script, pos, std::string::npos);
+  ur_script += suffix;
+  return ur_script;
 }
 
-bool ScriptClient::sendScript()
+std::shared_ptr<const std::string> ScriptClient::getBaseScript(bool& custom_script)
 {
-  std::string ur_script;
-  // If the user assigned a custom control script, then we use this one instead
-  // of the internal compiled one.
+  // A custom script file is read and filtered on every upload, it may be edited between them
+  custom_script = false;
   if (!script_file_name_.empty())
   {
+    std::string ur_script;
     // If loading fails, we fall back to the default script file
-    if (!loadScript(script_file_name_, ur_script))
+    if (loadScript(script_file_name_, ur_script))
+    {
+      if (!removeUnsupportedFunctions(ur_script))
+        return nullptr;
+      custom_script = true;
+      return std::make_shared<const std::string>(std::move(ur_script));
+    }
+    std::cerr << "Error loading custom script file. Falling back to internal script file." << std::endl;
+  }
+
+  std::lock_guard<std::mutex> lock(script_cache_mutex);
+  auto key = std::make_pair(major_control_version_, minor_control_version_);
+  auto it = script_cache.find(key);
+  if (it != script_cache.end())
+    return it->second;
+
+  std::string ur_script;
+  std::string cache_file;
+  if (!script_cache_directory.empty())
+  {
+    // The hash of the unfiltered script invalidates cache files of other library versions
+    static const uint64_t hash = scriptHash(UR_SCRIPT);
+    std::ostringstream oss;
+    oss << script_cache_directory << "/rtde_control_" << major_control_version_ << "." << minor_control_version_
+        << "_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".script";
+    cache_file = oss.str();
+    std::ifstream file(cache_file.c_str(), std::ios::binary);
+    if (file)
     {
-      std::cerr << "Error loading custom script file. Falling back to internal script file." << std::endl;
-      ur_script = std::string();
+      ur_script.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      if (verbose_)
+        std::cout << "Loaded control script from cache file " << cache_file << std::endl;
     }
   }
 
   if (ur_script.empty())
   {
-    ur_script = "def rtde_control():\n";
-    ur_script += UR_SCRIPT;
-    ur_script += "end\n";
+    ur_script = UR_SCRIPT;
+    // Remove if any, functions not supported on this version of the controller
+    if (!removeUnsupportedFunctions(ur_script))
+      return nullptr;
+    if (!cache_file.empty())
+    {
+      // Written to a temporary file first, so other processes never read a partial cache file
+      std::string temp_file = cache_file + ".tmp";
+      std::ofstream file(temp_file.c_str(), std::ios::binary | std::ios::trunc);
+      file << ur_script;
+      file.close();
+      if (!file || std::rename(temp_file.c_str(), cache_file.c_str()) != 0)
+      {
+        std::remove(temp_file.c_str());
+        if (verbose_)
+          std::cout << "Could not write the control script cache file " << cache_file << std::endl;
+      }
+    }
   }
 
-  // Remove if any, functions not supported on this version of the controller
-  if (!removeUnsupportedFunctions(ur_script))
+  auto base_script = std::make_shared<const std::string>(std::move(ur_script));
+  script_cache[key] = base_script;
+  return base_script;
+}
+
+void ScriptClient::setScriptCacheDirectory(const std::string& directory)
+{
+  std::lock_guard<std::mutex> lock(script_cache_mutex);
+  script_cache_directory = directory;
+}
+
+bool ScriptClient::sendScript()
+{
+  bool custom_script;
+  auto base_script = getBaseScript(custom_script);
+  if (base_script == nullptr)
     return false;
-  // Scan the script for injection points where additional script code can be injected.
-  scanAndInjectAdditionalScriptCode(ur_script);
+
+  // The internal script is wrapped into a program, a custom script file has to contain the program definition
+  std::string ur_script = custom_script ? spliceScript(*base_script, std::string(), std::string())
+                                        : spliceScript(*base_script, "def rtde_control():\n", "end\n");
 
   // add heartbeat variables ===================================================
-  ur_script = script_format(ur_script, k_heartbeat_ip.c_str(), k_heartbeat_port.c_str());
+  insertHeartbeatConfig(ur_script);
   // ===========================================================================
 
   if (isConnected() && !ur_script.empty())
@@ -314,31 +417,15 @@ void ScriptClient::setScriptInjection(const std::string& search_string, const st
 
 std::string ScriptClient::getScript()
 {
-  std::string ur_script;
-  // If the user assigned a custom control script, then we use this one instead
-  // of the internal compiled one.
-  if (!script_file_name_.empty())
+  bool custom_script;
+  auto base_script = getBaseScript(custom_script);
+  if (base_script == nullptr)
   {
-    // If loading fails, we fall back to the default script file
-    if (!loadScript(script_file_name_, ur_script))
-    {
-      std::cerr << "Error loading custom script file. Falling back to internal script file." << std::endl;
-      ur_script = std::string();
-    }
-  }
-
-  if (ur_script.empty())
-  {
-    ur_script = UR_SCRIPT;
-  }
-
-  // Remove if any, functions not supported on this version of the controller
-  if (!removeUnsupportedFunctions(ur_script))
     std::cerr << "Error removing unsupported functions from control script!" << std::endl;
+    return std::string();
+  }
   // Scan the script for injection points where additional script code can be injected.
-  scanAndInjectAdditionalScriptCode(ur_script);
-
-  return ur_script;
+  return spliceScript(*base_script, std::string(), std::string());
 }
 
 }  // namespace ur_rtde
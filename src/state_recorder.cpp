@@ -0,0 +1,421 @@
+#include <ur_rtde/state_recorder.h>
+
+#include <algorithm>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace ur_rtde
+{
+namespace
+{
+const char FILE_MAGIC[8] = {'U', 'R', 'R', 'T', 'D', 'R', 'E', 'C'};
+const std::uint32_t FILE_VERSION = 1;
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+// Size of a block of rows handed to the writer thread and the number of blocks, at 500 Hz the blocks buffer several
+// seconds of typical recordings while the disk is busy
+const std::size_t BLOCK_BYTES = 64 * 1024;
+const std::size_t BLOCK_COUNT = 16;
+// The sampler rechecks the stop flag at least this often while no data packages arrive
+const std::chrono::milliseconds SAMPLE_TIMEOUT(100);
+
+std::size_t elementSize(RobotState::ValueType type)
+{
+  switch (type)
+  {
+    case RobotState::ValueType::DOUBLE:
+    case RobotState::ValueType::VECTOR_DOUBLE:
+    case RobotState::ValueType::UINT64:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+template <typename T>
+void writeValue(std::ofstream &file, const T &value)
+{
+  file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readValue(std::ifstream &file, T &value)
+{
+  return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+struct RecordedVariable
+{
+  std::string name;
+  RobotState::ValueType type;
+  std::uint16_t size;
+};
+}  // namespace
+
+StateRecorder::StateRecorder(std::shared_ptr<RobotState> robot_state, const std::vector<std::string> &variables,
+                             double frequency)
+    : robot_state_(std::move(robot_state)),
+      variables_(variables),
+      frequency_(frequency),
+      row_size_(sizeof(std::uint64_t)),
+      stop_(false),
+      sampler_done_(false),
+      write_failed_(false),
+      rows_(0),
+      dropped_rows_(0)
+{
+  buildPlan();
+  for (const auto &entry : plan_)
+    row_size_ += entry.size * elementSize(entry.type);
+
+  rows_per_block_ = std::max<std::size_t>(1, BLOCK_BYTES / row_size_);
+  blocks_.resize(BLOCK_COUNT, std::vector<char>(rows_per_block_ * row_size_));
+}
+
+void StateRecorder::buildPlan()
+{
+  // The rows start with the sequence number, followed by the variables without padding
+  std::vector<RobotState::CopyEntry> plan;
+  std::size_t destination = sizeof(std::uint64_t);
+  for (const auto &name : variables_)
+  {
+    RobotState::Field field;
+    if (!RobotState::findField(name, field) || robot_state_->getStateOffset(field) < 0)
+      throw std::runtime_error("StateRecorder: unable to record " + name + ", it is not part of the robot state");
+
+    RobotState::CopyEntry entry;
+    entry.offset = robot_state_->getStateOffset(field);
+    entry.size = RobotState::fieldSize(field);
+    entry.type = RobotState::fieldType(field);
+    entry.destination = destination;
+    plan.push_back(entry);
+    destination += entry.size * elementSize(entry.type);
+  }
+  plan_.swap(plan);
+}
+
+StateRecorder::~StateRecorder()
+{
+  stop();
+}
+
+void StateRecorder::start(const std::string &filename)
+{
+  if (sampler_thread_ != nullptr)
+    throw std::logic_error("StateRecorder: recording has already been started");
+
+  file_.open(filename, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open())
+    throw std::runtime_error("StateRecorder: unable to open " + filename + " for writing");
+
+  file_.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+  writeValue(file_, FILE_VERSION);
+  writeValue(file_, BYTE_ORDER_MARK);
+  writeValue(file_, frequency_);
+  writeValue(file_, static_cast<std::uint32_t>(row_size_));
+  writeValue(file_, static_cast<std::uint32_t>(plan_.size()));
+  for (std::size_t i = 0; i < plan_.size(); i++)
+  {
+    writeValue(file_, static_cast<std::uint16_t>(variables_[i].size()));
+    file_.write(variables_[i].data(), static_cast<std::streamsize>(variables_[i].size()));
+    writeValue(file_, static_cast<std::uint8_t>(plan_[i].type));
+    writeValue(file_, plan_[i].size);
+  }
+  if (!file_)
+  {
+    file_.close();
+    throw std::runtime_error("StateRecorder: unable to write the header of " + filename);
+  }
+
+  sampler_done_ = false;
+  write_failed_ = false;
+  rows_ = 0;
+  dropped_rows_ = 0;
+  full_blocks_.clear();
+  free_blocks_.clear();
+  for (std::size_t i = 0; i < blocks_.size(); i++)
+    free_blocks_.push_back(i);
+
+  writer_thread_ = std::make_shared<boost::thread>(boost::bind(&StateRecorder::writerCallback, this));
+  startSampler();
+}
+
+void StateRecorder::startSampler()
+{
+  stop_ = false;
+  sampler_thread_ = std::make_shared<boost::thread>(boost::bind(&StateRecorder::samplerCallback, this));
+}
+
+void StateRecorder::stopSampler()
+{
+  stop_ = true;
+  sampler_thread_->join();
+  sampler_thread_.reset();
+}
+
+void StateRecorder::setRobotState(std::shared_ptr<RobotState> robot_state)
+{
+  // The writer thread keeps running, only the sampler waits on the robot state
+  bool recording = sampler_thread_ != nullptr;
+  if (recording)
+    stopSampler();
+
+  std::shared_ptr<RobotState> previous_state = robot_state_;
+  robot_state_ = std::move(robot_state);
+  try
+  {
+    buildPlan();
+  }
+  catch (const std::runtime_error &)
+  {
+    robot_state_ = previous_state;
+    if (recording)
+      startSampler();
+    throw;
+  }
+
+  if (recording)
+    startSampler();
+}
+
+bool StateRecorder::stop()
+{
+  if (sampler_thread_ == nullptr)
+    return true;
+
+  stopSampler();
+  {
+    std::lock_guard<std::mutex> lock(block_mutex_);
+    sampler_done_ = true;
+    block_cv_.notify_one();
+  }
+  writer_thread_->join();
+  writer_thread_.reset();
+
+  file_.close();
+  bool success = !write_failed_ && !file_.fail();
+  if (dropped_rows_ > 0)
+    std::cerr << "StateRecorder: dropped " << dropped_rows_ << " rows, the file could not be written fast enough"
+              << std::endl;
+  return success;
+}
+
+std::uint64_t StateRecorder::getRowCount() const
+{
+  return rows_;
+}
+
+std::uint64_t StateRecorder::getDroppedRows() const
+{
+  return dropped_rows_;
+}
+
+void StateRecorder::samplerCallback()
+{
+  std::uint64_t sequence_number = robot_state_->getSequenceNumber();
+  bool have_block = false;
+  std::size_t block = 0;
+  std::size_t row = 0;
+
+  while (!stop_)
+  {
+    if (!robot_state_->waitForState(sequence_number, SAMPLE_TIMEOUT))
+      continue;
+
+    if (!have_block)
+    {
+      std::lock_guard<std::mutex> lock(block_mutex_);
+      if (!free_blocks_.empty())
+      {
+        block = free_blocks_.front();
+        free_blocks_.pop_front();
+        have_block = true;
+        row = 0;
+      }
+    }
+    if (!have_block)
+    {
+      // Skip this state, the gap shows up in the recorded sequence numbers
+      dropped_rows_++;
+      sequence_number = robot_state_->getSequenceNumber();
+      continue;
+    }
+
+    char *destination = blocks_[block].data() + row * row_size_;
+    sequence_number = robot_state_->copyState(plan_, destination);
+    std::memcpy(destination, &sequence_number, sizeof(sequence_number));
+    rows_++;
+
+    if (++row == rows_per_block_)
+    {
+      std::lock_guard<std::mutex> lock(block_mutex_);
+      full_blocks_.emplace_back(block, row);
+      have_block = false;
+      block_cv_.notify_one();
+    }
+  }
+
+  // Hand over the partly filled block, the sampler may be restarted on another robot state
+  std::lock_guard<std::mutex> lock(block_mutex_);
+  if (have_block)
+  {
+    if (row > 0)
+      full_blocks_.emplace_back(block, row);
+    else
+      free_blocks_.push_back(block);
+  }
+  block_cv_.notify_one();
+}
+
+void StateRecorder::writerCallback()
+{
+  std::unique_lock<std::mutex> lock(block_mutex_);
+  while (true)
+  {
+    block_cv_.wait(lock, [this] { return !full_blocks_.empty() || sampler_done_; });
+    if (full_blocks_.empty())
+      break;
+
+    std::pair<std::size_t, std::size_t> full_block = full_blocks_.front();
+    full_blocks_.pop_front();
+    lock.unlock();
+
+    if (!write_failed_)
+    {
+      file_.write(blocks_[full_block.first].data(), static_cast<std::streamsize>(full_block.second * row_size_));
+      if (!file_)
+      {
+        std::cerr << "StateRecorder: writing the recording failed, the remaining rows are discarded" << std::endl;
+        write_failed_ = true;
+      }
+    }
+
+    lock.lock();
+    free_blocks_.push_back(full_block.first);
+  }
+}
+
+void StateRecorder::convertToCsv(const std::string &recording_filename, const std::string &csv_filename)
+{
+  std::ifstream recording(recording_filename, std::ios::binary);
+  if (!recording.is_open())
+    throw std::runtime_error("StateRecorder: unable to open " + recording_filename);
+
+  char magic[sizeof(FILE_MAGIC)];
+  std::uint32_t version = 0;
+  std::uint32_t byte_order_mark = 0;
+  double frequency = 0;
+  std::uint32_t row_size = 0;
+  std::uint32_t variable_count = 0;
+  if (!recording.read(magic, sizeof(magic)) || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0)
+    throw std::runtime_error("StateRecorder: " + recording_filename + " is not a binary recording");
+  if (!readValue(recording, version) || version != FILE_VERSION)
+    throw std::runtime_error("StateRecorder: unsupported recording format version " + std::to_string(version));
+  if (!readValue(recording, byte_order_mark) || byte_order_mark != BYTE_ORDER_MARK)
+    throw std::runtime_error("StateRecorder: " + recording_filename + " was recorded with a different byte order");
+  if (!readValue(recording, frequency) || !readValue(recording, row_size) || !readValue(recording, variable_count))
+    throw std::runtime_error("StateRecorder: the header of " + recording_filename + " is truncated");
+
+  std::vector<RecordedVariable> variables;
+  std::size_t expected_row_size = sizeof(std::uint64_t);
+  for (std::uint32_t i = 0; i < variable_count; i++)
+  {
+    std::uint16_t name_length = 0;
+    std::uint8_t type = 0;
+    RecordedVariable variable;
+    if (!readValue(recording, name_length))
+      throw std::runtime_error("StateRecorder: the header of " + recording_filename + " is truncated");
+    variable.name.resize(name_length);
+    if (!recording.read(&variable.name[0], name_length) || !readValue(recording, type) ||
+        !readValue(recording, variable.size))
+      throw std::runtime_error("StateRecorder: the header of " + recording_filename + " is truncated");
+    if (type > static_cast<std::uint8_t>(RobotState::ValueType::VECTOR_INT32))
+      throw std::runtime_error("StateRecorder: " + variable.name + " has an unknown type");
+    variable.type = static_cast<RobotState::ValueType>(type);
+    expected_row_size += variable.size * elementSize(variable.type);
+    variables.push_back(variable);
+  }
+  if (expected_row_size != row_size)
+    throw std::runtime_error("StateRecorder: the row size of " + recording_filename + " does not match its variables");
+
+  std::ofstream csv(csv_filename);
+  if (!csv.is_open())
+    throw std::runtime_error("StateRecorder: unable to open " + csv_filename + " for writing");
+  csv << std::fixed << std::setprecision(6);
+
+  // Same columns as a CSV recording, vectors are split into one column per element
+  for (std::size_t i = 0; i < variables.size(); i++)
+  {
+    if (i != 0)
+      csv << ",";
+    if (variables[i].size > 1)
+    {
+      for (std::uint16_t j = 0; j < variables[i].size; j++)
+        csv << (j != 0 ? "," : "") << variables[i].name << '_' << j;
+    }
+    else
+    {
+      csv << variables[i].name;
+    }
+  }
+  csv << '\n';
+
+  std::vector<char> row(row_size);
+  while (recording.read(row.data(), row_size))
+  {
+    const char *value = row.data() + sizeof(std::uint64_t);
+    for (std::size_t i = 0; i < variables.size(); i++)
+    {
+      for (std::uint16_t j = 0; j < variables[i].size; j++)
+      {
+        if (i != 0 || j != 0)
+          csv << ",";
+        switch (variables[i].type)
+        {
+          case RobotState::ValueType::DOUBLE:
+          case RobotState::ValueType::VECTOR_DOUBLE:
+          {
+            double d;
+            std::memcpy(&d, value, sizeof(d));
+            csv << d;
+            break;
+          }
+          case RobotState::ValueType::UINT64:
+          {
+            std::uint64_t u;
+            std::memcpy(&u, value, sizeof(u));
+            csv << u;
+            break;
+          }
+          case RobotState::ValueType::UINT32:
+          {
+            std::uint32_t u;
+            std::memcpy(&u, value, sizeof(u));
+            csv << u;
+            break;
+          }
+          case RobotState::ValueType::INT32:
+          case RobotState::ValueType::VECTOR_INT32:
+          {
+            std::int32_t n;
+            std::memcpy(&n, value, sizeof(n));
+            csv << n;
+            break;
+          }
+        }
+        value += elementSize(variables[i].type);
+      }
+    }
+    csv << '\n';
+  }
+
+  if (!csv)
+    throw std::runtime_error("StateRecorder: unable to write " + csv_filename);
+}
+
+}  // namespace ur_rtde
@@ -0,0 +1,333 @@
+#include <ur_rtde/pose_math.h>
+#include <ur_rtde/rtde_control_interface.h>
+#include <ur_rtde/rtde_utility.h>
+#include <ur_rtde/trajectory_streamer.h>
+
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace ur_rtde
+{
+namespace
+{
+// Setpoints within this time of a package are due in it, absorbs rounding of times given as multiples of the period
+const double TIME_EPSILON = 1e-6;
+// Without a data package for this long the connection to the controller is considered lost
+const std::chrono::milliseconds PACKAGE_TIMEOUT(100);
+// Keeps the indices of producer and consumer in separate cache lines
+const std::size_t CACHE_LINE_SIZE = 64;
+}  // namespace
+
+// Fixed size ring buffer for one producer and one consumer. One slot stays empty to tell a full from an empty buffer.
+struct TrajectoryStreamer::SetpointQueue
+{
+  explicit SetpointQueue(std::size_t capacity) : buffer(capacity + 1), head(0), tail(0)
+  {
+  }
+
+  bool push(const Setpoint &setpoint)
+  {
+    std::size_t current_tail = tail.load(std::memory_order_relaxed);
+    std::size_t next_tail = current_tail + 1 == buffer.size() ? 0 : current_tail + 1;
+    if (next_tail == head.load(std::memory_order_acquire))
+      return false;
+    buffer[current_tail] = setpoint;
+    tail.store(next_tail, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only, nullptr if empty
+  const Setpoint *front() const
+  {
+    std::size_t current_head = head.load(std::memory_order_relaxed);
+    if (current_head == tail.load(std::memory_order_acquire))
+      return nullptr;
+    return &buffer[current_head];
+  }
+
+  // Consumer only, after front() returned a setpoint
+  void pop()
+  {
+    std::size_t current_head = head.load(std::memory_order_relaxed);
+    head.store(current_head + 1 == buffer.size() ? 0 : current_head + 1, std::memory_order_release);
+  }
+
+  std::size_t size() const
+  {
+    std::size_t current_head = head.load(std::memory_order_acquire);
+    std::size_t current_tail = tail.load(std::memory_order_acquire);
+    return current_tail >= current_head ? current_tail - current_head : buffer.size() - current_head + current_tail;
+  }
+
+  std::vector<Setpoint> buffer;
+  char padding_head[CACHE_LINE_SIZE];
+  std::atomic<std::size_t> head;
+  char padding_tail[CACHE_LINE_SIZE];
+  std::atomic<std::size_t> tail;
+};
+
+TrajectoryStreamer::TrajectoryStreamer(RTDEControlInterface &rtde_control, Mode mode, std::size_t capacity,
+                                       double lookahead_time, double gain)
+    : rtde_control_(rtde_control),
+      mode_(mode),
+      lookahead_time_(lookahead_time),
+      gain_(gain),
+      delta_time_(1.0 / rtde_control.getFrequency()),
+      queue_(new SetpointQueue(capacity)),
+      finished_(false),
+      stop_(false),
+      running_(false),
+      stream_time_ns_(0),
+      cycles_(0),
+      underruns_(0),
+      max_consecutive_underruns_(0),
+      missed_packages_(0),
+      max_cycle_time_us_(0)
+{
+  if (capacity == 0)
+    throw std::invalid_argument("TrajectoryStreamer: the queue capacity must be at least 1");
+}
+
+TrajectoryStreamer::~TrajectoryStreamer()
+{
+  stop();
+}
+
+void TrajectoryStreamer::start(int cpu_core, int rt_priority)
+{
+  std::lock_guard<std::mutex> lock(thread_mutex_);
+  if (running_)
+    throw std::logic_error("TrajectoryStreamer: the streamer is already running");
+  // Join the thread of a previous trajectory, it has already exited
+  if (thread_ != nullptr)
+    thread_->join();
+
+  stop_ = false;
+  error_ = nullptr;
+  stream_time_ns_ = 0;
+  cycles_ = 0;
+  underruns_ = 0;
+  max_consecutive_underruns_ = 0;
+  missed_packages_ = 0;
+  max_cycle_time_us_ = 0;
+  running_ = true;
+  thread_ = std::make_shared<boost::thread>(
+      boost::bind(&TrajectoryStreamer::streamerCallback, this, cpu_core, rt_priority));
+}
+
+bool TrajectoryStreamer::push(const Setpoint &setpoint)
+{
+  return queue_->push(setpoint);
+}
+
+bool TrajectoryStreamer::push(double time, const std::array<double, 6> &target)
+{
+  Setpoint setpoint;
+  setpoint.time = time;
+  setpoint.target = target;
+  return queue_->push(setpoint);
+}
+
+void TrajectoryStreamer::finish()
+{
+  finished_.store(true, std::memory_order_release);
+}
+
+bool TrajectoryStreamer::waitUntilFinished(std::chrono::milliseconds timeout)
+{
+  {
+    std::unique_lock<std::mutex> lock(thread_mutex_);
+    auto thread_exited = [this] { return !running_; };
+    // wait_for() overflows the deadline with the maximum duration
+    if (timeout == std::chrono::milliseconds::max())
+      done_cv_.wait(lock, thread_exited);
+    else if (!done_cv_.wait_for(lock, timeout, thread_exited))
+      return false;
+  }
+  join();
+
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(thread_mutex_);
+    error.swap(error_);
+  }
+  if (error)
+    std::rethrow_exception(error);
+  return true;
+}
+
+void TrajectoryStreamer::stop()
+{
+  stop_.store(true, std::memory_order_release);
+  join();
+  // The streamer thread has exited, this thread can consume the remaining setpoints
+  while (queue_->front() != nullptr)
+    queue_->pop();
+}
+
+bool TrajectoryStreamer::isRunning() const
+{
+  return running_;
+}
+
+double TrajectoryStreamer::getStreamTime() const
+{
+  return static_cast<double>(stream_time_ns_.load(std::memory_order_relaxed)) * 1e-9;
+}
+
+std::size_t TrajectoryStreamer::getQueueSize() const
+{
+  return queue_->size();
+}
+
+TrajectoryStreamer::Statistics TrajectoryStreamer::getStatistics() const
+{
+  Statistics statistics;
+  statistics.cycles = cycles_.load(std::memory_order_relaxed);
+  statistics.underruns = underruns_.load(std::memory_order_relaxed);
+  statistics.max_consecutive_underruns = max_consecutive_underruns_.load(std::memory_order_relaxed);
+  statistics.missed_packages = missed_packages_.load(std::memory_order_relaxed);
+  statistics.max_cycle_time_us = max_cycle_time_us_.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+void TrajectoryStreamer::join()
+{
+  std::shared_ptr<boost::thread> thread;
+  {
+    std::lock_guard<std::mutex> lock(thread_mutex_);
+    thread.swap(thread_);
+  }
+  if (thread != nullptr)
+    thread->join();
+}
+
+void TrajectoryStreamer::streamerCallback(int cpu_core, int rt_priority)
+{
+  if (rt_priority >= 0 && !RTDEUtility::setRealtimePriority(rt_priority))
+    std::cerr << "TrajectoryStreamer: the streamer thread runs without realtime priority" << std::endl;
+  if (cpu_core >= 0)
+    RTDEUtility::setThreadAffinity(cpu_core);
+
+  std::exception_ptr error;
+  try
+  {
+    stream();
+  }
+  catch (...)
+  {
+    error = std::current_exception();
+    std::cerr << "TrajectoryStreamer: streaming stopped by an error" << std::endl;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(thread_mutex_);
+    error_ = error;
+    // The next trajectory can be finished before it is started
+    finished_ = false;
+    running_ = false;
+  }
+  done_cv_.notify_all();
+}
+
+void TrajectoryStreamer::stream()
+{
+  const std::uint64_t start_sequence = rtde_control_.getStateSequenceNumber();
+  std::uint64_t sequence = start_sequence;
+  Setpoint current;
+  bool has_current = false;
+  bool final_sent = false;
+  std::uint64_t consecutive_underruns = 0;
+
+  while (!stop_.load(std::memory_order_acquire))
+  {
+    if (!rtde_control_.waitForState(sequence, PACKAGE_TIMEOUT))
+      throw std::runtime_error("TrajectoryStreamer: no data package received from the controller");
+    auto wake_time = std::chrono::steady_clock::now();
+    std::uint64_t latest = rtde_control_.getStateSequenceNumber();
+    if (latest > sequence + 1)
+      missed_packages_.fetch_add(latest - sequence - 1, std::memory_order_relaxed);
+    sequence = latest;
+
+    // The first package after start() is at stream time 0
+    double time = static_cast<double>(sequence - start_sequence - 1) * delta_time_;
+    stream_time_ns_.store(static_cast<std::int64_t>(time * 1e9), std::memory_order_relaxed);
+
+    // Read before the queue: once finished is set all setpoints have been pushed
+    bool finished = finished_.load(std::memory_order_acquire);
+    const Setpoint *next = queue_->front();
+    while (next != nullptr && next->time <= time + TIME_EPSILON)
+    {
+      current = *next;
+      has_current = true;
+      queue_->pop();
+      next = queue_->front();
+    }
+
+    std::array<double, 6> target;
+    if (next != nullptr && has_current)
+    {
+      double alpha = (time - current.time) / (next->time - current.time);
+      if (mode_ == Mode::SERVO_L)
+      {
+        pose_math::interpolatePose(current.target.data(), next->target.data(), alpha, target.data());
+      }
+      else
+      {
+        for (std::size_t i = 0; i < target.size(); i++)
+          target[i] = current.target[i] + alpha * (next->target[i] - current.target[i]);
+      }
+      consecutive_underruns = 0;
+    }
+    else if (next == nullptr && has_current)
+    {
+      if (finished && final_sent)
+        break;
+      target = current.target;
+      if (finished)
+      {
+        final_sent = true;
+      }
+      else if (time > current.time + TIME_EPSILON)
+      {
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+        consecutive_underruns++;
+        if (consecutive_underruns > max_consecutive_underruns_.load(std::memory_order_relaxed))
+          max_consecutive_underruns_.store(consecutive_underruns, std::memory_order_relaxed);
+      }
+    }
+    else
+    {
+      // No setpoint due yet
+      if (finished && next == nullptr)
+        break;
+      continue;
+    }
+
+    sendTarget(target);
+    cycles_.fetch_add(1, std::memory_order_relaxed);
+    auto cycle_time = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wake_time).count());
+    if (cycle_time > max_cycle_time_us_.load(std::memory_order_relaxed))
+      max_cycle_time_us_.store(cycle_time, std::memory_order_relaxed);
+  }
+
+  if (has_current)
+    rtde_control_.servoStop();
+}
+
+void TrajectoryStreamer::sendTarget(const std::array<double, 6> &target)
+{
+  bool sent;
+  if (mode_ == Mode::SERVO_L)
+    sent = rtde_control_.servoL(target, 0, 0, delta_time_, lookahead_time_, gain_);
+  else
+    sent = rtde_control_.servoJ(target, 0, 0, delta_time_, lookahead_time_, gain_);
+  if (!sent)
+    throw std::runtime_error("TrajectoryStreamer: the servo command was not accepted by the controller");
+}
+
+}  // namespace ur_rtde
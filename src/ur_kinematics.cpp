@@ -0,0 +1,674 @@
+#include <ur_rtde/pose_math.h>
+#include <ur_rtde/ur_kinematics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace ur_rtde
+{
+namespace
+{
+const double PI = 3.14159265358979323846;
+// Tolerance of the closed form solution for poses at the border of the workspace
+const double IK_EPSILON = 1e-9;
+// Iterations of the nominal solution towards the calibrated model, see URKinematics::solveCalibrated()
+const int IK_CALIBRATION_ITERATIONS = 20;
+// Newton iterations refining the solutions to the calibrated model, and the residual accepted as converged. Steps
+// are limited so that a nearly singular Jacobian does not throw the iteration into another branch.
+const int IK_REFINE_ITERATIONS = 60;
+const double IK_REFINE_TOLERANCE = 1e-12;
+const double IK_REFINE_MAX_RESIDUAL = 1e-6;
+const double IK_REFINE_MAX_STEP = 0.1;
+// Calibrated solutions of different branches closer than this are the same solution
+const double IK_DUPLICATE_TOLERANCE = 1e-6;
+// With calibration, poses at the border of the nominal workspace can still be reachable. The closed form solution
+// accepts them within this margin and the refinement decides.
+const double IK_CALIBRATION_MARGIN = 1e-2;
+// Smallest number of poses worth a thread of their own in the batch functions
+const std::size_t BATCH_MIN_CHUNK = 256;
+
+// Row-major 4x4 homogeneous transformation
+typedef std::array<double, 16> Transform;
+
+const Transform IDENTITY = {{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}};
+
+Transform multiply(const Transform &a, const Transform &b)
+{
+  Transform c;
+  for (int r = 0; r < 3; r++)
+  {
+    for (int col = 0; col < 4; col++)
+    {
+      c[r * 4 + col] = a[r * 4 + 0] * b[0 + col] + a[r * 4 + 1] * b[4 + col] + a[r * 4 + 2] * b[8 + col];
+    }
+    c[r * 4 + 3] += a[r * 4 + 3];
+  }
+  c[12] = 0;
+  c[13] = 0;
+  c[14] = 0;
+  c[15] = 1;
+  return c;
+}
+
+Transform invert(const Transform &t)
+{
+  // The inverse of a rigid transformation is [R^T, -R^T p]
+  Transform inv;
+  for (int r = 0; r < 3; r++)
+  {
+    for (int col = 0; col < 3; col++)
+      inv[r * 4 + col] = t[col * 4 + r];
+    inv[r * 4 + 3] = -(t[0 * 4 + r] * t[3] + t[1 * 4 + r] * t[7] + t[2 * 4 + r] * t[11]);
+  }
+  inv[12] = 0;
+  inv[13] = 0;
+  inv[14] = 0;
+  inv[15] = 1;
+  return inv;
+}
+
+template <typename Link>
+Transform dhTransform(const Link &link, double q)
+{
+  double ct = std::cos(link.theta + q);
+  double st = std::sin(link.theta + q);
+  double a = link.a;
+  double d = link.d;
+  double ca = link.cos_alpha;
+  double sa = link.sin_alpha;
+  Transform t = {{ct, -st * ca, st * sa, a * ct, st, ct * ca, -ct * sa, a * st, 0, sa, ca, d, 0, 0, 0, 1}};
+  return t;
+}
+
+Transform poseToTransform(const double *pose)
+{
+  Transform t;
+  pose_math::poseToTransform(pose, t.data());
+  return t;
+}
+
+// Rotation vector of the rotation part of a transformation, with an angle in [0, pi]
+void rotationVector(const Transform &t, double *rotation)
+{
+  const double m[9] = {t[0], t[1], t[2], t[4], t[5], t[6], t[8], t[9], t[10]};
+  pose_math::matrixToRotationVector(m, rotation);
+}
+
+void transformToPose(const Transform &t, double *pose)
+{
+  pose_math::transformToPose(t.data(), pose);
+}
+
+double wrapAngle(double angle)
+{
+  angle = std::fmod(angle + PI, 2 * PI);
+  if (angle < 0)
+    angle += 2 * PI;
+  return angle - PI;
+}
+
+// True if the joint positions q are one of the first count solutions
+bool isDuplicate(const double *q, const double *solutions, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; i++)
+  {
+    double difference = 0;
+    for (std::size_t j = 0; j < 6; j++)
+      difference = std::max(difference, std::fabs(wrapAngle(q[j] - solutions[i * 6 + j])));
+    if (difference < IK_DUPLICATE_TOLERANCE)
+      return true;
+  }
+  return false;
+}
+
+// Solve the 6x6 system a * x = b by Gaussian elimination with partial pivoting, a and b are overwritten
+bool solve6(double a[6][6], double b[6], double x[6])
+{
+  for (int col = 0; col < 6; col++)
+  {
+    int pivot = col;
+    for (int r = col + 1; r < 6; r++)
+    {
+      if (std::fabs(a[r][col]) > std::fabs(a[pivot][col]))
+        pivot = r;
+    }
+    if (std::fabs(a[pivot][col]) < 1e-12)
+      return false;
+    if (pivot != col)
+    {
+      std::swap_ranges(a[col], a[col] + 6, a[pivot]);
+      std::swap(b[col], b[pivot]);
+    }
+    for (int r = col + 1; r < 6; r++)
+    {
+      double factor = a[r][col] / a[col][col];
+      for (int c = col; c < 6; c++)
+        a[r][c] -= factor * a[col][c];
+      b[r] -= factor * b[col];
+    }
+  }
+  for (int r = 5; r >= 0; r--)
+  {
+    double sum = b[r];
+    for (int c = r + 1; c < 6; c++)
+      sum -= a[r][c] * x[c];
+    x[r] = sum / a[r][r];
+  }
+  return true;
+}
+
+std::array<double, 6> toArray(const std::vector<double> &values, const char *name)
+{
+  if (values.size() != 6)
+  {
+    std::ostringstream oss;
+    oss << "URKinematics: " << name << " must have 6 elements, it has " << values.size();
+    throw std::invalid_argument(oss.str());
+  }
+  std::array<double, 6> result;
+  std::copy(values.begin(), values.end(), result.begin());
+  return result;
+}
+
+// Pick the solution closest to qnear, shifting each joint by whole turns towards qnear within [-2 pi, 2 pi]
+bool selectNearest(const double *solutions, std::size_t count, const double *qnear, double *q)
+{
+  double best_distance = std::numeric_limits<double>::infinity();
+  for (std::size_t i = 0; i < count; i++)
+  {
+    double candidate[6];
+    double distance = 0;
+    for (std::size_t j = 0; j < 6; j++)
+    {
+      double value = solutions[i * 6 + j];
+      value += 2 * PI * std::round((qnear[j] - value) / (2 * PI));
+      if (value > 2 * PI)
+        value -= 2 * PI;
+      else if (value < -2 * PI)
+        value += 2 * PI;
+      candidate[j] = value;
+      distance += (value - qnear[j]) * (value - qnear[j]);
+    }
+    if (distance < best_distance)
+    {
+      best_distance = distance;
+      std::copy(candidate, candidate + 6, q);
+    }
+  }
+  return count > 0;
+}
+
+// Run function(begin, end) over [0, count) split into chunks on up to the given number of threads, one of them being
+// the calling thread. 0 threads uses all hardware threads.
+template <typename Function>
+void parallelFor(std::size_t count, unsigned int threads, Function function)
+{
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t chunks = std::min<std::size_t>(threads, (count + BATCH_MIN_CHUNK - 1) / BATCH_MIN_CHUNK);
+  if (chunks <= 1)
+  {
+    function(std::size_t(0), count);
+    return;
+  }
+
+  std::size_t chunk_size = (count + chunks - 1) / chunks;
+  std::vector<std::thread> workers;
+  workers.reserve(chunks - 1);
+  for (std::size_t begin = chunk_size; begin < count; begin += chunk_size)
+    workers.emplace_back(function, begin, std::min(count, begin + chunk_size));
+  function(std::size_t(0), chunk_size);
+  for (auto &worker : workers)
+    worker.join();
+}
+
+bool parseCalibrationEntry(const std::string &content, const std::string &key, std::array<double, 6> &values)
+{
+  // The key must be followed by '=', delta_a is also the start of delta_alpha
+  std::size_t position = content.find(key);
+  while (position != std::string::npos)
+  {
+    std::size_t next = content.find_first_not_of(" \t", position + key.size());
+    if (next != std::string::npos && content[next] == '=')
+      break;
+    position = content.find(key, position + key.size());
+  }
+  if (position == std::string::npos)
+    return false;
+  std::size_t begin = content.find('[', position);
+  std::size_t end = content.find(']', begin);
+  if (begin == std::string::npos || end == std::string::npos)
+    return false;
+
+  std::string list = content.substr(begin + 1, end - begin - 1);
+  std::replace(list.begin(), list.end(), ',', ' ');
+  std::istringstream iss(list);
+  for (auto &value : values)
+  {
+    if (!(iss >> value))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+URKinematics::URKinematics(RobotModel model) : URKinematics(nominalParameters(model))
+{
+}
+
+URKinematics::URKinematics(const DHParameters &dh_parameters)
+    : nominal_(dh_parameters), parameters_(dh_parameters), calibrated_(false), tcp_(IDENTITY), tcp_inverse_(IDENTITY)
+{
+  updateLinks();
+}
+
+void URKinematics::updateLinks()
+{
+  for (std::size_t i = 0; i < 6; i++)
+  {
+    links_[i] = {parameters_.a[i], parameters_.d[i], parameters_.theta[i], std::cos(parameters_.alpha[i]),
+                 std::sin(parameters_.alpha[i])};
+    nominal_links_[i] = {nominal_.a[i], nominal_.d[i], nominal_.theta[i], std::cos(nominal_.alpha[i]),
+                         std::sin(nominal_.alpha[i])};
+  }
+}
+
+DHParameters URKinematics::nominalParameters(RobotModel model)
+{
+  DHParameters dh;
+  dh.alpha = {{PI / 2, 0, 0, PI / 2, -PI / 2, 0}};
+  dh.theta = {{0, 0, 0, 0, 0, 0}};
+  switch (model)
+  {
+    case RobotModel::UR3:
+      dh.a = {{0, -0.24365, -0.21325, 0, 0, 0}};
+      dh.d = {{0.1519, 0, 0, 0.11235, 0.08535, 0.0819}};
+      break;
+    case RobotModel::UR5:
+      dh.a = {{0, -0.425, -0.39225, 0, 0, 0}};
+      dh.d = {{0.089159, 0, 0, 0.10915, 0.09465, 0.0823}};
+      break;
+    case RobotModel::UR10:
+      dh.a = {{0, -0.612, -0.5723, 0, 0, 0}};
+      dh.d = {{0.1273, 0, 0, 0.163941, 0.1157, 0.0922}};
+      break;
+    case RobotModel::UR3e:
+      dh.a = {{0, -0.24355, -0.2132, 0, 0, 0}};
+      dh.d = {{0.15185, 0, 0, 0.13105, 0.08535, 0.0921}};
+      break;
+    case RobotModel::UR5e:
+      dh.a = {{0, -0.425, -0.3922, 0, 0, 0}};
+      dh.d = {{0.1625, 0, 0, 0.1333, 0.0997, 0.0996}};
+      break;
+    case RobotModel::UR10e:
+      dh.a = {{0, -0.6127, -0.57155, 0, 0, 0}};
+      dh.d = {{0.1807, 0, 0, 0.17415, 0.11985, 0.11655}};
+      break;
+    case RobotModel::UR16e:
+      dh.a = {{0, -0.4784, -0.36, 0, 0, 0}};
+      dh.d = {{0.1807, 0, 0, 0.17415, 0.11985, 0.11655}};
+      break;
+    case RobotModel::UR20:
+      dh.a = {{0, -0.862, -0.7287, 0, 0, 0}};
+      dh.d = {{0.2363, 0, 0, 0.201, 0.1593, 0.1543}};
+      break;
+    case RobotModel::UR30:
+      dh.a = {{0, -0.637, -0.5037, 0, 0, 0}};
+      dh.d = {{0.2363, 0, 0, 0.201, 0.1593, 0.1543}};
+      break;
+    default:
+      throw std::invalid_argument("URKinematics: Unknown robot model");
+  }
+  return dh;
+}
+
+void URKinematics::setCalibration(const DHParameters &delta)
+{
+  for (std::size_t i = 0; i < 6; i++)
+  {
+    parameters_.a[i] = nominal_.a[i] + delta.a[i];
+    parameters_.d[i] = nominal_.d[i] + delta.d[i];
+    parameters_.alpha[i] = nominal_.alpha[i] + delta.alpha[i];
+    parameters_.theta[i] = nominal_.theta[i] + delta.theta[i];
+  }
+  calibrated_ = true;
+  updateLinks();
+}
+
+void URKinematics::loadCalibration(const std::string &file_path)
+{
+  std::ifstream file(file_path);
+  if (!file)
+    throw std::runtime_error("URKinematics: Could not open calibration file " + file_path);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string content = buffer.str();
+
+  DHParameters delta;
+  if (!parseCalibrationEntry(content, "delta_theta", delta.theta) ||
+      !parseCalibrationEntry(content, "delta_a", delta.a) || !parseCalibrationEntry(content, "delta_d", delta.d) ||
+      !parseCalibrationEntry(content, "delta_alpha", delta.alpha))
+  {
+    throw std::runtime_error("URKinematics: The calibration file " + file_path +
+                             " must contain delta_theta, delta_a, delta_d and delta_alpha with 6 values each");
+  }
+  setCalibration(delta);
+}
+
+bool URKinematics::isCalibrated() const
+{
+  return calibrated_;
+}
+
+const DHParameters &URKinematics::getParameters() const
+{
+  return parameters_;
+}
+
+void URKinematics::setTcp(const std::vector<double> &tcp_offset)
+{
+  std::array<double, 6> tcp = toArray(tcp_offset, "tcp_offset");
+  tcp_ = poseToTransform(tcp.data());
+  tcp_inverse_ = invert(tcp_);
+}
+
+std::vector<double> URKinematics::forwardKinematics(const std::vector<double> &q) const
+{
+  std::array<double, 6> joints = toArray(q, "q");
+  std::vector<double> pose(6);
+  forwardKinematics(joints.data(), pose.data());
+  return pose;
+}
+
+void URKinematics::forwardKinematics(const double *q, double *pose) const
+{
+  Transform t = IDENTITY;
+  for (std::size_t i = 0; i < 6; i++)
+    t = multiply(t, dhTransform(links_[i], q[i]));
+  transformToPose(multiply(t, tcp_), pose);
+}
+
+std::vector<std::vector<double>> URKinematics::inverseKinematicsAll(const std::vector<double> &pose) const
+{
+  std::array<double, 6> target = toArray(pose, "pose");
+  double solutions[MAX_IK_SOLUTIONS * 6];
+  std::size_t count = inverseKinematics(target.data(), solutions);
+
+  std::vector<std::vector<double>> result;
+  for (std::size_t i = 0; i < count; i++)
+    result.emplace_back(solutions + i * 6, solutions + i * 6 + 6);
+  return result;
+}
+
+std::vector<double> URKinematics::inverseKinematics(const std::vector<double> &pose,
+                                                    const std::vector<double> &qnear) const
+{
+  std::array<double, 6> target = toArray(pose, "pose");
+  std::array<double, 6> near = toArray(qnear, "qnear");
+  double solutions[MAX_IK_SOLUTIONS * 6];
+  std::size_t count = inverseKinematics(target.data(), solutions);
+
+  std::vector<double> q(6);
+  if (!selectNearest(solutions, count, near.data(), q.data()))
+    q.clear();
+  return q;
+}
+
+bool URKinematics::inverseKinematicsHasSolution(const std::vector<double> &pose) const
+{
+  std::array<double, 6> target = toArray(pose, "pose");
+  double solutions[MAX_IK_SOLUTIONS * 6];
+  return inverseKinematics(target.data(), solutions) > 0;
+}
+
+std::size_t URKinematics::inverseKinematics(const double *pose, double *solutions) const
+{
+  const Transform flange = multiply(poseToTransform(pose), tcp_inverse_);
+  std::size_t count = 0;
+  for (int branch = 0; branch < static_cast<int>(MAX_IK_SOLUTIONS); branch++)
+  {
+    double *q = solutions + count * 6;
+    if (!calibrated_)
+    {
+      if (solveNominal(flange.data(), branch, IK_EPSILON, nullptr, q))
+        count++;
+      continue;
+    }
+    // Close to singularities the iteration of two branches can end in the same solution. Newton iterations straight
+    // from the nominal solution of the branch then usually find the missing one.
+    for (int iterations : {IK_CALIBRATION_ITERATIONS, 1})
+    {
+      if (solveCalibrated(pose, flange.data(), branch, iterations, q) && !isDuplicate(q, solutions, count))
+      {
+        count++;
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+bool URKinematics::solveNominal(const double *flange_transform, int branch, double margin, const double *near,
+                               double *q) const
+{
+  // The closed form solution of the nominal geometry: joints 2, 3 and 4 rotate about parallel axes and the last
+  // three axes intersect pairwise, see the UR documentation of the DH parameters. The branch selects shoulder
+  // left/right (bit 2), wrist flipped or not (bit 1) and elbow up/down (bit 0). With near, the wrist is flipped or
+  // not as is closer to near instead, which follows a solution across the wrist singularity.
+  auto distance = [&](double value, std::size_t joint) {
+    double difference = wrapAngle(value - nominal_.theta[joint] - near[joint]);
+    return difference * difference;
+  };
+  Transform flange;
+  std::copy(flange_transform, flange_transform + 16, flange.begin());
+  const auto &a = nominal_.a;
+  const auto &d = nominal_.d;
+  const auto &links = nominal_links_;
+
+  // Shoulder: the wrist center (origin of frame 5) is offset by d4 from the plane of the arm
+  double p05x = flange[3] - d[5] * flange[2];
+  double p05y = flange[7] - d[5] * flange[6];
+  double radius = std::hypot(p05x, p05y);
+  if (radius < IK_EPSILON || std::fabs(d[3]) > radius * (1 + margin))
+    return false;
+  double psi = std::atan2(p05y, p05x);
+  double phi = std::acos(std::max(-1.0, std::min(1.0, d[3] / radius)));
+  double q1 = psi + ((branch & 4) == 0 ? phi : -phi) + PI / 2;
+  double s1 = std::sin(q1);
+  double c1 = std::cos(q1);
+
+  // Wrist 2 from the offset of the tool flange along the joint 1 z axis
+  double c5 = (flange[3] * s1 - flange[7] * c1 - d[3]) / d[5];
+  if (std::fabs(c5) > 1 + margin)
+    return false;
+  double q5_abs = std::acos(std::max(-1.0, std::min(1.0, c5)));
+  double s5_abs = std::sin(q5_abs);
+
+  // Wrist 3 from the orientation, arbitrary when the wrist is singular (joints 4 and 6 aligned). Flipping the wrist
+  // negates joint 5 and turns joint 6 by pi.
+  double q6_abs = 0;
+  if (std::fabs(s5_abs) > IK_EPSILON)
+    q6_abs = std::atan2((-flange[1] * s1 + flange[5] * c1) / s5_abs, (flange[0] * s1 - flange[4] * c1) / s5_abs);
+  bool unflipped = near == nullptr ? (branch & 2) == 0
+                                   : distance(q5_abs, 4) + distance(q6_abs, 5) <=
+                                         distance(-q5_abs, 4) + distance(q6_abs + PI, 5);
+  double q5 = unflipped ? q5_abs : -q5_abs;
+  double q6 = unflipped || std::fabs(s5_abs) <= IK_EPSILON ? q6_abs : q6_abs + PI;
+
+  // Shoulder, elbow and wrist 1 form a planar arm in frame 1
+  Transform t01 = dhTransform(links[0], q1);
+  Transform t46 = multiply(dhTransform(links[4], q5), dhTransform(links[5], q6));
+  Transform t14 = multiply(multiply(invert(t01), flange), invert(t46));
+  double x = t14[3];
+  double y = t14[7];
+  double c3 = (x * x + y * y - a[1] * a[1] - a[2] * a[2]) / (2 * a[1] * a[2]);
+  if (std::fabs(c3) > 1 + margin)
+    return false;
+  double q3_abs = std::acos(std::max(-1.0, std::min(1.0, c3)));
+  double q3 = (branch & 1) == 0 ? q3_abs : -q3_abs;
+  double q2 = std::atan2(y, x) - std::atan2(a[2] * std::sin(q3), a[1] + a[2] * std::cos(q3));
+  Transform t13 = multiply(dhTransform(links[1], q2), dhTransform(links[2], q3));
+  Transform t34 = multiply(invert(t13), t14);
+  double q4 = std::atan2(t34[4], t34[0]);
+
+  q[0] = q1;
+  q[1] = q2;
+  q[2] = q3;
+  q[3] = q4;
+  q[4] = q5;
+  q[5] = q6;
+  for (std::size_t j = 0; j < 6; j++)
+    q[j] = wrapAngle(q[j] - nominal_.theta[j]);
+  return true;
+}
+
+bool URKinematics::solveCalibrated(const double *pose, const double *flange_transform, int branch, int iterations,
+                                   double *q) const
+{
+  // The calibrated flange differs from the nominal one by a small transformation E(q) = nominal(q)^-1 calibrated(q)
+  // that changes slowly with q. Solving the nominal geometry for flange * E(q)^-1 of the previous solution converges
+  // to the calibrated solution of the branch. Close to the wrist singularity the calibrated solution can lie on the
+  // other side of the nominal one, which flips joint 5 and turns joints 4 and 6 by pi, so the iteration follows the
+  // previous solution there instead of the branch. Newton iterations from the nominal solution of the flange instead
+  // can jump to another branch or stall close to singularities.
+  Transform flange;
+  std::copy(flange_transform, flange_transform + 16, flange.begin());
+  Transform corrected = flange;
+  double previous[6];
+  for (int iteration = 0; iteration < iterations; iteration++)
+  {
+    // The first solution only seeds the iteration, a pose just outside the nominal workspace is clamped to it
+    double margin = iteration == 0 ? HUGE_VAL : IK_CALIBRATION_MARGIN;
+    // Follow the previous solution across the wrist singularity, unless it is singular itself when it was clamped
+    const double *near =
+        iteration > 0 && std::fabs(std::sin(previous[4] + nominal_.theta[4])) > IK_EPSILON ? previous : nullptr;
+    if (!solveNominal(corrected.data(), branch, margin, near, q))
+      return false;
+    if (iteration > 0)
+    {
+      double change = 0;
+      for (std::size_t j = 0; j < 6; j++)
+        change = std::max(change, std::fabs(wrapAngle(q[j] - previous[j])));
+      if (change < IK_REFINE_TOLERANCE)
+        break;
+    }
+    std::copy(q, q + 6, previous);
+
+    Transform nominal = IDENTITY;
+    Transform calibrated = IDENTITY;
+    for (std::size_t i = 0; i < 6; i++)
+    {
+      nominal = multiply(nominal, dhTransform(nominal_links_[i], q[i]));
+      calibrated = multiply(calibrated, dhTransform(links_[i], q[i]));
+    }
+    corrected = multiply(flange, multiply(invert(calibrated), nominal));
+  }
+  // Newton iterations remove what is left and decide whether the calibrated model reaches the pose
+  return refine(pose, q);
+}
+
+bool URKinematics::refine(const double *pose, double *q) const
+{
+  // Newton iterations on the calibrated model, starting from the solution of solveCalibrated(). The columns of the
+  // geometric Jacobian are z_i x (p - p_i) and z_i of the joint axes.
+  const Transform target = poseToTransform(pose);
+  double residual = std::numeric_limits<double>::infinity();
+  for (int iteration = 0; iteration < IK_REFINE_ITERATIONS; iteration++)
+  {
+    Transform frames[7];
+    frames[0] = IDENTITY;
+    for (std::size_t i = 0; i < 6; i++)
+    {
+      frames[i + 1] = multiply(frames[i], dhTransform(links_[i], q[i]));
+    }
+    Transform tool = multiply(frames[6], tcp_);
+
+    double error[6];
+    error[0] = target[3] - tool[3];
+    error[1] = target[7] - tool[7];
+    error[2] = target[11] - tool[11];
+    // Orientation error as the rotation vector of target * tool^T, in the base frame
+    Transform rotation_error = multiply(target, invert(tool));
+    rotationVector(rotation_error, error + 3);
+
+    residual = 0;
+    for (double e : error)
+      residual += e * e;
+    if (residual < IK_REFINE_TOLERANCE * IK_REFINE_TOLERANCE)
+      break;
+
+    double jacobian[6][6];
+    for (std::size_t i = 0; i < 6; i++)
+    {
+      const Transform &frame = frames[i];
+      double zx = frame[2], zy = frame[6], zz = frame[10];
+      double px = tool[3] - frame[3], py = tool[7] - frame[7], pz = tool[11] - frame[11];
+      jacobian[0][i] = zy * pz - zz * py;
+      jacobian[1][i] = zz * px - zx * pz;
+      jacobian[2][i] = zx * py - zy * px;
+      jacobian[3][i] = zx;
+      jacobian[4][i] = zy;
+      jacobian[5][i] = zz;
+    }
+    double step[6];
+    if (!solve6(jacobian, error, step))
+      return false;
+    double largest = 0;
+    for (double s : step)
+      largest = std::max(largest, std::fabs(s));
+    double scale = largest > IK_REFINE_MAX_STEP ? IK_REFINE_MAX_STEP / largest : 1.0;
+    for (std::size_t j = 0; j < 6; j++)
+      q[j] += scale * step[j];
+  }
+
+  for (std::size_t j = 0; j < 6; j++)
+    q[j] = wrapAngle(q[j]);
+  return residual < IK_REFINE_MAX_RESIDUAL * IK_REFINE_MAX_RESIDUAL;
+}
+
+void URKinematics::forwardKinematicsBatch(const double *q, std::size_t count, double *poses,
+                                          unsigned int threads) const
+{
+  parallelFor(count, threads, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++)
+      forwardKinematics(q + i * 6, poses + i * 6);
+  });
+}
+
+void URKinematics::inverseKinematicsBatch(const double *poses, const double *qnear, std::size_t count, double *q,
+                                          std::uint8_t *found, unsigned int threads) const
+{
+  parallelFor(count, threads, [&](std::size_t begin, std::size_t end) {
+    double solutions[MAX_IK_SOLUTIONS * 6];
+    for (std::size_t i = begin; i < end; i++)
+    {
+      std::size_t solution_count = inverseKinematics(poses + i * 6, solutions);
+      found[i] = selectNearest(solutions, solution_count, qnear, q + i * 6) ? 1 : 0;
+      if (!found[i])
+        std::fill(q + i * 6, q + i * 6 + 6, std::numeric_limits<double>::quiet_NaN());
+    }
+  });
+}
+
+void URKinematics::inverseKinematicsAllBatch(const double *poses, std::size_t count, double *solutions,
+                                             std::uint8_t *solution_counts, unsigned int threads) const
+{
+  parallelFor(count, threads, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++)
+    {
+      double *pose_solutions = solutions + i * MAX_IK_SOLUTIONS * 6;
+      std::size_t solution_count = inverseKinematics(poses + i * 6, pose_solutions);
+      solution_counts[i] = static_cast<std::uint8_t>(solution_count);
+      std::fill(pose_solutions + solution_count * 6, pose_solutions + MAX_IK_SOLUTIONS * 6,
+                std::numeric_limits<double>::quiet_NaN());
+    }
+  });
+}
+
+}  // namespace ur_rtde
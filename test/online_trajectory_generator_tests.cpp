@@ -0,0 +1,139 @@
+#include <ur_rtde/online_trajectory_generator.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "doctest.h"
+
+using namespace ur_rtde;
+
+namespace
+{
+const double LIMIT_TOLERANCE = 1e-9;
+
+struct MoveResult
+{
+  bool finished = false;
+  int cycles = 0;
+  double velocity_excess = 0;
+  double acceleration_excess = 0;
+  double jerk_excess = 0;
+  double overshoot = 0;
+};
+
+// Run a rest to rest move until the generator reports the target reached, checking the limits in every cycle
+MoveResult move(OnlineTrajectoryGenerator &otg, const std::vector<double> &start, const std::vector<double> &target,
+                double velocity, double acceleration, double jerk, int max_cycles)
+{
+  MoveResult result;
+  const double dt = otg.getDeltaTime();
+  otg.reset(start);
+  otg.setTarget(target);
+  std::array<double, 6> previous_acceleration = otg.getAcceleration();
+  while (result.cycles < max_cycles && !result.finished)
+  {
+    result.finished = otg.update();
+    result.cycles++;
+    for (std::size_t i = 0; i < 6; i++)
+    {
+      const double a = otg.getAcceleration()[i];
+      result.velocity_excess = std::max(result.velocity_excess, std::fabs(otg.getVelocity()[i]) - velocity);
+      result.acceleration_excess = std::max(result.acceleration_excess, std::fabs(a) - acceleration);
+      result.jerk_excess = std::max(result.jerk_excess, std::fabs(a - previous_acceleration[i]) / dt - jerk);
+      // Distance beyond the target in the direction of the move
+      double direction = target[i] >= start[i] ? 1.0 : -1.0;
+      result.overshoot = std::max(result.overshoot, direction * (otg.getPosition()[i] - target[i]));
+      previous_acceleration[i] = a;
+    }
+  }
+  return result;
+}
+}  // namespace
+
+SCENARIO("Online trajectories settle on the target")
+{
+  GIVEN("A generator with a moderate jerk limit")
+  {
+    OnlineTrajectoryGenerator otg(0.002, 1.0, 2.0, 100.0);
+
+    WHEN("A single joint moves from rest to rest")
+    {
+      std::vector<double> target = {0.5, 0, 0, 0, 0, 0};
+      MoveResult result = move(otg, std::vector<double>(6, 0.0), target, 1.0, 2.0, 100.0, 5000);
+
+      THEN("The joint stops exactly on the target")
+      {
+        REQUIRE(result.finished);
+        CHECK(otg.isTargetReached());
+        CHECK(otg.getPosition()[0] == target[0]);
+        CHECK(otg.getVelocity()[0] == 0.0);
+        CHECK(otg.getAcceleration()[0] == 0.0);
+        CHECK(otg.update());
+      }
+    }
+  }
+
+  GIVEN("Generators with random limits")
+  {
+    std::mt19937 rng(20);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    WHEN("Random rest to rest moves are generated")
+    {
+      const int moves = 100;
+      int unfinished = 0;
+      int missed = 0;
+      double velocity_excess = 0;
+      double acceleration_excess = 0;
+      double jerk_excess = 0;
+      double overshoot = 0;
+      for (int k = 0; k < moves; k++)
+      {
+        const double dt = uniform(rng) < 0.5 ? 0.002 : 0.008;
+        const double velocity = 0.2 + 2.8 * uniform(rng);
+        const double acceleration = 0.5 + 9.5 * uniform(rng);
+        const double jerk = 5.0 + 995.0 * uniform(rng) * uniform(rng);
+        OnlineTrajectoryGenerator otg(dt, velocity, acceleration, jerk);
+
+        std::vector<double> start(6);
+        std::vector<double> target(6);
+        for (std::size_t i = 0; i < 6; i++)
+        {
+          start[i] = -3.0 + 6.0 * uniform(rng);
+          target[i] = -3.0 + 6.0 * uniform(rng);
+        }
+
+        // Twice the time of a move that accelerates, cruises and brakes one after the other, plus a second
+        const double duration = 2 * (6.0 / velocity + 2 * velocity / acceleration + 2 * acceleration / jerk) + 1.0;
+        MoveResult result = move(otg, start, target, velocity, acceleration, jerk, static_cast<int>(duration / dt));
+        if (!result.finished)
+        {
+          unfinished++;
+          continue;
+        }
+        for (std::size_t i = 0; i < 6; i++)
+        {
+          if (otg.getPosition()[i] != target[i] || otg.getVelocity()[i] != 0.0)
+            missed++;
+        }
+        velocity_excess = std::max(velocity_excess, result.velocity_excess);
+        acceleration_excess = std::max(acceleration_excess, result.acceleration_excess);
+        jerk_excess = std::max(jerk_excess, result.jerk_excess);
+        overshoot = std::max(overshoot, result.overshoot);
+      }
+
+      THEN("Every move finishes on the target within the limits")
+      {
+        CHECK(unfinished == 0);
+        CHECK(missed == 0);
+        CHECK(velocity_excess <= LIMIT_TOLERANCE);
+        CHECK(acceleration_excess <= LIMIT_TOLERANCE);
+        CHECK(jerk_excess <= LIMIT_TOLERANCE);
+        CHECK(overshoot <= LIMIT_TOLERANCE);
+      }
+    }
+  }
+}
@@ -0,0 +1,256 @@
+#include <ur_rtde/pose_math.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "doctest.h"
+
+using namespace ur_rtde;
+
+namespace
+{
+const double PI = 3.14159265358979323846;
+const double TOLERANCE = 1e-9;
+
+typedef std::vector<double> Matrix;
+
+// Row-major 4x4 transformation of a pose with the Rodrigues formula, independent of the quaternions of pose_math
+Matrix transform(const std::vector<double> &pose)
+{
+  double angle = std::sqrt(pose[3] * pose[3] + pose[4] * pose[4] + pose[5] * pose[5]);
+  double x = 0, y = 0, z = 1;
+  if (angle > 0)
+  {
+    x = pose[3] / angle;
+    y = pose[4] / angle;
+    z = pose[5] / angle;
+  }
+  double c = std::cos(angle), s = std::sin(angle), t = 1 - c;
+  return {t * x * x + c,     t * x * y - s * z, t * x * z + s * y, pose[0], t * x * y + s * z, t * y * y + c,
+          t * y * z - s * x, pose[1],           t * x * z - s * y, t * y * z + s * x, t * z * z + c,     pose[2],
+          0,                 0,                 0,                 1};
+}
+
+Matrix multiply(const Matrix &a, const Matrix &b)
+{
+  Matrix c(16, 0.0);
+  for (int r = 0; r < 4; r++)
+    for (int col = 0; col < 4; col++)
+      for (int k = 0; k < 4; k++)
+        c[r * 4 + col] += a[r * 4 + k] * b[k * 4 + col];
+  return c;
+}
+
+double difference(const Matrix &a, const Matrix &b)
+{
+  double result = 0;
+  for (std::size_t i = 0; i < a.size(); i++)
+    result = std::max(result, std::fabs(a[i] - b[i]));
+  return result;
+}
+
+double rotationAngle(const std::vector<double> &pose)
+{
+  return std::sqrt(pose[3] * pose[3] + pose[4] * pose[4] + pose[5] * pose[5]);
+}
+
+// Random poses, half of them with rotations within 1e-6 of pi, some beyond pi
+std::vector<std::vector<double>> randomPoses(std::mt19937 &rng, int count)
+{
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<std::vector<double>> poses;
+  for (int i = 0; i < count; i++)
+  {
+    std::vector<double> pose(6);
+    for (auto &value : pose)
+      value = uniform(rng);
+    double angle = rotationAngle(pose);
+    double target = i % 2 == 0 ? PI * (1 + uniform(rng)) : PI + 1e-6 * uniform(rng);
+    for (std::size_t j = 3; j < 6; j++)
+      pose[j] *= target / angle;
+    poses.push_back(pose);
+  }
+  // Exactly pi about the axes, where the rotation vector changes sign
+  poses.push_back({0.1, 0.2, 0.3, PI, 0, 0});
+  poses.push_back({-0.3, 0.2, -0.1, 0, -PI, 0});
+  poses.push_back({0.5, -0.5, 0.5, 0, 0, PI});
+  return poses;
+}
+}  // namespace
+
+SCENARIO("Pose algebra matches the homogeneous transformations")
+{
+  GIVEN("Random poses with rotations up to two pi")
+  {
+    std::mt19937 rng(18);
+    const std::vector<std::vector<double>> poses = randomPoses(rng, 200);
+    const Matrix identity = transform(std::vector<double>(6, 0.0));
+
+    WHEN("Poses are transformed, inverted, added, subtracted and interpolated")
+    {
+      double trans_error = 0;
+      double inverse_error = 0;
+      double add_error = 0;
+      double sub_error = 0;
+      double interpolate_error = 0;
+      double max_angle = 0;
+      for (std::size_t i = 0; i + 1 < poses.size(); i++)
+      {
+        const std::vector<double> &a = poses[i];
+        const std::vector<double> &b = poses[i + 1];
+        const Matrix ta = transform(a);
+        const Matrix tb = transform(b);
+
+        std::vector<double> trans = pose_math::poseTrans(a, b);
+        trans_error = std::max(trans_error, difference(transform(trans), multiply(ta, tb)));
+
+        std::vector<double> inverse = pose_math::poseInv(a);
+        inverse_error = std::max(inverse_error, difference(multiply(transform(inverse), ta), identity));
+        inverse_error = std::max(inverse_error, difference(transform(pose_math::poseTrans(a, inverse)), identity));
+
+        // pose_add adds the positions and composes the rotations in the base frame
+        std::vector<double> sum = pose_math::poseAdd(a, b);
+        Matrix rotation = multiply(ta, tb);
+        for (int r = 0; r < 3; r++)
+          rotation[r * 4 + 3] = a[r] + b[r];
+        add_error = std::max(add_error, difference(transform(sum), rotation));
+        sub_error = std::max(sub_error, difference(transform(pose_math::poseSub(sum, b)), ta));
+
+        // Halfway the rotation from a to b is the same as from the middle to b
+        std::vector<double> middle = pose_math::interpolatePose(a, b, 0.5);
+        Matrix first_half = multiply(transform(pose_math::poseInv(a)), transform(middle));
+        Matrix second_half = multiply(transform(pose_math::poseInv(middle)), tb);
+        for (int r = 0; r < 3; r++)
+        {
+          first_half[r * 4 + 3] = 0;
+          second_half[r * 4 + 3] = 0;
+          interpolate_error = std::max(interpolate_error, std::fabs(middle[r] - (a[r] + b[r]) / 2));
+        }
+        interpolate_error = std::max(interpolate_error, difference(first_half, second_half));
+        interpolate_error = std::max(interpolate_error,
+                                     difference(transform(pose_math::interpolatePose(a, b, 0.0)), ta));
+        interpolate_error = std::max(interpolate_error,
+                                     difference(transform(pose_math::interpolatePose(a, b, 1.0)), tb));
+
+        for (const auto &result : {trans, inverse, sum, middle})
+          max_angle = std::max(max_angle, rotationAngle(result));
+      }
+
+      THEN("The results match the matrix products and have rotation angles up to pi")
+      {
+        CHECK(trans_error < TOLERANCE);
+        CHECK(inverse_error < TOLERANCE);
+        CHECK(add_error < TOLERANCE);
+        CHECK(sub_error < TOLERANCE);
+        CHECK(interpolate_error < TOLERANCE);
+        CHECK(max_angle <= PI + TOLERANCE);
+      }
+    }
+
+    WHEN("The result is written over an argument")
+    {
+      int different = 0;
+      for (std::size_t i = 0; i + 1 < poses.size(); i++)
+      {
+        const std::vector<double> &a = poses[i];
+        const std::vector<double> &b = poses[i + 1];
+        std::vector<double> expected = pose_math::poseTrans(a, b);
+        std::vector<double> first = a;
+        std::vector<double> second = b;
+        pose_math::poseTrans(first.data(), b.data(), first.data());
+        pose_math::poseTrans(a.data(), second.data(), second.data());
+        different += first != expected || second != expected;
+
+        expected = pose_math::poseInv(a);
+        first = a;
+        pose_math::poseInv(first.data(), first.data());
+        different += first != expected;
+
+        expected = pose_math::poseAdd(a, b);
+        first = a;
+        second = b;
+        pose_math::poseAdd(first.data(), b.data(), first.data());
+        pose_math::poseAdd(a.data(), second.data(), second.data());
+        different += first != expected || second != expected;
+
+        expected = pose_math::poseSub(a, b);
+        first = a;
+        second = b;
+        pose_math::poseSub(first.data(), b.data(), first.data());
+        pose_math::poseSub(a.data(), second.data(), second.data());
+        different += first != expected || second != expected;
+
+        expected = pose_math::interpolatePose(a, b, 0.3);
+        first = a;
+        second = b;
+        pose_math::interpolatePose(first.data(), b.data(), 0.3, first.data());
+        pose_math::interpolatePose(a.data(), second.data(), 0.3, second.data());
+        different += first != expected || second != expected;
+      }
+
+      std::vector<double> batch;
+      for (const auto &pose : poses)
+        batch.insert(batch.end(), pose.begin(), pose.end());
+      pose_math::poseTransBatch(poses[0].data(), batch.data(), poses.size(), batch.data());
+      for (std::size_t i = 0; i < poses.size(); i++)
+        different += std::vector<double>(batch.begin() + i * 6, batch.begin() + i * 6 + 6) !=
+                     pose_math::poseTrans(poses[0], poses[i]);
+
+      THEN("The results are the same as into separate memory")
+      {
+        CHECK(different == 0);
+      }
+    }
+  }
+
+  GIVEN("Rotations close to pi")
+  {
+    WHEN("They are converted to matrices and back")
+    {
+      double error = 0;
+      double max_angle = 0;
+      for (double offset : {-1e-6, -1e-12, 0.0, 1e-12, 1e-6})
+      {
+        for (const std::vector<double> &axis : {std::vector<double>{1, 0, 0}, std::vector<double>{0, 0.6, -0.8},
+                                                std::vector<double>{-0.48, 0.6, 0.64}})
+        {
+          std::vector<double> pose(6, 0.0);
+          for (std::size_t j = 0; j < 3; j++)
+            pose[3 + j] = (PI + offset) * axis[j];
+          std::vector<double> rotation(pose.begin() + 3, pose.end());
+          std::vector<double> back = pose_math::matrixToRotationVector(pose_math::rotationVectorToMatrix(rotation));
+          std::vector<double> result = {0, 0, 0, back[0], back[1], back[2]};
+          error = std::max(error, difference(transform(result), transform(pose)));
+          max_angle = std::max(max_angle, rotationAngle(result));
+
+          std::vector<double> quaternion = pose_math::rotationVectorToQuaternion(rotation);
+          back = pose_math::quaternionToRotationVector(quaternion);
+          result = {0, 0, 0, back[0], back[1], back[2]};
+          error = std::max(error, difference(transform(result), transform(pose)));
+          max_angle = std::max(max_angle, rotationAngle(result));
+        }
+      }
+
+      THEN("The rotation is kept with an angle up to pi")
+      {
+        CHECK(error < TOLERANCE);
+        CHECK(max_angle <= PI + TOLERANCE);
+      }
+    }
+  }
+
+  GIVEN("Vectors of the wrong size")
+  {
+    THEN("The functions throw")
+    {
+      CHECK_THROWS_AS(pose_math::poseTrans({0, 0, 0}, std::vector<double>(6)), std::invalid_argument);
+      CHECK_THROWS_AS(pose_math::poseInv(std::vector<double>(7)), std::invalid_argument);
+      CHECK_THROWS_AS(pose_math::interpolatePose(std::vector<double>(6), std::vector<double>(5), 0.5),
+                      std::invalid_argument);
+      CHECK_THROWS_AS(pose_math::quaternionToRotationVector(std::vector<double>(3)), std::invalid_argument);
+    }
+  }
+}
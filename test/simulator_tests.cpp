@@ -0,0 +1,416 @@
+#include <ur_rtde/rtde_control_interface.h>
+#include <ur_rtde/rtde_receive_interface.h>
+#include <ur_rtde/rtde_session.h>
+#include <ur_rtde/rtde_simulator.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+
+using namespace ur_rtde;
+using namespace std::chrono;
+
+namespace
+{
+// The control interface skips the remote control check of the dashboard for this address
+const std::string SIMULATOR_HOST = "127.0.0.1";
+const std::string HEARTBEAT_PORT = "50009";
+
+// All scenarios share one simulator listening on the default ports of a controller
+RTDESimulator &simulator()
+{
+  static RTDESimulator sim(SIMULATOR_HOST);
+  if (!sim.isRunning())
+    sim.start();
+  return sim;
+}
+
+// Wait until the receive interface has received a few data packages sent after the simulator was changed
+void waitForPackages(RTDEReceiveInterface &rtde_receive, std::uint64_t packages = 3)
+{
+  std::uint64_t sequence_number = rtde_receive.getStateSequenceNumber() + packages;
+  while (rtde_receive.getStateSequenceNumber() < sequence_number)
+    REQUIRE(rtde_receive.waitForNextState());
+}
+
+std::vector<std::string> splitCsv(const std::string &line)
+{
+  std::vector<std::string> columns;
+  std::stringstream ss(line);
+  std::string column;
+  while (std::getline(ss, column, ','))
+    columns.push_back(column);
+  return columns;
+}
+}  // namespace
+
+SCENARIO("Decode the data packages of every RTDE type")
+{
+  GIVEN("A receive interface connected to the simulator")
+  {
+    RTDESimulator &sim = simulator();
+    RTDEReceiveInterface rtde_receive(SIMULATOR_HOST);
+    const std::vector<double> safety_status_bits = sim.getVariable("safety_status_bits");
+
+    WHEN("The simulator changes variables of all types")
+    {
+      REQUIRE(sim.setVariable("actual_q", {0.1, 0.2, 0.3, 0.4, 0.5, 0.6}));
+      REQUIRE(sim.setVariable("actual_tool_accelerometer", {1.5, -2.5, 9.81}));
+      REQUIRE(sim.setVariable("joint_mode", {253, 254, 255, 253, 254, 255}));
+      REQUIRE(sim.setVariable("robot_mode", {-1}));
+      REQUIRE(sim.setVariable("safety_status_bits", {1025}));
+      REQUIRE(sim.setVariable("actual_digital_input_bits", {static_cast<double>((1ULL << 40) + 5)}));
+      REQUIRE(sim.setVariable("speed_scaling", {0.25}));
+      waitForPackages(rtde_receive);
+
+      THEN("The receive interface decodes the values")
+      {
+        CHECK(rtde_receive.getActualQ() == std::vector<double>({0.1, 0.2, 0.3, 0.4, 0.5, 0.6}));
+        CHECK(rtde_receive.getActualToolAccelerometer() == std::vector<double>({1.5, -2.5, 9.81}));
+        CHECK(rtde_receive.getJointMode() == std::vector<int32_t>({253, 254, 255, 253, 254, 255}));
+        CHECK(rtde_receive.getRobotMode() == -1);
+        CHECK(rtde_receive.getSafetyStatusBits() == 1025u);
+        CHECK(rtde_receive.getActualDigitalInputBits() == (1ULL << 40) + 5);
+        CHECK(rtde_receive.getSpeedScaling() == 0.25);
+
+        RobotStateSnapshot snapshot;
+        rtde_receive.getSnapshot(snapshot);
+        CHECK(snapshot.actual_q[5] == 0.6);
+        CHECK(snapshot.joint_mode[2] == 255);
+        CHECK(snapshot.robot_mode == -1);
+        CHECK(snapshot.actual_digital_input_bits == (1ULL << 40) + 5);
+      }
+    }
+
+    sim.setVariable("robot_mode", {7});
+    sim.setVariable("safety_status_bits", safety_status_bits);
+  }
+}
+
+SCENARIO("Snapshots are copied from a single data package")
+{
+  GIVEN("The simulator changing the joint positions in every cycle")
+  {
+    RTDESimulator &sim = simulator();
+    RTDEReceiveInterface rtde_receive(SIMULATOR_HOST);
+    REQUIRE(sim.setVariable("actual_q", std::vector<double>(6, 0)));
+    waitForPackages(rtde_receive);
+    std::atomic<bool> stop{false};
+    // The simulator copies actual_q to target_q in every cycle, so both are equal within a package
+    std::thread writer([&] {
+      for (int i = 1; !stop; i++)
+      {
+        sim.setVariable("actual_q", std::vector<double>(6, i));
+        std::this_thread::sleep_for(microseconds(50));
+      }
+    });
+
+    WHEN("Snapshots are taken while the packages are received")
+    {
+      int torn = 0;
+      int backwards = 0;
+      RobotStateSnapshot snapshot;
+      std::uint64_t previous_sequence_number = 0;
+      auto end = steady_clock::now() + milliseconds(300);
+      while (steady_clock::now() < end)
+      {
+        rtde_receive.getSnapshot(snapshot);
+        for (std::size_t i = 0; i < 6; i++)
+        {
+          if (snapshot.actual_q[i] != snapshot.actual_q[0] || snapshot.target_q[i] != snapshot.actual_q[0])
+            torn++;
+        }
+        if (snapshot.sequence_number < previous_sequence_number)
+          backwards++;
+        previous_sequence_number = snapshot.sequence_number;
+      }
+      stop = true;
+      writer.join();
+
+      THEN("No snapshot mixes two packages")
+      {
+        CHECK(torn == 0);
+        CHECK(backwards == 0);
+        CHECK(previous_sequence_number > 0);
+      }
+    }
+  }
+}
+
+SCENARIO("Pace a loop by the received data packages")
+{
+  GIVEN("A receive interface connected to the simulator")
+  {
+    simulator();
+    RTDEReceiveInterface rtde_receive(SIMULATOR_HOST);
+
+    WHEN("Waiting for the next state repeatedly")
+    {
+      const int cycles = 100;
+      int repeated = 0;
+      int skipped = 0;
+      RobotStateSnapshot snapshot;
+      // The first call returns the packages received since the interface was created
+      REQUIRE(rtde_receive.waitForNextState());
+      rtde_receive.getSnapshot(snapshot);
+      for (int i = 0; i < cycles; i++)
+      {
+        std::uint64_t sequence_number = snapshot.sequence_number;
+        double timestamp = snapshot.timestamp;
+        REQUIRE(rtde_receive.waitForNextState());
+        rtde_receive.getSnapshot(snapshot);
+        if (snapshot.sequence_number <= sequence_number || snapshot.timestamp <= timestamp)
+          repeated++;
+        else if (snapshot.sequence_number > sequence_number + 1)
+          skipped++;
+      }
+
+      THEN("Every call returns a new state")
+      {
+        CHECK(repeated == 0);
+        // Only a loaded machine delays the loop by more than a cycle
+        CHECK(skipped <= cycles / 10);
+      }
+    }
+  }
+}
+
+SCENARIO("Send commands to the emulated control script")
+{
+  GIVEN("A control and a receive interface connected to the simulator")
+  {
+    RTDESimulator &sim = simulator();
+    RTDEControlInterface rtde_control(SIMULATOR_HOST, SIMULATOR_HOST, HEARTBEAT_PORT);
+    RTDEReceiveInterface rtde_receive(SIMULATOR_HOST);
+    REQUIRE(rtde_control.isProgramRunning());
+    REQUIRE(sim.isScriptRunning());
+    std::vector<double> start_q = {0, -1.57, 1.57, -1.57, -1.57, 0};
+
+    WHEN("A move is commanded")
+    {
+      REQUIRE(rtde_control.moveJ(start_q));
+      std::vector<double> target_q = start_q;
+      target_q[0] = 0.5;
+
+      THEN("The command is acknowledged after it has been applied")
+      {
+        CHECK(rtde_control.moveJ(target_q));
+        CHECK(sim.getVariable("actual_q") == target_q);
+      }
+    }
+
+    WHEN("Servo targets are streamed")
+    {
+      REQUIRE(rtde_control.moveJ(start_q));
+      const int cycles = 200;
+      std::vector<double> q = start_q;
+      int rejected = 0;
+      auto start = steady_clock::now();
+      for (int i = 0; i < cycles; i++)
+      {
+        q[0] = start_q[0] + i * 0.001;
+        if (!rtde_control.servoJ(q, 0, 0, 0.002, 0.1, 300))
+          rejected++;
+      }
+      auto elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+      waitForPackages(rtde_receive);
+
+      THEN("The targets are sent without waiting for a handshake per command")
+      {
+        CHECK(rejected == 0);
+        // Waiting for the handshake of the script takes two cycles of 2 ms per command
+        CHECK(elapsed < cycles);
+        CHECK(sim.getVariable("actual_q")[0] == doctest::Approx(q[0]));
+        CHECK(rtde_control.servoStop());
+      }
+    }
+
+    WHEN("Queries are submitted to the executor while another thread queries directly")
+    {
+      // The emulated script answers inverse kinematics with actual_q and forward kinematics with actual_TCP_pose
+      const std::vector<double> q = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6};
+      const std::vector<double> pose = {-0.1, -0.2, -0.3, -0.4, -0.5, -0.6};
+      REQUIRE(sim.setVariable("actual_q", q));
+      REQUIRE(sim.setVariable("actual_TCP_pose", pose));
+      const int queries = 50;
+      std::vector<std::future<std::vector<double>>> submitted;
+      for (int i = 0; i < queries; i++)
+        submitted.push_back(
+            rtde_control.submit([&](RTDEControlInterface &c) { return c.getInverseKinematics(pose); }));
+      int wrong_direct = 0;
+      for (int i = 0; i < queries; i++)
+      {
+        if (rtde_control.getForwardKinematics(q) != pose)
+          wrong_direct++;
+      }
+      int wrong_submitted = 0;
+      for (auto &result : submitted)
+      {
+        if (result.get() != q)
+          wrong_submitted++;
+      }
+
+      THEN("Each query reads its own result")
+      {
+        CHECK(wrong_direct == 0);
+        CHECK(wrong_submitted == 0);
+      }
+    }
+
+    rtde_control.stopScript();
+  }
+}
+
+SCENARIO("Stream a path into the running control script")
+{
+  GIVEN("A control interface connected to the simulator")
+  {
+    simulator();
+    RTDEControlInterface rtde_control(SIMULATOR_HOST, SIMULATOR_HOST, HEARTBEAT_PORT);
+    std::vector<double> q = {0, -1.57, 1.57, -1.57, -1.57, 0};
+
+    WHEN("A path is appended")
+    {
+      Path path;
+      for (int i = 0; i < 5; i++)
+      {
+        std::vector<double> waypoint = q;
+        waypoint[0] = i * 0.1;
+        waypoint.insert(waypoint.end(), {1.0, 1.0, 0.0});
+        path.addEntry(PathEntry(PathEntry::MoveJ, PathEntry::PositionJoints, waypoint));
+      }
+
+      THEN("All waypoints are accepted")
+      {
+        CHECK(rtde_control.appendPath(path));
+      }
+    }
+
+    WHEN("A path longer than the buffer of the script is streamed")
+    {
+      const int waypoints = 60;
+      int taken = 0;
+      bool streamed = rtde_control.streamPath([&](PathEntry &entry) {
+        if (taken == waypoints)
+          return false;
+        std::vector<double> waypoint = q;
+        waypoint[0] = (taken++ % 10) * 0.1;
+        waypoint.insert(waypoint.end(), {1.0, 1.0, 0.01});
+        entry = PathEntry(PathEntry::MoveJ, PathEntry::PositionJoints, waypoint);
+        return true;
+      });
+
+      THEN("The whole source is consumed")
+      {
+        CHECK(streamed);
+        CHECK(taken == waypoints);
+      }
+    }
+
+    rtde_control.stopScript();
+  }
+}
+
+SCENARIO("Share one connection between the interfaces of a session")
+{
+  GIVEN("A control and a receive interface attached to a session")
+  {
+    simulator();
+    auto session = std::make_shared<RTDESession>(SIMULATOR_HOST);
+    RTDEControlInterface rtde_control(session, SIMULATOR_HOST, HEARTBEAT_PORT);
+    RTDEReceiveInterface rtde_receive(session);
+    CHECK_FALSE(session->isStarted());
+
+    WHEN("The session is started")
+    {
+      session->start();
+      std::vector<double> target_q = {0.3, -1.57, 1.57, -1.57, -1.57, 0};
+
+      THEN("The control script runs and both interfaces use the shared connection")
+      {
+        REQUIRE(rtde_control.isProgramRunning());
+        CHECK(rtde_control.moveJ(target_q));
+        waitForPackages(rtde_receive);
+        CHECK(rtde_receive.getActualQ() == target_q);
+      }
+      rtde_control.stopScript();
+    }
+  }
+}
+
+SCENARIO("Record the robot state into a binary file")
+{
+  GIVEN("A receive interface connected to the simulator")
+  {
+    RTDESimulator &sim = simulator();
+    RTDEReceiveInterface rtde_receive(SIMULATOR_HOST);
+    const std::string recording = "ur_rtde_test_recording.bin";
+    const std::string csv = "ur_rtde_test_recording.csv";
+    REQUIRE(sim.setVariable("actual_q", {1, 2, 3, 4, 5, 6}));
+    waitForPackages(rtde_receive);
+
+    WHEN("A binary recording is converted to CSV")
+    {
+      REQUIRE(rtde_receive.startFileRecording(recording, {"timestamp", "actual_q", "robot_mode"},
+                                              RTDEReceiveInterface::RecordingFormat::BINARY));
+      std::this_thread::sleep_for(milliseconds(200));
+      REQUIRE(rtde_receive.stopFileRecording());
+      RTDEReceiveInterface::convertRecordingToCsv(recording, csv);
+
+      THEN("The CSV holds one row per data package with the columns of a CSV recording")
+      {
+        std::ifstream file(csv);
+        std::string line;
+        REQUIRE(std::getline(file, line));
+        CHECK(line == "timestamp,actual_q_0,actual_q_1,actual_q_2,actual_q_3,actual_q_4,actual_q_5,robot_mode");
+
+        int rows = 0;
+        int wrong_values = 0;
+        int gaps = 0;
+        double previous_timestamp = -1;
+        while (std::getline(file, line))
+        {
+          std::vector<std::string> columns = splitCsv(line);
+          REQUIRE(columns.size() == 8);
+          double timestamp = std::stod(columns[0]);
+          if (previous_timestamp >= 0 && timestamp - previous_timestamp > 0.0021)
+            gaps++;
+          previous_timestamp = timestamp;
+          for (int i = 0; i < 6; i++)
+          {
+            if (std::stod(columns[1 + i]) != i + 1)
+              wrong_values++;
+          }
+          if (columns[7] != "7")
+            wrong_values++;
+          rows++;
+        }
+        // 100 packages are sent in 200 ms, allow for a loaded machine
+        CHECK(rows > 50);
+        CHECK(wrong_values == 0);
+        CHECK(gaps <= 2);
+      }
+    }
+
+    WHEN("The file is not a binary recording")
+    {
+      std::ofstream(csv) << "timestamp\n0.002\n";
+
+      THEN("The conversion fails")
+      {
+        CHECK_THROWS_AS(RTDEReceiveInterface::convertRecordingToCsv(csv, recording), std::runtime_error);
+      }
+    }
+
+    std::remove(recording.c_str());
+    std::remove(csv.c_str());
+  }
+}
@@ -0,0 +1,250 @@
+#include <ur_rtde/ur_kinematics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "doctest.h"
+
+using namespace ur_rtde;
+
+namespace
+{
+const double PI = 3.14159265358979323846;
+const double JOINT_TOLERANCE = 1e-6;
+const double POSE_TOLERANCE = 1e-6;
+// Calibrated configurations closer than this to a singularity are skipped, the branches of the inverse kinematics
+// meet there and which solution a branch ends in is not well defined
+const double SINGULARITY_DISTANCE = 0.05;
+
+const URKinematics::RobotModel MODELS[] = {
+    URKinematics::RobotModel::UR3,   URKinematics::RobotModel::UR5,   URKinematics::RobotModel::UR10,
+    URKinematics::RobotModel::UR3e,  URKinematics::RobotModel::UR5e,  URKinematics::RobotModel::UR10e,
+    URKinematics::RobotModel::UR16e, URKinematics::RobotModel::UR20,  URKinematics::RobotModel::UR30};
+
+double wrapAngle(double angle)
+{
+  angle = std::fmod(angle + PI, 2 * PI);
+  if (angle < 0)
+    angle += 2 * PI;
+  return angle - PI;
+}
+
+double jointDistance(const std::vector<double> &a, const std::vector<double> &b)
+{
+  double distance = 0;
+  for (std::size_t j = 0; j < 6; j++)
+    distance = std::max(distance, std::fabs(wrapAngle(a[j] - b[j])));
+  return distance;
+}
+
+// Largest difference of the positions and of the rotations of two poses
+double poseDistance(const std::vector<double> &a, const std::vector<double> &b)
+{
+  double distance = 0;
+  for (std::size_t i = 0; i < 3; i++)
+    distance = std::max(distance, std::fabs(a[i] - b[i]));
+  // Compare the rotation matrices, rotation vectors of the same rotation differ close to pi
+  auto matrix = [](const std::vector<double> &pose, double *r) {
+    double angle = std::sqrt(pose[3] * pose[3] + pose[4] * pose[4] + pose[5] * pose[5]);
+    double x = 0, y = 0, z = 1;
+    if (angle > 0)
+    {
+      x = pose[3] / angle;
+      y = pose[4] / angle;
+      z = pose[5] / angle;
+    }
+    double c = std::cos(angle), s = std::sin(angle), t = 1 - c;
+    double m[9] = {t * x * x + c,     t * x * y - s * z, t * x * z + s * y, t * x * y + s * z, t * y * y + c,
+                   t * y * z - s * x, t * x * z - s * y, t * y * z + s * x, t * z * z + c};
+    std::copy(m, m + 9, r);
+  };
+  double ra[9], rb[9];
+  matrix(a, ra);
+  matrix(b, rb);
+  for (std::size_t i = 0; i < 9; i++)
+    distance = std::max(distance, std::fabs(ra[i] - rb[i]));
+  return distance;
+}
+
+// Distance of a configuration to the wrist, elbow and shoulder singularities of the nominal geometry, the factors of
+// the determinant of the Jacobian
+double singularityDistance(URKinematics::RobotModel model, const std::vector<double> &q)
+{
+  const DHParameters p = URKinematics::nominalParameters(model);
+  double shoulder = std::fabs(p.a[1] * std::cos(q[1]) + p.a[2] * std::cos(q[1] + q[2]) +
+                              p.d[4] * std::sin(q[1] + q[2] + q[3])) /
+                    (std::fabs(p.a[1]) + std::fabs(p.a[2]));
+  return std::min(shoulder, std::min(std::fabs(std::sin(q[2])), std::fabs(std::sin(q[4]))));
+}
+
+struct RoundTrip
+{
+  int poses = 0;
+  int missing = 0;
+  int wrong = 0;
+  int duplicates = 0;
+};
+
+// Solve the forward kinematics of random configurations and count the poses whose solutions lack the configuration,
+// solutions that do not reach the pose and solutions found twice
+RoundTrip roundTrip(const URKinematics &kinematics, URKinematics::RobotModel model, std::mt19937 &rng, int count,
+                    double singularity_distance)
+{
+  std::uniform_real_distribution<double> joint(-PI, PI);
+  RoundTrip result;
+  while (result.poses < count)
+  {
+    std::vector<double> q(6);
+    for (auto &value : q)
+      value = joint(rng);
+    if (singularityDistance(model, q) < singularity_distance)
+      continue;
+    result.poses++;
+
+    const std::vector<double> pose = kinematics.forwardKinematics(q);
+    const std::vector<std::vector<double>> solutions = kinematics.inverseKinematicsAll(pose);
+    bool found = false;
+    for (std::size_t i = 0; i < solutions.size(); i++)
+    {
+      found = found || jointDistance(solutions[i], q) < JOINT_TOLERANCE;
+      if (poseDistance(kinematics.forwardKinematics(solutions[i]), pose) > POSE_TOLERANCE)
+        result.wrong++;
+      for (std::size_t k = 0; k < i; k++)
+      {
+        if (jointDistance(solutions[i], solutions[k]) < JOINT_TOLERANCE)
+          result.duplicates++;
+      }
+    }
+    if (!found)
+      result.missing++;
+  }
+  return result;
+}
+}  // namespace
+
+SCENARIO("Inverse kinematics solutions return to the joint positions")
+{
+  GIVEN("The nominal models")
+  {
+    std::mt19937 rng(16);
+
+    WHEN("Random joint positions are converted to poses and back")
+    {
+      THEN("The solutions of every pose contain the joint positions and reach the pose")
+      {
+        for (auto model : MODELS)
+        {
+          CAPTURE(static_cast<int>(model));
+          URKinematics kinematics(model);
+          RoundTrip result = roundTrip(kinematics, model, rng, 200, 0.0);
+          CHECK(result.missing == 0);
+          CHECK(result.wrong == 0);
+        }
+      }
+    }
+
+    WHEN("A tcp offset is set")
+    {
+      URKinematics kinematics(URKinematics::RobotModel::UR5e);
+      kinematics.setTcp({0.01, -0.02, 0.15, 0.1, -0.2, 0.3});
+
+      THEN("The solution closest to the joint positions is the joint positions")
+      {
+        std::uniform_real_distribution<double> joint(-PI, PI);
+        int wrong = 0;
+        for (int i = 0; i < 200; i++)
+        {
+          std::vector<double> q(6);
+          for (auto &value : q)
+            value = joint(rng);
+          std::vector<double> solution = kinematics.inverseKinematics(kinematics.forwardKinematics(q), q);
+          if (solution.size() != 6 || jointDistance(solution, q) > JOINT_TOLERANCE)
+            wrong++;
+        }
+        CHECK(wrong == 0);
+      }
+    }
+  }
+
+  GIVEN("Calibrated models")
+  {
+    std::mt19937 rng(16);
+    std::uniform_real_distribution<double> delta(-1e-3, 1e-3);
+
+    WHEN("Random joint positions away from singularities are converted to poses and back")
+    {
+      THEN("Every branch ends in its own solution and the solutions contain the joint positions")
+      {
+        for (auto model : MODELS)
+        {
+          CAPTURE(static_cast<int>(model));
+          DHParameters calibration;
+          for (std::size_t j = 0; j < 6; j++)
+          {
+            calibration.a[j] = delta(rng);
+            calibration.d[j] = delta(rng);
+            calibration.alpha[j] = delta(rng);
+            calibration.theta[j] = delta(rng);
+          }
+          URKinematics kinematics(model);
+          kinematics.setCalibration(calibration);
+          RoundTrip result = roundTrip(kinematics, model, rng, 500, SINGULARITY_DISTANCE);
+          CHECK(result.missing == 0);
+          CHECK(result.wrong == 0);
+          CHECK(result.duplicates == 0);
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("Kinematic calibration files are loaded")
+{
+  GIVEN("A calibration file of the controller")
+  {
+    const std::string filename = "ur_rtde_test_calibration.conf";
+    URKinematics kinematics(URKinematics::RobotModel::UR10e);
+    const DHParameters nominal = kinematics.getParameters();
+
+    WHEN("The deltas are listed in any order")
+    {
+      std::ofstream(filename) << "[mounting]\n"
+                                 "delta_alpha = [0.0001, 0, 0, 0, 0, 0]\n"
+                                 "delta_theta = [0, 0.0002, 0, 0, 0, 0]\n"
+                                 "delta_d = [0, 0, 0.0003, 0, 0, 0]\n"
+                                 "delta_a = [0, 0, 0, 0.0004, 0, 0]\n";
+      kinematics.loadCalibration(filename);
+
+      THEN("Each delta is added to its parameter")
+      {
+        CHECK(kinematics.isCalibrated());
+        CHECK(kinematics.getParameters().alpha[0] == doctest::Approx(nominal.alpha[0] + 0.0001));
+        CHECK(kinematics.getParameters().theta[1] == doctest::Approx(nominal.theta[1] + 0.0002));
+        CHECK(kinematics.getParameters().d[2] == doctest::Approx(nominal.d[2] + 0.0003));
+        CHECK(kinematics.getParameters().a[3] == doctest::Approx(nominal.a[3] + 0.0004));
+        CHECK(kinematics.getParameters().a[0] == nominal.a[0]);
+      }
+    }
+
+    WHEN("A delta is missing")
+    {
+      std::ofstream(filename) << "[mounting]\n"
+                                 "delta_theta = [0, 0, 0, 0, 0, 0]\n"
+                                 "delta_alpha = [0, 0, 0, 0, 0, 0]\n";
+
+      THEN("Loading fails")
+      {
+        CHECK_THROWS_AS(kinematics.loadCalibration(filename), std::runtime_error);
+        CHECK(!kinematics.isCalibrated());
+      }
+    }
+
+    std::remove(filename.c_str());
+  }
+}
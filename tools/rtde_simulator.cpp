@@ -0,0 +1,58 @@
+#include <ur_rtde/rtde_simulator.h>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace ur_rtde;
+
+static std::atomic<bool> running(true);
+
+static void signalHandler(int)
+{
+  running = false;
+}
+
+int main(int argc, char *argv[])
+{
+  std::string address = "127.0.0.1";
+  double frequency = 500.0;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "-v" || arg == "--verbose")
+      verbose = true;
+    else if ((arg == "-f" || arg == "--frequency") && i + 1 < argc)
+      frequency = std::atof(argv[++i]);
+    else if ((arg == "-a" || arg == "--address") && i + 1 < argc)
+      address = argv[++i];
+    else
+    {
+      std::cout << "Usage: " << argv[0] << " [-a address] [-f frequency] [-v]" << std::endl;
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+
+  std::signal(SIGINT, signalHandler);
+  std::signal(SIGTERM, signalHandler);
+
+  RTDESimulator simulator(address, frequency, verbose);
+  simulator.start();
+  std::cout << "RTDE simulator running on " << address << " at " << frequency << " Hz, press Ctrl+C to stop"
+            << std::endl;
+
+  while (running)
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  simulator.stop();
+  RTDESimulator::Statistics stats = simulator.getStatistics();
+  std::cout << "Cycles: " << stats.ticks << ", overruns: " << stats.overruns
+            << ", packages sent: " << stats.packages_sent << ", packages received: " << stats.packages_received
+            << ", commands processed: " << stats.commands_processed << std::endl;
+  return 0;
+}